@@ -13,142 +13,37 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
 
-#include "msaw.h"
+#include "cbonsai.h"
 
 
-// ==========================================================================
-// TUNABLE PARAMETERS  (aesthetic / behaviour knobs — safe to retune)
-// ==========================================================================
-
-// 1-in-N chance that a trunk split spawns a bare deadwood fork
-#define DEADWOOD_CHANCE 8
-
-// v2 canopy pads: leaf walkers carry an outward sign and lean their drift away
-// from the trunk so foliage pools into clouds instead of a symmetric mush.
-// Neutral steps drift outward by BIAS; inward drift is capped at INWARD.
-#define LEAF_PAD_BIAS   1
-
-#define LEAF_PAD_INWARD 1
-
-// v2 lean: trunks and shoots carry a signed bias that pulls their wander
-// toward a committed side, so high multiplier produces bold structure (sweeps
-// and clean forks) instead of a symmetric radial explosion. Magnitude is
-// clamped to MAX so the pull (probability |lean|/LEAN_DENOM per step) stays
-// organic rather than a rigid diagonal.
-#define LEAN_MAX   4
-
-#define LEAN_DENOM 4
-
-// v2 crowding gate: a trunk won't split / a shoot won't sprout if another live
-// structural branch head is closer than this (Manhattan). Self-limiting — only
-// bites where heads are packed (high multiplier), so sparse low-M trees are
-// untouched. Trunks want more breathing room than shoots.
-#define SPLIT_MIN_DIST 10
-
-#define SHOOT_MIN_DIST 10
-
-// v2 shoot side-runs: shoots stay on one flank for a short run, then flip, so
-// foliage groups into alternating pads instead of a strict left/right comb.
-// Higher multiplier -> longer one-sided runs (bolder clusters).
-#define SHOOT_RUN_MDIV 6
-
-// v2: ceiling on shoot life, hence how far a shoot can run sideways. Shoot life
-// is derived from the trunk's remaining life, but a trunk's life is a HEIGHT
-// budget (see TRUNK_RISE_COST), so off a fresh high-life base the raw value is
-// huge and the shoot crawls clear across the screen. Cap it to the trunk's
-// height budget (totalLife / this) plus a little multiplier slack, so a shoot
-// never reaches much farther than the tree is tall. Lower -> shorter shoots.
-#define SHOOT_LIFE_CAP_DIV 3
-
-// v2: ticks after a trunk split during which no new shoots sprout, so a fork
-// gets a clean stretch before branching resumes
-#define SPLIT_SHOOT_GRACE 6
-
-// v2 trunk widening: thicken the centerline into a tapering body, widest at the
-// base. The per-cell taper uses distance ABOVE the base (which never moves), so
-// the shape is stable. Overall thickness is gated and grows with the tree:
-// nothing widens until the trunk is TRUNK_MIN_HEIGHT tall (small trees stay
-// slim), then the base half-width ramps up one step per TRUNK_GROW_DIV rows of
-// extra height, capped at TRUNK_MAX_HALF — so the trunk fattens as it matures.
-// The taper then drops the half-width by one every TRUNK_TAPER_DIV rows up.
-#define TRUNK_MAX_HALF    3
-
-#define TRUNK_TAPER_DIV   6
-
-#define TRUNK_MIN_HEIGHT  14
-
-#define TRUNK_GROW_DIV    12
-
-// v2: a trunk pays this much life per row it climbs (instead of per tick), so
-// its total height is ~ L / TRUNK_RISE_COST regardless of the multiplier — a
-// high-M trunk just spends more time wandering sideways between rises. Raise
-// it for shorter trees, lower for taller.
-#define TRUNK_RISE_COST   4
-
 
 // ==========================================================================
-// INTERNAL CONSTANTS  (not aesthetic knobs — changing these alters output / determinism)
+// INTERNAL CONSTANTS
 // ==========================================================================
 
-#define BRANCH_HISTORY 3 // moving average for proceedural leaves
-
-// v2+ engines draw growth and cosmetics from separate msaw streams so
-// cosmetic tweaks can never change a saved tree's structure; the cosmetic
-// stream is decorrelated from the growth stream by this salt
-#define MSAW_COSMETIC_SALT 0x9E3779B97F4A7C15ULL
-
-// salt for the trunk-widening animation stream (presentation only — never
-// touches growth/cosmetic, so widen timing can't change a saved tree)
-#define MSAW_WIDEN_SALT 0xD1B54A32D192ED03ULL
+// the golden determinism corpus (--check) grows every tree on this fixed
+// virtual screen; changing it invalidates every recorded hash
+#define CHECK_COLS 80
 
-// salt for the deadwood (jin/shari) decision stream. Kept off the growth
-// stream so trees that grow no dead limb stay byte-identical; a tree only
-// diverges where a dead fork actually appears.
-#define MSAW_DEADWOOD_SALT 0xBF58476D1CE4E5B9ULL
+#define CHECK_ROWS 24
 
 
 // ==========================================================================
-// TYPES  (hoisted: every struct/enum precedes all functions)
+// TYPES  (curses frontend; engine types live in cbonsai.h)
 // ==========================================================================
 
-enum branchType {trunk, shootLeft, shootRight, dying, dead};
-
-struct config {
-	unsigned long long targetGlobalTime;
-	int live;
-	int infinite;
-	int screensaver;
-	int printTree;
-	int verbosity;
-	int lifeStart;
-	int multiplier;
-	int baseType;
-	int seed;
-	int leavesSize;
-	int version;
-	int save;
-	int load;
-
-	int proceduralMode;
-	int namedTree;           // Whether this is a named tree
-    time_t creationTime;     // When the tree was first created
-    double secondsPerTick;   // How many real seconds per simulation tick (-1 if not named)
-
-	int messageTimeout;  // seconds before message disappears
-	time_t messageStartTime;  // when the message was first displayed
-
-	double timeWait;
-	double timeStep;
-
-	char* message;
-	char* leaves[64];
-	char* saveFile;
-	char* loadFile;
-	int no_disp;
-	int hideLeaves;          // --bare: suppress foliage rendering (v2 only)
-};
-
 struct ncursesObjects {
 	WINDOW* treeWin;
 	WINDOW* messageBorderWin;
@@ -159,38 +54,6 @@ struct ncursesObjects {
 	PANEL* messagePanel;
 };
 
-struct GridCell {
-	char ch[8];
-	attr_t attrs;
-	short color_pair;
-	int occupied;
-	int widenHalf;    // v2 trunk widening: current rendered half-width
-	int widenTimer;   // v2 trunk widening: ticks until the next widen step
-	int splitDepth;   // v2 trunk widening: how many splits deep (forks thin out)
-};
-
-struct VirtualGrid {
-	struct GridCell *cells;
-	int width, height;
-	int anchor_x, anchor_y;
-};
-
-struct ColorResult {
-	attr_t attrs;
-	short color_pair;
-};
-
-struct counters {
-	int trunks;
-	int branches;
-	int shoots;
-	int shootCounter;
-	int trunkSplitCooldown;
-	int shootSide;          // v2: current committed shoot flank (shootLeft/shootRight)
-	int shootRunRemaining;  // v2: shoots left on this flank before it flips
-	unsigned long long globalTime;
-};
-
 // Structure to hold RGB values
 struct ColorRGB {
 	int r, g, b;
@@ -219,64 +82,139 @@ enum Season {
     WINTER
 };
 
-struct LeafWalker {
-	int x, y;
-	unsigned int seed;	// v1: rand_r stream
-	struct msaw rng;	// v2: per-walker msaw stream
-	int outward;		// v2: canopy-pad bias sign (-1 left, +1 right, 0 none)
+// -v performance HUD: every frame costs a few clock reads and a histogram
+// bump; the text is reformatted at most every HUD_REFRESH_NS and otherwise
+// redrawn from the cached lines, so the HUD barely shows up in what it
+// measures
+#define HUD_REFRESH_NS 250000000ULL
+
+#define HUD_LINES 6
+
+struct hud {
+	unsigned long long frameEndNs;     // end of the previous display step (0 before the first)
+	unsigned long long refreshNs;      // when lines[] were last formatted
+	unsigned long long lastTickNs;     // simulation time between the last two frames
+	unsigned long long lastDrawNs;     // blit + present of the last frame
+	struct phaseHist tick;             // every tick time seen, for p99
+	unsigned long long frames;         // frames since the last refresh
+	unsigned long long termBytes;      // terminal bytes since the last refresh
+	unsigned long long lastTermBytes;  // terminal bytes of the last frame
+	int ioFd;                          // /proc/self/io, or -1 where unavailable
+	char lines[HUD_LINES][80];
 };
 
-struct Branch {
-	int x, y;                   // Current position
-	int dx, dy;                 // Current direction
-	int life;                   // Remaining life
-	int age;                    // Current age
-	enum branchType type;       // Branch type (trunk, shootLeft, etc)
-	int shootCooldown;          // Current shoot cooldown
-	int dripLeafCooldown;       // Current drip leaf cooldown
-	int totalLife;              // Initial life value
-	int multiplier;             // Stored multiplier
-	int lean;                   // v2: signed horizontal growth bias (committed side)
-	int splitDepth;             // v2: how many trunk splits deep this branch is
-	int shootGrace;             // v2: ticks after a split before this trunk shoots again
-	int deadwood;               // v2: jin/shari — currently bare bleached dead wood
-	int diebackLife;            // v2: life at/below which a destined fork dies back (0 = never)
-	unsigned int leaf_seed;		// for proceedural consistency (v1)
-	struct msaw leaf_rng;		// for proceedural consistency (v2)
-	int x_history[BRANCH_HISTORY];          // Circular buffer for last BRANCH_HISTORY x positions
-	int y_history[BRANCH_HISTORY];          // Circular buffer for last BRANCH_HISTORY y positions
-	int history_count;         // How many positions we've stored (max BRANCH_HISTORY)
-	int history_index;         // Current index in circular buffer
-
-	struct VirtualGrid *leafGrid;
-	int leaf_steps_drawn;
-	int leaf_cur_x, leaf_cur_y;
-
-	struct LeafWalker *walkers;
-	int walker_count;
-	int walker_capacity;
+// curses frontend state: the tree window and its offset from tree
+// coordinates (recentred on resize)
+struct cursesFrontend {
+	struct ncursesObjects *objects;
+	int off_x, off_y;
+	struct textBuf *printOut;  // -lp: render the finished tree here, don't hold it
 };
 
-struct BranchList {
-	struct Branch* branches;    // Dynamic array of branches
-	int count;                  // Current number of branches
-	int capacity;              // Current capacity of array
+// widenedTrunkCells -> window, for blitTree and repaintDamage
+struct windowCells {
+	WINDOW *win;
+	int off_x, off_y;
+	int w, h;
+	const char *rows;  // draw only on the window rows set here; NULL: on all
 };
 
-/*
- * Versioned tree generation. The version tag pins the growth algorithm:
- * a saved tree must replay bit-identically under the engine it was created
- * with, so each engine owns its full RNG-consuming call chain (growth
- * deltas, branching decisions, colors, leaf glyphs, leaf walkers). Only
- * RNG-free plumbing (grids, blitting, resize/input handling, the pot) is
- * shared between engines.
- *
- * v1 is frozen: it consumes the global rand() stream seeded via srand()
- * and must never be modified. v2+ engines draw from explicit msaw streams.
- */
-struct TreeEngine {
-	void (*growTree)(struct config *conf, struct ncursesObjects *objects,
-		struct counters *myCounters);
+// one screen column of a text-rendered tree (renderText's stand-in for a
+// curses cell)
+struct textCell {
+	char ch[8];               // one UTF-8 character; "" is blank
+	unsigned int attrs;       // CB_* bits
+	short pair;
+	int wide;                 // 1: double-width char, -1: its right half
+};
+
+// renderText's screen: maxX x maxY columns in tree coordinates
+struct textCanvas {
+	struct textCell *cells;
+	int w, h;
+};
+
+// a growable byte buffer holding one rendered tree
+struct textBuf {
+	char *data;
+	size_t len, cap;
+};
+
+// text frontend: grows on conf->cols x conf->rows with no terminal and
+// renders the finished tree into out
+struct textFrontend {
+	short palette[5][3];      // seasonPalette: colours 16-19, 25
+	int plain;                // no SGR escapes
+	struct textBuf out;
+};
+
+#define SERVE_QUEUE 64            // connections waiting for a worker; beyond: refused
+#define SERVE_LRU_ENTRIES 512     // renders kept in memory
+
+// one --serve request: a connection and the palette at accept time
+struct serveJob {
+	int fd;
+	short palette[5][3];
+};
+
+// one render in --serve's in-memory LRU
+struct serveEntry {
+	unsigned long long hash;
+	struct textBuf key;       // renderCacheKey line
+	struct textBuf render;
+	unsigned long long used;  // server->clock at last hit
+};
+
+// --serve: the accept loop queues connections, workers answer them from
+// the LRU or by growing the tree
+struct server {
+	const struct config *conf;   // defaults for what a request leaves out
+	pthread_mutex_t lock;
+	pthread_cond_t work;         // a job was queued, or stopping
+	struct serveJob queue[SERVE_QUEUE];
+	int head, queued;
+	struct serveEntry lru[SERVE_LRU_ENTRIES];
+	int lruCount;
+	unsigned long long clock;
+	int stopping;
+};
+
+#ifdef SO_PEERCRED
+// Linux's struct ucred, which glibc only declares for _GNU_SOURCE; the
+// layout is fixed by the kernel ABI
+struct peerCred {
+	pid_t pid;
+	uid_t uid;
+	gid_t gid;
+};
+#endif
+
+// one file in the render cache directory, for LRU eviction
+struct renderCacheEntry {
+	char name[64];
+	time_t mtime;
+	off_t size;
+};
+
+// --batch: workers grow trees in any order; the writer emits them in seed
+// order, and workers stall once window trees are waiting on it
+struct batch {
+	const struct config *conf;
+	int *seeds;
+	int count;
+	const char *outPattern;   // per-seed file name ("%d" = seed), or NULL: stdout
+	int plain;
+	short palette[5][3];
+
+	pthread_mutex_t lock;
+	pthread_cond_t ready;     // a tree finished
+	pthread_cond_t room;      // the writer caught up
+	int next;                 // next seed index to grow
+	int written;              // trees written to stdout so far
+	int window;
+	struct textBuf *done;     // finished trees, by seed index
+	unsigned char *isDone;
+	int failures;
 };
 
 
@@ -284,40 +222,22 @@ struct TreeEngine {
 // FORWARD DECLARATIONS
 // ==========================================================================
 
-// common / shared
-struct VirtualGrid* grid_create(int w, int h, int ax, int ay);
-void grid_destroy(struct VirtualGrid *g);
-void grid_clear(struct VirtualGrid *g);
-void grid_grow(struct VirtualGrid *g, int lx, int ly);
-void grid_put(struct VirtualGrid *g, int tx, int ty, const char *str, attr_t attrs, short cpair);
-static struct GridCell *grid_at(struct VirtualGrid *g, int x, int y);
+// curses frontend
+static void blitCell(const struct VirtualGrid *g, const struct gridTile *t, int i, WINDOW *win, int wy, int wx);
 void grid_blit_to_window(struct VirtualGrid *g, WINDOW *win, int ox, int oy);
+static void grid_blit_row(const struct VirtualGrid *g, WINDOW *win, int ox, int oy, int wy);
+static void emitToWindow(void *ctx, int x, int y, const char *ch, unsigned int attrs, short pair);
 void delObjects(struct ncursesObjects *objects);
 void quit(struct config *conf, struct ncursesObjects *objects, int returnCode);
 int saveToFile(const struct config *conf, unsigned long long globalTime);
 int loadFromFile(struct config *conf);
 void finish(const struct config *conf, struct counters *myCounters);
 void printHelp(void);
-static void grid_put_str(struct VirtualGrid *g, int tx, int ty, const char *str, attr_t attrs, short cpair);
-int getBaseHeight(int baseType);
-void drawBaseToGrid(struct VirtualGrid *grid, int baseType, int trunk_x, int trunk_y);
-void drawPotRim(struct VirtualGrid *grid, int baseType, int trunk_x, int trunk_y,
-				int span_lo, int span_hi);
 void drawWins(struct ncursesObjects *objects);
-static inline int mrand(struct msaw *st, int mod);
 int checkKeyPress(const struct config *conf, struct counters *myCounters);
 void updateScreen(float timeStep);
 static inline int interpolate_color(int color1, int color2, float ratio);
 enum Season get_current_season_with_blend(float *blend_ratio);
-void initBranchList(struct BranchList* list);
-void addBranch(struct BranchList* list, struct Branch branch, struct counters *myCounters);
-void removeBranch(struct BranchList* list, int index);
-void freeBranchList(struct BranchList* list);
-static inline void update_position_history(struct Branch* branch);
-static inline void get_average_position(struct Branch* branch, int* avg_x, int* avg_y);
-static inline int isEarlyTrunk(int age, int totalLife);
-static inline int isYoungTrunk(int age, int totalLife);
-static inline int getBranchRollThreshold(int age, int totalLife, int multiplier);
 void addSpaces(WINDOW* messageWin, int count, int *linePosition, int maxWidth);
 int createMessageWindows(struct ncursesObjects *objects, char* message);
 int drawMessage(struct config *conf, struct ncursesObjects *objects, char* message);
@@ -327,172 +247,121 @@ void recalculate_offsets(int trunk_x, int trunk_y, int baseHeight, WINDOW *win,
 void handleResize(struct config *conf, struct ncursesObjects *objects,
 				  int trunk_x, int trunk_y, int baseHeight, int *off_x, int *off_y);
 void blitTree(struct VirtualGrid *skeleton, struct VirtualGrid *trunkPlane, int trunk_y,
-			  struct BranchList *branchList,
+			  struct VirtualGrid *canopy,
 			  struct ncursesObjects *objects, int off_x, int off_y);
-int liveStepDisplay(struct config *conf, struct ncursesObjects *objects,
-					struct VirtualGrid *skeleton, struct VirtualGrid *trunkPlane,
-					struct BranchList *branchList,
-					struct counters *myCounters,
-					int trunk_x, int trunk_y, int baseHeight,
-					int *off_x, int *off_y, int maxX, int maxY, int turn);
-void finalHold(struct config *conf, struct ncursesObjects *objects,
-			   struct VirtualGrid *skeleton, struct VirtualGrid *trunkPlane,
-			   struct BranchList *branchList,
-			   int trunk_x, int trunk_y, int baseHeight, int *off_x, int *off_y);
-
-// v1 engine (frozen)
-static inline void roll(int *dice, int mod);
-struct ColorResult chooseColorResult(enum branchType type);
-void setDeltas(enum branchType type, int life, int totalLife, int age, int multiplier, int *returnDx, int *returnDy);
-char* chooseString(const struct config *conf, enum branchType type, int life, int dx, int dy);
-void updateBranch_v1(struct config *conf, struct VirtualGrid *skeleton,
-				struct counters *myCounters, int branchIdx,
-				struct BranchList* list);
-static void leafStepWalkers(struct config *conf, struct VirtualGrid *grid,
-							enum branchType type, int groundY,
-							struct LeafWalker **walkers, int *count, int *capacity);
-void generateLeaves_v1(struct config *conf, struct VirtualGrid *grid, enum branchType type, int x, int y, int life, unsigned int leaf_seed, int groundY);
-void growTree_v1(struct config *conf, struct ncursesObjects *objects, struct counters *myCounters);
-
-// v2 engine
-struct ColorResult chooseColorResult_v2(enum branchType type, struct msaw *cosmetic);
-static int applyLean(struct msaw *growth, int dx, int lean, int lo, int hi);
-void setDeltas_v2(enum branchType type, int life, int totalLife, int age,
-				  int multiplier, int *returnDx, int *returnDy,
-				  int lean, struct msaw *growth);
-char* chooseString_v2(const struct config *conf, enum branchType type, int life,
-					  int dx, int dy, struct msaw *cosmetic);
-static int structuralCrowded(const struct BranchList *list, int x, int y,
-							 int exceptIdx, int minDist);
-void updateBranch_v2(struct config *conf, struct VirtualGrid *skeleton,
-				struct counters *myCounters, int branchIdx,
-				struct BranchList* list,
-				struct msaw *growth, struct msaw *cosmetic, struct msaw *deadRng);
-static void leafStep_v2(struct config *conf, struct VirtualGrid *grid,
-						enum branchType type, int groundY,
-						struct LeafWalker **walkers, int *count, int *capacity);
-void generateLeaves_v2(struct config *conf, struct VirtualGrid *grid, enum branchType type,
-					   int x, int y, int life, const struct msaw *leafRng, int groundY,
-					   int outward);
-static void advanceTrunkWiden(struct VirtualGrid *tp, int trunk_y, struct msaw *rng);
-static void drawWidenedTrunk(struct VirtualGrid *tp, WINDOW *win,
-							 int trunk_y, int off_x, int off_y);
-void growTree_v2(struct config *conf, struct ncursesObjects *objects, struct counters *myCounters);
+void repaintDamage(const struct treeView *view, struct ncursesObjects *objects, int off_x, int off_y);
+int liveStepDisplay(struct ncursesObjects *objects, const struct treeView *view,
+					int *off_x, int *off_y);
+void finalHold(struct ncursesObjects *objects, const struct treeView *view, int *off_x, int *off_y);
+static void cursesBegin(void *ctx, struct config *conf, int *maxY, int *maxX);
+static int cursesStep(void *ctx, const struct treeView *view);
+static void cursesFinish(void *ctx, const struct treeView *view);
+
+// performance HUD
+struct hud *hudCreate(void);
+static unsigned long long hudTermBytes(void);
+unsigned long long hudFrameStart(void);
+void hudFramePresented(unsigned long long hudStart, unsigned long long termBefore);
+void hudFrameEnd(void);
+void hudRefresh(const struct VirtualGrid *skeleton, const struct VirtualGrid *trunkPlane,
+				const struct canopy *canopy, const struct BranchList *list, unsigned long long now);
+void hudDraw(WINDOW *win, const struct VirtualGrid *skeleton, const struct VirtualGrid *trunkPlane,
+			 const struct canopy *canopy, const struct BranchList *list, unsigned long long now);
+
+// headless tools
+static double monotonicSeconds(void);
+int runBench(const struct config *conf, int seeds);
+int runCheck(const struct config *conf, const char *path, int update);
+static char *readLine(FILE *fp);
+int runStateDiff(const char *pathA, const char *pathB);
+
+// text output + batch
+static void seasonPalette(short rgb[5][3]);
+void textAppend(struct textBuf *b, const char *s, size_t n);
+static void textPut(struct textCanvas *cv, int x, int y, const char *str, unsigned int attrs, short pair);
+static void emitToText(void *ctx, int x, int y, const char *ch, unsigned int attrs, short pair);
+static void textBlitGrid(struct textCanvas *cv, const struct VirtualGrid *g);
+static int textSgr(char *buf, size_t size, unsigned int attrs, short pair, short palette[5][3]);
+void renderText(const struct treeView *view, short palette[5][3], int plain, struct textBuf *out);
+static void textBegin(void *ctx, struct config *conf, int *maxY, int *maxX);
+static int textStep(void *ctx, const struct treeView *view);
+static void textFinish(void *ctx, const struct treeView *view);
+int parseSeeds(const char *spec, int **seeds);
+static void *batchWorker(void *arg);
+int runBatch(const struct config *conf, const char *seedSpec, const char *outPattern, int jobs, int plain);
+void termSize(int *cols, int *rows);
+int writeAll(int fd, const char *data, size_t len);
+int printTreeText(struct config *conf, struct counters *myCounters, int useCache);
+
+// render cache
+static void renderCacheKey(const struct config *conf, short palette[5][3], struct textBuf *key);
+char *renderCacheDir(void);
+char *renderCachePath(const char *dir, const struct textBuf *key);
+int renderCacheLoad(const char *path, const struct textBuf *key, struct textBuf *out);
+void renderCacheStore(const char *dir, const char *path, const struct textBuf *key, const struct textBuf *render);
+static void renderCacheAccount(const char *dir, long long delta);
+static int renderCacheOlder(const void *a, const void *b);
+long long renderCacheEvict(const char *dir);
+unsigned long long renderKeyHash(const struct textBuf *key);
+
+// tree service
+char *defaultSocketPath(void);
+static int peerUid(int fd, uid_t *uid);
+static int socketIsOurs(const char *path);
+int sendAll(int fd, const char *data, size_t len);
+int recvLine(int fd, char *buf, size_t size);
+int serveRequestLine(const struct config *conf, char *buf, size_t size);
+int serveParseRequest(char *line, struct config *conf);
+static int serveLookup(struct server *s, unsigned long long hash, const struct textBuf *key, struct textBuf *out);
+static void serveInsert(struct server *s, unsigned long long hash, const struct textBuf *key, const struct textBuf *render);
+static void serveAnswer(struct server *s, const struct serveJob *job);
+static void *serveWorker(void *arg);
+static void onServeStop(int sig);
+static void serveEnqueue(struct server *s, int conn);
+int runServe(const struct config *conf, const char *socketPath, int jobs);
+int clientPrint(struct config *conf, const char *socketPath);
 
 // dispatch + entry
-struct TreeEngine get_engine(int version);
-void printstdscr(void);
+int parseLeaves(struct config *conf, char *list);
+int parseSize(const char *arg, int *cols, int *rows);
 char* createDefaultCachePath(void);
 
 
 // ==========================================================================
-// COMMON / SHARED  (grid, colour & season, branch list, message, init, io)
+// COMMON / SHARED  (window blit, colour & season, message, init, io)
 // ==========================================================================
 
-struct VirtualGrid* grid_create(int w, int h, int ax, int ay) {
-	struct VirtualGrid *g = malloc(sizeof(struct VirtualGrid));
-	g->width = w;
-	g->height = h;
-	g->anchor_x = ax;
-	g->anchor_y = ay;
-	g->cells = calloc(w * h, sizeof(struct GridCell));
-	return g;
-}
-
-void grid_destroy(struct VirtualGrid *g) {
-	if (!g) return;
-	free(g->cells);
-	free(g);
-}
-
-void grid_clear(struct VirtualGrid *g) {
-	memset(g->cells, 0, sizeof(struct GridCell) * g->width * g->height);
-}
-
-void grid_grow(struct VirtualGrid *g, int lx, int ly) {
-	int new_w = g->width;
-	int new_h = g->height;
-	int sx = 0, sy = 0;
-
-	if (lx < 0) {
-		int need = -lx;
-		int grow = (int)(g->width * 0.5);
-		if (grow < need) grow = need;
-		new_w += grow;
-		sx = grow;
-	} else if (lx >= g->width) {
-		int need = lx - g->width + 1;
-		int grow = (int)(g->width * 0.5);
-		if (grow < need) grow = need;
-		new_w += grow;
-	}
-
-	if (ly < 0) {
-		int need = -ly;
-		int grow = (int)(g->height * 0.5);
-		if (grow < need) grow = need;
-		new_h += grow;
-		sy = grow;
-	} else if (ly >= g->height) {
-		int need = ly - g->height + 1;
-		int grow = (int)(g->height * 0.5);
-		if (grow < need) grow = need;
-		new_h += grow;
-	}
-
-	struct GridCell *nc = calloc(new_w * new_h, sizeof(struct GridCell));
-	for (int y = 0; y < g->height; y++) {
-		memcpy(&nc[(y + sy) * new_w + sx],
-			   &g->cells[y * g->width],
-			   g->width * sizeof(struct GridCell));
-	}
-
-	free(g->cells);
-	g->cells = nc;
-	g->anchor_x -= sx;
-	g->anchor_y -= sy;
-	g->width = new_w;
-	g->height = new_h;
-}
-
-void grid_put(struct VirtualGrid *g, int tx, int ty, const char *str, attr_t attrs, short cpair) {
-	int lx = tx - g->anchor_x;
-	int ly = ty - g->anchor_y;
-	if (lx < 0 || lx >= g->width || ly < 0 || ly >= g->height) {
-		grid_grow(g, lx, ly);
-		lx = tx - g->anchor_x;
-		ly = ty - g->anchor_y;
-	}
-	struct GridCell *cell = &g->cells[ly * g->width + lx];
-	strncpy(cell->ch, str, sizeof(cell->ch) - 1);
-	cell->ch[sizeof(cell->ch) - 1] = '\0';
-	cell->attrs = attrs;
-	cell->color_pair = cpair;
-	cell->occupied = 1;
-}
-
-// Return the cell at absolute (x, y), or NULL if outside the grid's bounds.
-static struct GridCell *grid_at(struct VirtualGrid *g, int x, int y) {
-	int lx = x - g->anchor_x, ly = y - g->anchor_y;
-	if (lx < 0 || lx >= g->width || ly < 0 || ly >= g->height) return NULL;
-	return &g->cells[ly * g->width + lx];
+static void blitCell(const struct VirtualGrid *g, const struct gridTile *t, int i, WINDOW *win, int wy, int wx) {
+	attr_t at = (t->attrs[i] & CB_BOLD) ? A_BOLD : 0;
+	wattron(win, at | COLOR_PAIR(t->color[i]));
+	mvwprintw(win, wy, wx, "%s", grid_glyph(g, t, i));
+	wattroff(win, at | COLOR_PAIR(t->color[i]));
 }
 
 void grid_blit_to_window(struct VirtualGrid *g, WINDOW *win, int ox, int oy) {
 	int wh, ww;
 	getmaxyx(win, wh, ww);
-	for (int gy = 0; gy < g->height; gy++) {
-		int wy = (g->anchor_y + gy) + oy;
-		if (wy < 0 || wy >= wh) continue;
-		for (int gx = 0; gx < g->width; gx++) {
-			struct GridCell *cell = &g->cells[gy * g->width + gx];
-			if (!cell->occupied) continue;
-			int wx = (g->anchor_x + gx) + ox;
-			if (wx < 0 || wx >= ww) continue;
-			wattron(win, cell->attrs | COLOR_PAIR(cell->color_pair));
-			mvwprintw(win, wy, wx, "%s", cell->ch);
-			wattroff(win, cell->attrs | COLOR_PAIR(cell->color_pair));
-		}
+	struct gridIter it;
+	for (gridIterBegin(&it, g); gridIterNext(&it); ) {
+		int wy = (g->anchor_y + it.ly) + oy;
+		int wx = (g->anchor_x + it.lx) + ox;
+		if (wy < 0 || wy >= wh || wx < 0 || wx >= ww) continue;
+		blitCell(g, it.tile, it.i, win, wy, wx);
+	}
+}
+
+// grid_blit_to_window for one window row only
+static void grid_blit_row(const struct VirtualGrid *g, WINDOW *win, int ox, int oy, int wy) {
+	int ww = getmaxx(win);
+	int ly = wy - oy - g->anchor_y;
+	struct gridRow span = grid_row(g, ly);
+	int lo = -ox - g->anchor_x, hi = ww - ox - g->anchor_x;
+	if (lo < span.lo) lo = span.lo;
+	if (hi > span.hi) hi = span.hi;
+	for (int lx = lo; lx < hi; lx++) {
+		if (grid_occupied(g, lx, ly))
+			blitCell(g, grid_tile(g, lx, ly), (ly & (GRID_TILE_H - 1)) * GRID_TILE_W + (lx & (GRID_TILE_W - 1)),
+					 win, wy, g->anchor_x + lx + ox);
 	}
 }
 
@@ -517,6 +386,9 @@ void quit(struct config *conf, struct ncursesObjects *objects, int returnCode) {
 	delObjects(objects);
 	free(conf->saveFile);
 	free(conf->loadFile);
+	printProfile(stderr);
+	printAllocStats(stderr);
+	traceClose();
 	exit(returnCode);
 }
 
@@ -671,104 +543,74 @@ void printHelp(void) {
 			"  -C, --load=FILE        load progress from file\n"
 			"                           [default: $XDG_CACHE_HOME/cbonsai\n"
 			"                            or $HOME/.cache/cbonsai]\n"
-			"  -v, --verbose          increase output verbosity\n"
+	);
+	// diagnostics, split off to keep each literal under C99's 4095 chars
+	printf("%s",
+			"      --profile          time each phase of the growth loop\n"
+			"                           and print p50/p99/max per phase\n"
+			"                           on exit\n"
+			"      --check=FILE       regrow every tree in a golden corpus\n"
+			"                           headlessly and compare final grid\n"
+			"                           hashes; exit 1 on any mismatch\n"
+			"      --golden=FILE      rewrite FILE's hashes from fresh runs\n"
+			"      --alloc-stats      count heap allocations by subsystem\n"
+			"                           (grid, branches, walkers, strings)\n"
+			"                           and print them with peak RSS on exit\n"
+			"      --trace=FILE       write a Chrome/Perfetto trace-event JSON\n"
+			"                           timeline: ticks, branch spawns, leaf\n"
+			"                           bursts, grid growth and frame presents\n"
+			"      --stats-file=FILE  on SIGUSR1, append uptime, trees,\n"
+			"                           ticks, frame times, peak memory and\n"
+			"                           branch count to FILE\n"
+			"      --metrics=FILE     keep a Prometheus textfile of tree,\n"
+			"                           tick, frame, memory and branch\n"
+			"                           metrics, rewritten atomically\n"
+			"      --metrics-interval=SECS\n"
+			"                           seconds between --metrics writes\n"
+			"                           [default: 15]\n"
+			"      --state-trace=FILE write a per-tick hash of the branch\n"
+			"                           list, rng streams and grids to FILE\n"
+			"      --state-diff A B   report the first tick and branch\n"
+			"                           where two state traces diverge\n"
+			"      --headless[=CxR]   grow the tree with no terminal on a\n"
+			"                           COLSxROWS screen [default: 80x24]\n"
+			"                           and print its tick count and hash\n"
+			"      --bench[=SEEDS]    time both engines headlessly over a\n"
+			"                           matrix of -M and -L values, SEEDS\n"
+			"                           trees per cell [default: 3]\n"
+			"      --batch=SEEDS      grow one tree per seed (FIRST-LAST or\n"
+			"                           a file of seeds) with no terminal\n"
+			"                           and print each as ANSI text, in\n"
+			"                           seed order, on all cores\n"
+			"      --batch-out=PATTERN\n"
+			"                           write each --batch tree to its own\n"
+			"                           file; %d in PATTERN is the seed\n"
+			"      --jobs=N           --batch worker threads [default:\n"
+			"                           one per online CPU]\n"
+			"      --plain            --batch output without colour escapes\n"
+			"      --no-cache         with -p, always regrow the tree instead\n"
+			"                           of reusing a cached render\n"
+			"      --keyframe-interval=TICKS\n"
+			"                           while a named tree grows, snapshot it\n"
+			"                           every TICKS ticks, 0 for never\n"
+			"                           [default: 200]\n"
+			"      --keyframe-count=N keep the last N keyframes [default: 4]\n"
+			"      --keyframe-budget=KB\n"
+			"                           disk space all keyframes may use\n"
+			"                           [default: 1024]\n"
+			"      --serve[=SOCKET]   run a daemon rendering trees for\n"
+			"                           --client on a Unix socket [default:\n"
+			"                           $XDG_RUNTIME_DIR/cbonsai.sock]\n"
+			"      --client[=SOCKET]  with -p, fetch the tree from a --serve\n"
+			"                           daemon; grow it here if none answers\n"
+			"  -v, --verbose          increase output verbosity; in live\n"
+			"                           mode, overlay a performance HUD\n"
+			"                           (fps, tick time, branches, walkers,\n"
+			"                           grid memory, terminal bytes/frame)\n"
 			"  -h, --help             show help\n"
 	);
 }
 
-static void grid_put_str(struct VirtualGrid *g, int tx, int ty, const char *str, attr_t attrs, short cpair) {
-	for (int i = 0; str[i]; i++) {
-		char ch[2] = { str[i], '\0' };
-		grid_put(g, tx + i, ty, ch, attrs, cpair);
-	}
-}
-
-int getBaseHeight(int baseType) {
-	switch(baseType) {
-	case 1: return 4;
-	case 2: return 3;
-	default: return 0;
-	}
-}
-
-// Static part of the plant base (everything below the rim row).
-// The rim row itself is drawn by drawPotRim so it can track the trunk.
-void drawBaseToGrid(struct VirtualGrid *grid, int baseType, int trunk_x, int trunk_y) {
-	if (baseType <= 0) return;
-
-	int by = trunk_y + 1;
-
-	switch(baseType) {
-	case 1: {
-		int bx = trunk_x - 31 / 2;
-		grid_put_str(grid, bx, by + 1, " \\                           / ", A_BOLD, 8);
-		grid_put_str(grid, bx, by + 2, "  \\_________________________/ ", A_BOLD, 8);
-		grid_put_str(grid, bx, by + 3, "  (_)                     (_)", A_BOLD, 8);
-		break;
-	}
-	case 2: {
-		int bx = trunk_x - 15 / 2;
-		grid_put_str(grid, bx, by + 1, " (           ) ", 0, 8);
-		grid_put_str(grid, bx, by + 2, "  (_________)  ", 0, 8);
-		break;
-	}
-	}
-}
-
-// Top row of the pot: grass, then a ./~...~\. flare hugging the trunk's
-// actual span [span_lo, span_hi] on the row above. Redrawn whenever the
-// trunk's footprint at ground level changes. RNG-free.
-void drawPotRim(struct VirtualGrid *grid, int baseType, int trunk_x, int trunk_y,
-				int span_lo, int span_hi) {
-	if (baseType <= 0) return;
-
-	int by = trunk_y + 1;
-
-	switch(baseType) {
-	case 1: {
-		int bx = trunk_x - 31 / 2;
-		// keep the flare (span plus . / \ . on each side) inside the pot mouth
-		int lo = span_lo, hi = span_hi;
-		if (lo < bx + 3) lo = bx + 3;
-		if (hi > bx + 27) hi = bx + 27;
-
-		grid_put(grid, bx, by, ":", A_BOLD, 8);
-		for (int gx = bx + 1; gx < lo - 2; gx++)
-			grid_put(grid, gx, by, "_", A_BOLD, 23);
-		grid_put(grid, lo - 2, by, ".", A_BOLD, 20);
-		grid_put(grid, lo - 1, by, "/", A_BOLD, 20);
-		for (int gx = lo; gx <= hi; gx++)
-			grid_put(grid, gx, by, "~", A_BOLD, 20);
-		grid_put(grid, hi + 1, by, "\\", A_BOLD, 20);
-		grid_put(grid, hi + 2, by, ".", A_BOLD, 20);
-		for (int gx = hi + 3; gx < bx + 30; gx++)
-			grid_put(grid, gx, by, "_", A_BOLD, 23);
-		grid_put(grid, bx + 30, by, ":", A_BOLD, 8);
-		break;
-	}
-	case 2: {
-		int bx = trunk_x - 15 / 2;
-		int lo = span_lo, hi = span_hi;
-		if (lo < bx + 3) lo = bx + 3;
-		if (hi > bx + 11) hi = bx + 11;
-
-		grid_put(grid, bx, by, "(", 0, 8);
-		for (int gx = bx + 1; gx < lo - 2; gx++)
-			grid_put(grid, gx, by, "-", 0, 2);
-		grid_put(grid, lo - 2, by, ".", 0, 11);
-		grid_put(grid, lo - 1, by, "/", 0, 11);
-		for (int gx = lo; gx <= hi; gx++)
-			grid_put(grid, gx, by, "~", 0, 11);
-		grid_put(grid, hi + 1, by, "\\", 0, 11);
-		grid_put(grid, hi + 2, by, ".", 0, 11);
-		for (int gx = hi + 3; gx < bx + 14; gx++)
-			grid_put(grid, gx, by, "-", 0, 2);
-		grid_put(grid, bx + 14, by, ")", 0, 8);
-		break;
-	}
-	}
-}
-
 void drawWins(struct ncursesObjects *objects) {
 	int rows, cols;
 	getmaxyx(stdscr, rows, cols);
@@ -779,12 +621,6 @@ void drawWins(struct ncursesObjects *objects) {
 	objects->treePanel = new_panel(objects->treeWin);
 }
 
-// v2 counterpart of rand() % mod, drawing from an explicit msaw stream
-static inline int mrand(struct msaw *st, int mod) {
-	if (mod < 1) return 0;
-	return (int)msaw_below(st, (uint32_t)mod);
-}
-
 // check for key press: 0=nothing, 1=quit, 2=resize
 int checkKeyPress(const struct config *conf, struct counters *myCounters) {
 	int ch = wgetch(stdscr);
@@ -868,107 +704,6 @@ enum Season get_current_season_with_blend(float *blend_ratio) {
 	return current_season;
 }
 
-void initBranchList(struct BranchList* list) {
-	list->capacity = 16;  // Initial capacity
-	list->count = 0;
-	list->branches = malloc(sizeof(struct Branch) * list->capacity);
-}
-
-void addBranch(struct BranchList* list, struct Branch branch, struct counters *myCounters) {
-	myCounters->branches++;
-	if (list->count >= list->capacity) {
-		list->capacity *= 2;
-		struct Branch *tmp = realloc(list->branches, sizeof(struct Branch) * list->capacity);
-		if (!tmp) {
-			list->capacity /= 2;
-			return;
-		}
-		list->branches = tmp;
-	}
-	list->branches[list->count++] = branch;
-}
-
-void removeBranch(struct BranchList* list, int index) {
-	if (index >= list->count) return;
-	memmove(&list->branches[index], &list->branches[index + 1], 
-			sizeof(struct Branch) * (list->count - index - 1));
-	list->count--;
-}
-
-void freeBranchList(struct BranchList* list) {
-	for (int i = 0; i < list->count; i++) {
-		grid_destroy(list->branches[i].leafGrid);
-		free(list->branches[i].walkers);
-	}
-	free(list->branches);
-	list->branches = NULL;
-	list->count = 0;
-	list->capacity = 0;
-}
-
-static inline void update_position_history(struct Branch* branch) {
-	// Add new position to history
-	branch->x_history[branch->history_index] = branch->x;
-	branch->y_history[branch->history_index] = branch->y;
-	
-	// Update count and index
-	if (branch->history_count < BRANCH_HISTORY) {
-		branch->history_count++;
-	}
-	branch->history_index = (branch->history_index + 1) % BRANCH_HISTORY;
-}
-
-static inline void get_average_position(struct Branch* branch, int* avg_x, int* avg_y) {
-	if (branch->history_count == 0) {
-
-		*avg_x = branch->x;
-		*avg_y = branch->y;
-		return;
-	}
-	int sum_x = 0, sum_y = 0;
-	for (int i = 0; i < branch->history_count; i++) {
-		sum_x += branch->x_history[i];
-		sum_y += branch->y_history[i];
-	}
-	*avg_x = sum_x / branch->history_count;
-	*avg_y = sum_y / branch->history_count;
-}
-
-// Check if we're in the early trunk phase (first 30% of life)
-static inline int isEarlyTrunk(int age, int totalLife) {
-	return age < (totalLife * 14 / 20);  // 70% of total life
-}
-
-// Check if we're in the young trunk phase (first 15% of life)
-static inline int isYoungTrunk(int age, int totalLife) {
-	return age < (totalLife * 3 / 20);  // 15% of total life
-}
-
-// Calculate branching roll threshold based on age (higher number = less likely to branch)
-static inline int getBranchRollThreshold(int age, int totalLife, int multiplier) {
-	// Base dice of 12, lower number = more branching
-	int dice = 3;  // Base roll threshold (1/3 chance)
-
-	if (isYoungTrunk(age, totalLife)) {
-		dice = 12 - (multiplier/10);  // Only 1/12 chance during young phase
-	} else {
-		// We want LESS chance to branch as we go up
-		int remainingLife = totalLife - age;
-
-
-
-		if (remainingLife < totalLife / 4) {  // Near the top
-			dice = 15 - (multiplier/4);  // Base 1/12 chance
-		} else if (remainingLife < totalLife / 2) {  // Upper half
-			dice = 10 - (multiplier/6);  // Base 1/8 chance
-		} else {
-			dice = 5 - (multiplier/10);  // Base 1/4 chance near bottom
-		}
-	}
-	
-	return dice;
-}
-
 void addSpaces(WINDOW* messageWin, int count, int *linePosition, int maxWidth) {
 	// add spaces if there's enough space
 	if (*linePosition < (maxWidth - count)) {
@@ -1188,24 +923,13 @@ void init(struct config *conf, struct ncursesObjects *objects) {
 
 		if (can_change_color() && COLORS >= 256) {
 			// Full 256-color terminal: define custom seasonal RGB colors
-			float blend_ratio;
-			enum Season season = get_current_season_with_blend(&blend_ratio);
-
-			struct ColorRGB current_colors = season_colors[season];
-			struct ColorRGB prev_colors = season_colors[(season + 4) % 5];
-
-			int r   = interpolate_color(current_colors.r,   prev_colors.r,   blend_ratio);
-			int g   = interpolate_color(current_colors.g,   prev_colors.g,   blend_ratio);
-			int b   = interpolate_color(current_colors.b,   prev_colors.b,   blend_ratio);
-			int r_2 = interpolate_color(current_colors.r_2, prev_colors.r_2, blend_ratio);
-			int g_2 = interpolate_color(current_colors.g_2, prev_colors.g_2, blend_ratio);
-			int b_2 = interpolate_color(current_colors.b_2, prev_colors.b_2, blend_ratio);
-
-			init_color(16, 540, 270, 0);     // Lighter brown for trunk
-			init_color(17, 280, 140, 0);     // Darker brown for branches
-			init_color(18, r,   g,   b);     // Main leaf color
-			init_color(19, r_2, g_2, b_2);  // Darker leaf variant
-			init_color(25, 560, 510, 420);  // Weathered deadwood (jin/shari) — muted driftwood
+			short rgb[5][3];
+			seasonPalette(rgb);
+			init_color(16, rgb[0][0], rgb[0][1], rgb[0][2]);  // Lighter brown for trunk
+			init_color(17, rgb[1][0], rgb[1][1], rgb[1][2]);  // Darker brown for branches
+			init_color(18, rgb[2][0], rgb[2][1], rgb[2][2]);  // Main leaf color
+			init_color(19, rgb[3][0], rgb[3][1], rgb[3][2]);  // Darker leaf variant
+			init_color(25, rgb[4][0], rgb[4][1], rgb[4][2]);  // Weathered deadwood (jin/shari)
 
 			init_pair(20, 16, bg);  // Trunk color
 			init_pair(21, 17, bg);  // Branch color
@@ -1278,43 +1002,113 @@ void handleResize(struct config *conf, struct ncursesObjects *objects,
 }
 
 void blitTree(struct VirtualGrid *skeleton, struct VirtualGrid *trunkPlane, int trunk_y,
-			  struct BranchList *branchList,
+			  struct VirtualGrid *canopy,
 			  struct ncursesObjects *objects, int off_x, int off_y) {
+	(void)trunk_y;  // taper baked into each trunk cell's widenHalf
 	werase(objects->treeWin);
-	if (trunkPlane)
-		drawWidenedTrunk(trunkPlane, objects->treeWin, trunk_y, off_x, off_y);
+	if (trunkPlane) {
+		struct windowCells wc = {.win = objects->treeWin, .off_x = off_x, .off_y = off_y};
+		getmaxyx(objects->treeWin, wc.h, wc.w);
+		widenedTrunkCells(trunkPlane, emitToWindow, &wc);
+	}
 	grid_blit_to_window(skeleton, objects->treeWin, off_x, off_y);
-	for (int i = 0; i < branchList->count; i++) {
-		if (branchList->branches[i].leafGrid)
-			grid_blit_to_window(branchList->branches[i].leafGrid, objects->treeWin, off_x, off_y);
+	grid_blit_to_window(canopy, objects->treeWin, off_x, off_y);
+}
+
+// Redraw what the tree's damage list says changed, instead of the whole
+// window. A glyph may be several columns wide and is overdrawn by the
+// cells after it, so a damaged rectangle is repainted as the whole window
+// rows it covers: each is blanked and its layers blitted again in
+// blitTree's order, which gives exactly what blitTree would. Leaves the
+// damage as is.
+void repaintDamage(const struct treeView *view, struct ncursesObjects *objects, int off_x, int off_y) {
+	WINDOW *win = objects->treeWin;
+	int wh, ww;
+	getmaxyx(win, wh, ww);
+	char rows[wh > 0 ? wh : 1];
+	memset(rows, 0, sizeof(rows));
+
+	int any = 0;
+	for (int n = 0; n < view->damage->count; n++) {
+		const struct damageRect *r = &view->damage->rect[n];
+		if (r->x1 + off_x <= 0 || r->x0 + off_x >= ww) continue;
+		for (int wy = r->y0 + off_y; wy < r->y1 + off_y; wy++) {
+			if (wy < 0 || wy >= wh || rows[wy]) continue;
+			wmove(win, wy, 0);
+			wclrtoeol(win);
+			rows[wy] = 1;
+			any = 1;
+		}
+	}
+	if (!any) return;
+
+	if (view->trunkPlane) {
+		struct windowCells wc = {.win = win, .off_x = off_x, .off_y = off_y, .w = ww, .h = wh, .rows = rows};
+		widenedTrunkCells(view->trunkPlane, emitToWindow, &wc);
+	}
+	for (int wy = 0; wy < wh; wy++) {
+		if (rows[wy]) grid_blit_row(view->skeleton, win, off_x, off_y, wy);
 	}
+	for (int wy = 0; wy < wh; wy++) {
+		if (rows[wy]) grid_blit_row(view->canopy->grid, win, off_x, off_y, wy);
+	}
+}
+
+// cellEmitter for blitTree: one widened-trunk cell, clipped to the window
+// (and to wc->rows)
+static void emitToWindow(void *ctx, int x, int y, const char *ch, unsigned int attrs, short pair) {
+	struct windowCells *wc = ctx;
+	int wx = x + wc->off_x, wy = y + wc->off_y;
+	if (wx < 0 || wx >= wc->w || wy < 0 || wy >= wc->h) return;
+	if (wc->rows && !wc->rows[wy]) return;
+	attr_t at = (attrs & CB_BOLD) ? A_BOLD : 0;
+	wattron(wc->win, at | COLOR_PAIR(pair));
+	mvwaddstr(wc->win, wy, wx, ch);
+	wattroff(wc->win, at | COLOR_PAIR(pair));
 }
 
 // One live-mode display step: blit, verbose output, screen update, then
 // sleep conf->timeStep while handling message timeout, quit and resize.
 // RNG-free: shared by all engines. Returns 1 if the user quit (caller
 // must free its state and exit), 0 otherwise.
-int liveStepDisplay(struct config *conf, struct ncursesObjects *objects,
-					struct VirtualGrid *skeleton, struct VirtualGrid *trunkPlane,
-					struct BranchList *branchList,
-					struct counters *myCounters,
-					int trunk_x, int trunk_y, int baseHeight,
-					int *off_x, int *off_y, int maxX, int maxY, int turn) {
-	if (conf->no_disp) return 0;
-
-	blitTree(skeleton, trunkPlane, trunk_y, branchList, objects, *off_x, *off_y);
+int liveStepDisplay(struct ncursesObjects *objects, const struct treeView *view,
+					int *off_x, int *off_y) {
+	struct config *conf = view->conf;
+	struct VirtualGrid *skeleton = view->skeleton, *trunkPlane = view->trunkPlane;
+	struct VirtualGrid *canopy = view->canopy->grid;
+	struct BranchList *branchList = view->branchList;
+	int trunk_y = view->trunk_y;
+
+	unsigned long long hudStart = hudFrameStart();
+	unsigned long long frameStart = statsStart();
+	unsigned long long phaseStart = profStart();
+	// the HUD and verbose lines overwrite the window; redraw it all under them
+	if (view->damage->all || conf->verbosity > 0)
+		blitTree(skeleton, trunkPlane, trunk_y, canopy, objects, *off_x, *off_y);
+	else
+		repaintDamage(view, objects, *off_x, *off_y);
+	damageReset(view->damage);
+	profRecord(PROF_BLIT, profElapsed(phaseStart));
 	if (conf->verbosity > 0) {
-		struct Branch *db = &branchList->branches[turn > 0 ? turn - 1 : 0];
-		mvwprintw(objects->treeWin, 2, 5, "maxX: %03d, maxY: %03d", maxX, maxY);
+		struct Branch *db = &branchList->branches[view->turn > 0 ? view->turn - 1 : 0];
+		mvwprintw(objects->treeWin, 2, 5, "maxX: %03d, maxY: %03d", view->maxX, view->maxY);
 		mvwprintw(objects->treeWin, 5, 5, "dx: %02d", db->dx);
 		mvwprintw(objects->treeWin, 6, 5, "dy: %02d", db->dy);
 		mvwprintw(objects->treeWin, 7, 5, "type: %d", db->type);
 		mvwprintw(objects->treeWin, 8, 5, "shootCooldown: % 3d", db->shootCooldown);
-		mvwprintw(objects->treeWin, 9, 5, "globalTime: %llu", myCounters->globalTime);
+		mvwprintw(objects->treeWin, 9, 5, "globalTime: %llu", view->counters->globalTime);
 		mvwprintw(objects->treeWin, 10, 5, "seed: %u", conf->seed);
+		hudDraw(objects->treeWin, skeleton, trunkPlane, view->canopy, branchList, hudStart);
 	}
+	unsigned long long termBefore = hudTermBytes();
+	phaseStart = profStart();
+	unsigned long long presentStart = traceStart();
 	update_panels();
 	doupdate();
+	profRecord(PROF_PRESENT, profElapsed(phaseStart));
+	traceEvent('X', "present", "frame", presentStart, traceStart(), NULL);
+	hudFramePresented(hudStart, termBefore);
+	statsFrame(frameStart);
 
 	float remaining = conf->timeStep;
 	while (remaining > 0) {
@@ -1330,1829 +1124,1544 @@ int liveStepDisplay(struct config *conf, struct ncursesObjects *objects,
 		struct timespec ts;
 		ts.tv_sec = (time_t)(sleepTime);
 		ts.tv_nsec = (long)((sleepTime - ts.tv_sec) * 1000000000);
-		nanosleep(&ts, NULL);
+		while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+			;	// --stats-file / --metrics signals must not cut the step short
 
-		int key = checkKeyPress(conf, myCounters);
+		int key = checkKeyPress(conf, view->counters);
 		if (key == 1) return 1;
 		if (key == 2) {
-			handleResize(conf, objects, trunk_x, trunk_y, baseHeight, off_x, off_y);
-			blitTree(skeleton, trunkPlane, trunk_y, branchList, objects, *off_x, *off_y);
+			handleResize(conf, objects, view->trunk_x, trunk_y, view->baseHeight, off_x, off_y);
+			blitTree(skeleton, trunkPlane, trunk_y, canopy, objects, *off_x, *off_y);
 			update_panels();
 			doupdate();
 		}
 
 		remaining -= sleepTime;
 	}
+	hudFrameEnd();
 	return 0;
 }
 
 // Hold the finished tree on screen until a real keypress; terminal
 // resizes just re-center and redraw it. RNG-free: shared by all engines.
-void finalHold(struct config *conf, struct ncursesObjects *objects,
-			   struct VirtualGrid *skeleton, struct VirtualGrid *trunkPlane,
-			   struct BranchList *branchList,
-			   int trunk_x, int trunk_y, int baseHeight, int *off_x, int *off_y) {
-	if (conf->no_disp || conf->infinite) return;
+void finalHold(struct ncursesObjects *objects, const struct treeView *view, int *off_x, int *off_y) {
+	if (view->conf->infinite) return;
 
 	nodelay(stdscr, FALSE);
 	while (wgetch(stdscr) == KEY_RESIZE) {
-		handleResize(conf, objects, trunk_x, trunk_y, baseHeight, off_x, off_y);
-		blitTree(skeleton, trunkPlane, trunk_y, branchList, objects, *off_x, *off_y);
+		handleResize(view->conf, objects, view->trunk_x, view->trunk_y, view->baseHeight, off_x, off_y);
+		blitTree(view->skeleton, view->trunkPlane, view->trunk_y, view->canopy->grid, objects, *off_x, *off_y);
 		update_panels();
 		doupdate();
 	}
 	nodelay(stdscr, TRUE);
 }
 
+// The curses frontend: the tree grows into the tree window, live steps go
+// through liveStepDisplay and the finished tree is drawn and held.
+static void cursesBegin(void *ctx, struct config *conf, int *maxY, int *maxX) {
+	struct cursesFrontend *cf = ctx;
+	(void)conf;
+	getmaxyx(cf->objects->treeWin, *maxY, *maxX);
+	cf->off_x = 0;
+	cf->off_y = 0;
+}
 
-// ==========================================================================
-// V1 ENGINE  (FROZEN — original global-rand growth; do not modify)
-// ==========================================================================
-
-// roll (randomize) a given die
-static inline void roll(int *dice, int mod) { *dice = rand() % mod; }
-
-struct ColorResult chooseColorResult(enum branchType type) {
-	struct ColorResult cr = {0, 0};
-	int r;
-	switch(type) {
-	case trunk:
-		r = rand() % 6;
-		if (r < 3) { cr.attrs = A_BOLD; cr.color_pair = 20; }
-		else if (r < 5) { cr.color_pair = 20; }
-		else { cr.color_pair = 21; }
-		break;
-
-	case shootLeft:
-	case shootRight:
-		r = rand() % 10;
-		if (r < 2) { cr.attrs = A_BOLD; cr.color_pair = 20; }
-		else if (r < 6) { cr.attrs = A_BOLD; cr.color_pair = 21; }
-		else { cr.color_pair = 21; }
-		break;
-
-	case dying:
-		r = rand() % 6;
-		if (r < 3) { cr.color_pair = 22; }
-		else if (r < 5) { cr.attrs = A_BOLD; cr.color_pair = 22; }
-		else { cr.color_pair = 23; }
-		break;
+static int cursesStep(void *ctx, const struct treeView *view) {
+	struct cursesFrontend *cf = ctx;
+	return liveStepDisplay(cf->objects, view, &cf->off_x, &cf->off_y);
+}
 
-	case dead:
-		r = rand() % 18;
-		if (r < 2) { cr.attrs = A_BOLD; cr.color_pair = 23; }
-		else if (r < 8) { cr.attrs = A_BOLD; cr.color_pair = 22; }
-		else { cr.color_pair = 22; }
-		break;
+static void cursesFinish(void *ctx, const struct treeView *view) {
+	struct cursesFrontend *cf = ctx;
+	if (cf->printOut) {
+		short palette[5][3];
+		seasonPalette(palette);
+		cf->printOut->len = 0;
+		renderText(view, palette, 0, cf->printOut);
+		return;
 	}
-	return cr;
+	blitTree(view->skeleton, view->trunkPlane, view->trunk_y, view->canopy->grid,
+			 cf->objects, cf->off_x, cf->off_y);
+	update_panels();
+	doupdate();
+	finalHold(cf->objects, view, &cf->off_x, &cf->off_y);
 }
 
-// determine change in X and Y coordinates of a given branch
-void setDeltas(enum branchType type, int life, int totalLife, int age, int multiplier, int *returnDx, int *returnDy) {
-	int dx = 0;
-	int dy = 0;
-	int dice;
-	switch (type) {
-	case trunk: // trunk
 
-		// new or dead trunk
-		if (age <= 2 || life < 4) {
-			dy = 0;
-			dx = (rand() % 3) - 1;
-		}
-		// young trunk should grow wide]
-		else if (isYoungTrunk(age, totalLife)) {
-			// every (multiplier * 0.6) steps, raise tree to next level
-			int step = (int)(multiplier * 0.6);
-			if (step < 1) step = 1;
-			if (age % step == 0) dy = -1;
-			else dy = 0;
-
-			roll(&dice, 10);
-			if (dice >= 0 && dice <=0) dx = -2;			// 10%
-			else if (dice >= 1 && dice <= 3) dx = -1;	// 30%
-			else if (dice >= 4 && dice <= 5) dx = 0;	// 20%
-			else if (dice >= 6 && dice <= 8) dx = 1;	// 30%
-			else if (dice >= 9 && dice <= 9) dx = 2;	// 10%
-		}
-		else if (isEarlyTrunk(age, totalLife)) {
-			// every (multiplier * 0.3) steps, raise tree to next level
-			int step = (int)(multiplier * 0.3);
-			if (step < 1) step = 1;
-			if (age % step == 0) dy = -1;
-			else dy = 0;
-
-			roll(&dice, 10);
-			if (dice >= 0 && dice <=0) dx = -2;			// 10%
-			else if (dice >= 1 && dice <= 3) dx = -1;	// 30%
-			else if (dice >= 4 && dice <= 5) dx = 0;	// 20%
-			else if (dice >= 6 && dice <= 8) dx = 1;	// 30%
-			else if (dice >= 9 && dice <= 9) dx = 2;	// 10%
-		}
-		// old-aged trunk
-		else {
-			roll(&dice, 10);
-			if (dice > 4) dy = -1;
-			else dy = 0;
-			
-			roll(&dice, 20);
-			if (dice >= 0 && dice <=0) dx = -2;			// 10%
-			else if (dice >= 1 && dice <= 7) dx = -1;	// 30%
-			else if (dice >= 8 && dice <= 12) dx = 0;	// 20%
-			else if (dice >= 13 && dice <= 18) dx = 1;	// 30%
-			else if (dice >= 19 && dice <= 19) dx = 2;	// 10%
-		}
-		break;
+// ==========================================================================
+// PERFORMANCE HUD  (-v live overlay)
+// ==========================================================================
 
-	case 1: // left shoot: trend left and little vertical movement
-		roll(&dice, 10);
-		if (dice >= 0 && dice <= 2) dy = -1;
-		else if (dice >= 3 && dice <= 7) dy = 0;
-		else if (dice >= 8 && dice <= 9) dy = 1;
-
-		roll(&dice, 10);
-		if (dice >= 0 && dice <=1) dx = -2;
-		else if (dice >= 2 && dice <= 5) dx = -1;
-		else if (dice >= 6 && dice <= 8) dx = 0;
-		else if (dice >= 9 && dice <= 9) dx = 1;
-		break;
+// -v performance HUD: NULL unless verbose
+static struct hud *hud = NULL;
 
-	case 2: // right shoot: trend right and little vertical movement
-		roll(&dice, 10);
-		if (dice >= 0 && dice <= 2) dy = -1;
-		else if (dice >= 3 && dice <= 7) dy = 0;
-		else if (dice >= 8 && dice <= 9) dy = 1;
-
-		roll(&dice, 10);
-		if (dice >= 0 && dice <=1) dx = 2;
-		else if (dice >= 2 && dice <= 5) dx = 1;
-		else if (dice >= 6 && dice <= 8) dx = 0;
-		else if (dice >= 9 && dice <= 9) dx = -1;
-		break;
+struct hud *hudCreate(void) {
+	struct hud *h = calloc(1, sizeof(struct hud));
+#ifdef __linux__
+	h->ioFd = open("/proc/self/io", O_RDONLY);
+#else
+	h->ioFd = -1;
+#endif
+	return h;
+}
 
-	case 3: // dying: discourage vertical growth(?); trend left/right (-3,3)
-		roll(&dice, 10);
-		if (dice >= 0 && dice <=0) dy = -1;
-		else if (dice >= 1 && dice <=8) dy = 0;
-		else if (dice >= 9 && dice <=9) dy = 1;
-
-		roll(&dice, 15);
-		if (dice >= 0 && dice <=0) dx = -3;
-		else if (dice >= 1 && dice <= 2) dx = -2;
-		else if (dice >= 3 && dice <= 5) dx = -1;
-		else if (dice >= 6 && dice <= 8) dx = 0;
-		else if (dice >= 9 && dice <= 11) dx = 1;
-		else if (dice >= 12 && dice <= 13) dx = 2;
-		else if (dice >= 14 && dice <= 14) dx = 3;
-		break;
+// Bytes this process has handed to write(2) so far. Sampled around
+// doupdate, the difference is exactly what curses sent the terminal that
+// frame. 0 without the HUD or where /proc/self/io is unavailable.
+static unsigned long long hudTermBytes(void) {
+	char buf[512];
+	if (!hud || hud->ioFd < 0) return 0;
+	ssize_t n = pread(hud->ioFd, buf, sizeof(buf) - 1, 0);
+	if (n <= 0) return 0;
+	buf[n] = '\0';
+	char *w = strstr(buf, "wchar:");
+	return w ? strtoull(w + 6, NULL, 10) : 0;
+}
 
-	case 4: // dead: fill in surrounding area
-		roll(&dice, 12);
-		if (dice >= 0 && dice <= 1) dy = -1;
-		else if (dice >= 2 && dice <= 8) dy = 0;
-		else if (dice >= 9 && dice <= 11) dy = 1;
-		
-		roll(&dice, 15);
-		if (dice >= 0 && dice <=1) dx = -3;
-		else if (dice >= 2 && dice <= 3) dx = -2;
-		else if (dice >= 4 && dice <= 5) dx = -1;
-		else if (dice >= 6 && dice <= 8) dx = 0;
-		else if (dice >= 9 && dice <= 10) dx = 1;
-		else if (dice >= 11 && dice <= 12) dx = 2;
-		else if (dice >= 13 && dice <= 14) dx = 3;
-		break;
-	}
+// Start of a live display step; everything since the previous step ended
+// was simulation, recorded as the tick time. Returns the start time (0
+// without the HUD).
+unsigned long long hudFrameStart(void) {
+	if (!hud) return 0;
+	unsigned long long now = monotonicNs();
+	if (hud->frameEndNs) {
+		hud->lastTickNs = now - hud->frameEndNs;
+		hist_record(&hud->tick, hud->lastTickNs);
+	}
+	return now;
+}
 
-	*returnDx = dx;
-	*returnDy = dy;
+// after doupdate: draw time and the bytes curses wrote for this frame
+void hudFramePresented(unsigned long long hudStart, unsigned long long termBefore) {
+	if (!hud) return;
+	hud->lastDrawNs = monotonicNs() - hudStart;
+	hud->lastTermBytes = hudTermBytes() - termBefore;
+	hud->termBytes += hud->lastTermBytes;
+	hud->frames++;
 }
 
-char* chooseString(const struct config *conf, enum branchType type, int life, int dx, int dy) {
-	char* branchStr;
+// end of a live display step (after its sleep)
+void hudFrameEnd(void) {
+	if (hud) hud->frameEndNs = monotonicNs();
+}
 
-	const unsigned int maxStrLen = 32;
+// Reformat the HUD lines from the frame measurements and a walk of the
+// branch list and grids (only here, at most every HUD_REFRESH_NS).
+void hudRefresh(const struct VirtualGrid *skeleton, const struct VirtualGrid *trunkPlane,
+				const struct canopy *canopy, const struct BranchList *list, unsigned long long now) {
+	int byType[dead + 1] = {0};
+	int walkers = 0;
+	size_t gridBytes = grid_bytes(skeleton) + canopyBytes(canopy);
+	if (trunkPlane)
+		gridBytes += grid_bytes(trunkPlane);
+	for (int i = 0; i < list->count; i++) {
+		const struct Branch *b = &list->branches[i];
+		byType[b->type]++;
+		walkers += b->walker_count;
+	}
+
+	double elapsed = hud->refreshNs ? (now - hud->refreshNs) / 1e9 : 0;
+	double fps = elapsed > 0 ? hud->frames / elapsed : 0;
+
+	snprintf(hud->lines[0], sizeof(hud->lines[0]), "fps: %5.1f  draw: %7.2f ms",
+			 fps, hud->lastDrawNs / 1e6);
+	snprintf(hud->lines[1], sizeof(hud->lines[1]), "tick: %8.1f us  p99: %8.1f us",
+			 hud->lastTickNs / 1e3, hist_percentile(&hud->tick, 99) / 1e3);
+	snprintf(hud->lines[2], sizeof(hud->lines[2]), "branches: %d (trunk %d, shoot %d, dying %d, dead %d)",
+			 list->count, byType[trunk], byType[shootLeft] + byType[shootRight],
+			 byType[dying], byType[dead]);
+	snprintf(hud->lines[3], sizeof(hud->lines[3]), "walkers: %d", walkers);
+	snprintf(hud->lines[4], sizeof(hud->lines[4]), "grid: %.1f KiB", gridBytes / 1024.0);
+	if (hud->ioFd >= 0)
+		snprintf(hud->lines[5], sizeof(hud->lines[5]), "term: %llu B/frame (last %llu B)",
+				 hud->frames ? hud->termBytes / hud->frames : 0, hud->lastTermBytes);
+	else
+		snprintf(hud->lines[5], sizeof(hud->lines[5]), "term: n/a");
 
-	branchStr = malloc(maxStrLen);
-	strcpy(branchStr, "?");	// fallback character
+	hud->refreshNs = now;
+	hud->frames = 0;
+	hud->termBytes = 0;
+}
 
-	if (life < 4) type = dying;
+// draw the cached HUD lines under the -v overlay, refreshing them if due
+void hudDraw(WINDOW *win, const struct VirtualGrid *skeleton, const struct VirtualGrid *trunkPlane,
+			 const struct canopy *canopy, const struct BranchList *list, unsigned long long now) {
+	if (!hud) return;
+	if (now - hud->refreshNs >= HUD_REFRESH_NS)
+		hudRefresh(skeleton, trunkPlane, canopy, list, now);
+	for (int i = 0; i < HUD_LINES; i++)
+		mvwprintw(win, 12 + i, 5, "%s", hud->lines[i]);
+}
 
-	switch(type) {
-	case trunk:
-		if (dy == 0) strcpy(branchStr, "/~");
-		else if (dx < 0) strcpy(branchStr, "\\|");
-		else if (dx == 0) strcpy(branchStr, "/|\\");
-		else if (dx > 0) strcpy(branchStr, "|/");
-		break;
-	case shootLeft:
-		if (dy > 0) strcpy(branchStr, "\\");
-		else if (dy == 0) strcpy(branchStr, "\\_");
-		else if (dx < 0) strcpy(branchStr, "\\|");
-		else if (dx == 0) strcpy(branchStr, "/|");
-		else if (dx > 0) strcpy(branchStr, "/");
-		break;
-	case shootRight:
-		if (dy > 0) strcpy(branchStr, "/");
-		else if (dy == 0) strcpy(branchStr, "_/");
-		else if (dx < 0) strcpy(branchStr, "\\|");
-		else if (dx == 0) strcpy(branchStr, "/|");
-		else if (dx > 0) strcpy(branchStr, "/");
-		break;
-	case dying:
-	case dead:
-		strncpy(branchStr, conf->leaves[rand() % conf->leavesSize], maxStrLen - 1);
-		branchStr[maxStrLen - 1] = '\0';
-	}
 
-	return branchStr;
-}
+// ==========================================================================
+// HEADLESS TOOLS  (no curses screen: bench harness)
+// ==========================================================================
 
-void updateBranch_v1(struct config *conf, struct VirtualGrid *skeleton,
-				struct counters *myCounters, int branchIdx,
-				struct BranchList* list) {
+// bench matrix: every engine x multiplier x life, each grown for seeds 1..N
+static const int benchMultipliers[] = {1, 5, 10, 15, 20};
 
-	struct Branch *branch = &list->branches[branchIdx];
-	branch->life--;     // decrement remaining life counter
+static const int benchLives[] = {10, 50, 100, 250, 500};
 
-	// Random die-off check - more likely on shoots
-	if (branch->type == trunk) {
-		if (rand() % 66 == 0) {   // 2% chance for trunk
-			branch->life -= (branch->life/2);  // Lose 1/4 of life
-		}
-	} else if (branch->type == shootLeft || branch->type == shootRight) {
-		if (rand() % 20 == 0) {    // 5% chance for shoots
-			branch->life /= 2;      // Lose half of life
-		}
-	}
+static double monotonicSeconds(void) {
+	return monotonicNs() / 1e9;
+}
 
-	branch->age++;
-
-	setDeltas(branch->type, branch->life, branch->totalLife,
-			  branch->age, branch->multiplier, &branch->dx, &branch->dy);
-
-	int groundY = skeleton->anchor_y + skeleton->height - getBaseHeight(conf->baseType);
-	if (branch->dy > 0 && branch->y > (groundY - 6))
-		branch->dy--;
-
-	// near-dead branch should branch into a lot of leaves
-	if (branch->life < 6) {
-		struct Branch newBranch = {
-			.x = branch->x,
-			.y = branch->y,
-			.type = dead,
-			.life = branch->life,
-			.age = 0,
-			.totalLife = branch->life,
-			.multiplier = branch->multiplier,
-			.shootCooldown = conf->multiplier,
-			.dripLeafCooldown = branch->life / 4,
-			.leaf_seed = rand(),
-			.history_count = 0,
-			.history_index = 0,
-			.x_history[0] = branch->x,
-			.y_history[0] = branch->y
-		};
-		addBranch(list, newBranch, myCounters);
-		branch = &list->branches[branchIdx];
-	}
-	else if (branch->type == shootLeft || branch->type == shootRight) {
-		if (branch->life < 7 + (branch->multiplier /5)) {
-			struct Branch newBranch = {
-				.x = branch->x,
-				.y = branch->y,
-				.type = dying,
-				.life = branch->life + 1,
-				.age = 0,
-				.totalLife = branch->life + 1,
-				.multiplier = branch->multiplier,
-				.shootCooldown = conf->multiplier,
-				.dripLeafCooldown = (branch->life + 1) / 4,
-				.leaf_seed = rand(),
-				.history_count = 0,
-				.history_index = 0,
-				.x_history[0] = branch->x,
-				.y_history[0] = branch->y
-			};
-			addBranch(list, newBranch, myCounters);
-			branch = &list->branches[branchIdx];
-		}
-		else if (branch->dripLeafCooldown <= 0 && (rand() % 3) == 0) {
-			struct Branch newBranch = {
-				.x = branch->x,
-				.y = branch->y,
-				.type = dying,
-				.life = 5,
-				.age = 0,
-				.totalLife = 5,
-				.multiplier = branch->multiplier,
-				.shootCooldown = conf->multiplier,
-				.dripLeafCooldown = (branch->multiplier*2)/3,
-				.leaf_seed = rand(),
-				.history_count = 0,
-				.history_index = 0,
-				.x_history[0] = branch->x,
-				.y_history[0] = branch->y
-			};
-			addBranch(list, newBranch, myCounters);
-			branch = &list->branches[branchIdx];
-			branch->dripLeafCooldown = 7+ (25 + branch->multiplier);
-		}
-	}
-	// dying trunk should branch into a lot of leaves
-	else if (branch->type == trunk && branch->life < (branch->multiplier + 2)) {
-		struct Branch newBranch = {
-			.x = branch->x,
-			.y = branch->y,
-			.type = dying,
-			.life = branch->life,
-			.age = 0,
-			.totalLife = branch->life,
-			.multiplier = branch->multiplier,
-			.shootCooldown = conf->multiplier,
-			.dripLeafCooldown = branch->life / 4,
-			.leaf_seed = rand(),
-			.history_count = 0,
-			.history_index = 0,
-			.x_history[0] = branch->x,
-			.y_history[0] = branch->y
-		};
-		addBranch(list, newBranch, myCounters);
-		branch = &list->branches[branchIdx];
-	}
-	// dying shoot should branch into a lot of leaves
-	else if ((branch->type == shootLeft || branch->type == shootRight) && 
-			 branch->life < (branch->multiplier + 2)) {
-		struct Branch newBranch = {
-			.x = branch->x,
-			.y = branch->y,
-			.type = dying,
-			.life = branch->life,
-			.age = 0,
-			.totalLife = branch->life,
-			.multiplier = branch->multiplier,
-			.shootCooldown = conf->multiplier,
-			.dripLeafCooldown = branch->life / 4,
-			.leaf_seed = rand(),
-			.history_count = 0,
-			.history_index = 0,
-			.x_history[0] = branch->x,
-			.y_history[0] = branch->y
-		};
-		addBranch(list, newBranch, myCounters);
-		branch = &list->branches[branchIdx];
-	}
-	else if (branch->type == trunk) {
-		branch->life--;
-		// First check for trunk splits - only in early phase and with enough life
-		if (!isYoungTrunk(branch->age, branch->totalLife)) {
-			int splitThreshold = (24 - branch->multiplier) + (2 * myCounters->trunks);
-			double ageRatio = (double)branch->age / branch->totalLife;
-
-			if (ageRatio < 0.1) {      // Bottom 10%
-				splitThreshold = (splitThreshold * 2)/7;
-			} else if (ageRatio < 0.4) {
-				splitThreshold = (splitThreshold * 3)/7;
-			} else {
-				splitThreshold = (splitThreshold * 5)/7;
-			}
+// Time both engines over the bench matrix and print one row per
+// (engine, M, L) cell. Live procedural mode is forced on so the live
+// leafStep_v2 walkers are part of every measurement. Returns 0.
+int runBench(const struct config *conf, int seeds) {
+	int nM = (int)(sizeof(benchMultipliers) / sizeof(benchMultipliers[0]));
+	int nL = (int)(sizeof(benchLives) / sizeof(benchLives[0]));
+	unsigned long long allTicks = 0;
+	double allWall = 0;
+
+	printf("cbonsai bench: %dx%d, base %d, seeds 1..%d\n",
+		   conf->cols, conf->rows, conf->baseType, seeds);
+	printf("%-6s %3s %4s %12s %10s %9s %8s %10s\n",
+		   "engine", "M", "L", "ticks/s", "ms/tree", "branches", "walkers", "grid KiB");
+
+	for (int version = 1; version <= 2; version++) {
+		for (int mi = 0; mi < nM; mi++) {
+			for (int li = 0; li < nL; li++) {
+				unsigned long long ticks = 0;
+				double wall = 0;
+				int peakBranches = 0, peakWalkers = 0;
+				size_t gridBytes = 0;
+
+				for (int seed = 1; seed <= seeds; seed++) {
+					struct config run = *conf;
+					struct counters myCounters = {0};
+					run.version = version;
+					run.multiplier = benchMultipliers[mi];
+					run.lifeStart = benchLives[li];
+					run.seed = seed;
+					run.live = 1;
+					run.proceduralMode = 1;
+					run.load = 0;
+					run.save = 0;
+
+					double start = monotonicSeconds();
+					growHeadless(&run, &myCounters);
+					wall += monotonicSeconds() - start;
+
+					ticks += myCounters.globalTime;
+					if (myCounters.peakBranches > peakBranches) peakBranches = myCounters.peakBranches;
+					if (myCounters.peakWalkers > peakWalkers) peakWalkers = myCounters.peakWalkers;
+					gridBytes += myCounters.gridBytes;
+				}
 
-			if (myCounters->trunkSplitCooldown < 0 && rand() % splitThreshold == 0) {
-				myCounters->trunkSplitCooldown = 2 + ((22 - conf->multiplier)*3)/4 +
-					(int)(5 * ((double)branch->totalLife - branch->age)/branch->totalLife);
-				myCounters->trunks++;
-				branch->shootCooldown = (25 - branch->multiplier)/4;
-				struct Branch newBranch = {
-					.x = branch->x,
-					.y = branch->y,
-					.type = trunk,
-					.life = branch->life - (rand() % 6),
-					.age = 0,
-					.totalLife = branch->life - (rand() % 6),
-					.multiplier = branch->multiplier,
-					.shootCooldown = conf->multiplier,
-					.dripLeafCooldown = branch->life / 4,
-					.leaf_seed = rand(),
-					.history_count = 0,
-					.history_index = 0,
-					.x_history[0] = branch->x,
-					.y_history[0] = branch->y
-				};
-				addBranch(list, newBranch, myCounters);
-				branch = &list->branches[branchIdx];
-				branch->life -= rand() % 1+ (int)(5 * ((double)branch->totalLife - branch->age)/branch->totalLife); // cost of splitting
+				printf("v%-5d %3d %4d %12.0f %10.3f %9d %8d %10.1f\n",
+					   version, benchMultipliers[mi], benchLives[li],
+					   wall > 0 ? ticks / wall : 0.0,
+					   wall * 1000.0 / seeds,
+					   peakBranches, peakWalkers,
+					   gridBytes / 1024.0 / seeds);
+				fflush(stdout);
+				allTicks += ticks;
+				allWall += wall;
 			}
 		}
-
-		// Then check for regular branch shoots
-		int branchDice = getBranchRollThreshold(branch->age, branch->totalLife, branch->multiplier);
-		if (branch->shootCooldown <= 0 && (rand() % branchDice == 0)) {
-			branch->shootCooldown = myCounters->trunks + (25 - branch->multiplier)/6;
-			int shootLife = ((branch->life * 3)/4 + (rand() % branch->multiplier) - 2);
-			
-			myCounters->shoots++;
-			myCounters->shootCounter++;
-			(void)0; // verbose shoot count displayed during render
-			
-			struct Branch newBranch = {
-				.x = branch->x,
-				.y = branch->y,
-				.type = (enum branchType)((myCounters->shootCounter % 2) + 1),
-				.life = shootLife,
-				.age = 0,
-				.totalLife = shootLife,
-				.multiplier = branch->multiplier,
-				.shootCooldown = conf->multiplier,
-				.dripLeafCooldown = shootLife / 4,
-				.leaf_seed = rand(),
-				.history_count = 0,
-				.history_index = 0,
-				.x_history[0] = branch->x,
-				.y_history[0] = branch->y
-			};
-			addBranch(list, newBranch, myCounters);
-			branch = &list->branches[branchIdx];
-
-			branch->life -= rand() % 3; // cost of sprouting
-		}
 	}
-	myCounters->trunkSplitCooldown--;
-	branch->shootCooldown--;
-	branch->dripLeafCooldown--;
-
-	// move in x and y directions
-	branch->x += branch->dx;
-	branch->y += branch->dy;
-	if(conf->proceduralMode && branch->type != dying && branch->type != dead)
-		update_position_history(branch);
-
-	enum branchType displayType = (branch->life < 4) ? dying : branch->type;
-	struct ColorResult cr = chooseColorResult(displayType);
-
-	// choose string to use for this branch
-	char *branchStr = chooseString(conf, displayType, branch->life, branch->dx, branch->dy);
-
-	// grab wide character from branchStr
-	wchar_t wc = 0;
-	mbstate_t ps = {0};
-	mbrtowc(&wc, branchStr, 32, &ps);
-
-	// write to grid, but ensure wide characters don't overlap
-	int w = wcwidth(wc);
-	if (w <= 0) w = 1;
-	if(branch->x % w == 0) {
-		grid_put(skeleton, branch->x, branch->y, branchStr, cr.attrs, cr.color_pair);
-	}
-
-	free(branchStr);
-}
-
-static void leafStepWalkers(struct config *conf, struct VirtualGrid *grid,
-							enum branchType type, int groundY,
-							struct LeafWalker **walkers, int *count, int *capacity) {
-	int prev_count = *count;
-	for (int w = 0; w < prev_count; w++) {
-		struct LeafWalker *wk = &(*walkers)[w];
-
-		int dx = 0, dy = 0, dice;
-		switch (type) {
-		case dying:
-			dice = rand_r(&wk->seed) % 10;
-			if (dice >= 0 && dice <= 0) dy = -1;
-			else if (dice >= 1 && dice <= 8) dy = 0;
-			else if (dice >= 9 && dice <= 9) dy = 1;
-
-			dice = rand_r(&wk->seed) % 15;
-			if (dice >= 0 && dice <= 0) dx = -3;
-			else if (dice >= 1 && dice <= 2) dx = -2;
-			else if (dice >= 3 && dice <= 5) dx = -1;
-			else if (dice >= 6 && dice <= 8) dx = 0;
-			else if (dice >= 9 && dice <= 11) dx = 1;
-			else if (dice >= 12 && dice <= 13) dx = 2;
-			else if (dice >= 14 && dice <= 14) dx = 3;
-			break;
-		case dead:
-			dice = rand_r(&wk->seed) % 12;
-			if (dice >= 0 && dice <= 1) dy = -1;
-			else if (dice >= 2 && dice <= 8) dy = 0;
-			else if (dice >= 9 && dice <= 11) dy = 1;
-
-			dice = rand_r(&wk->seed) % 15;
-			if (dice >= 0 && dice <= 1) dx = -3;
-			else if (dice >= 2 && dice <= 3) dx = -2;
-			else if (dice >= 4 && dice <= 5) dx = -1;
-			else if (dice >= 6 && dice <= 8) dx = 0;
-			else if (dice >= 9 && dice <= 10) dx = 1;
-			else if (dice >= 11 && dice <= 12) dx = 2;
-			else if (dice >= 13 && dice <= 14) dx = 3;
-			break;
-		default:
-			break;
-		}
 
-		if (dy > 0 && wk->y > (groundY - 2))
-			dy--;
+	printf("total: %llu ticks in %.3f s (%.0f ticks/s)\n",
+		   allTicks, allWall, allWall > 0 ? allTicks / allWall : 0.0);
+	return 0;
+}
+
+// Golden determinism corpus. Each non-comment line of `path` is
+//   v<engine> <seed> <multiplier> <life> <base> <leaves> <bare> <procedural> [hash]
+// Every tree is regrown headlessly and its final grid_hash compared with
+// the recorded one. With `update`, the file is rewritten with fresh hashes
+// instead (for new entries, or a deliberate engine change). Returns 0 when
+// every entry matches, 1 on any mismatch or unreadable entry.
+int runCheck(const struct config *conf, const char *path, int update) {
+	FILE *fp = fopen(path, "r");
+	if (!fp) {
+		printf("error: could not open golden corpus: %s\n", path);
+		return 1;
+	}
 
-		unsigned int child_seed = rand_r(&wk->seed);
-		if (*count < 4096) {
-			if (*count >= *capacity) {
-				*capacity *= 2;
-				*walkers = realloc(*walkers, sizeof(struct LeafWalker) * (size_t)*capacity);
-				wk = &(*walkers)[w];
+	char *out = NULL;
+	size_t outLen = 0, outCap = 0;
+	char line[512];
+	int lineNo = 0, trees = 0, failures = 0;
+
+	while (fgets(line, sizeof(line), fp)) {
+		lineNo++;
+		char outLine[512];
+		int version, seed, multiplier, life, base, bare, procedural;
+		char leaves[256], expected[32] = "";
+		int fields = sscanf(line, "v%d %d %d %d %d %255s %d %d %31s", &version, &seed,
+							&multiplier, &life, &base, leaves, &bare, &procedural, expected);
+
+		if (line[0] == '#' || line[0] == '\n') {
+			snprintf(outLine, sizeof(outLine), "%s", line);
+		} else if (fields < 8) {
+			printf("%s:%d: malformed entry\n", path, lineNo);
+			failures++;
+			snprintf(outLine, sizeof(outLine), "%s", line);
+		} else {
+			struct config run = *conf;
+			struct counters myCounters = {0};
+			char leafList[256];
+			memcpy(leafList, leaves, sizeof(leafList));
+			run.version = version;
+			run.seed = seed;
+			run.multiplier = multiplier;
+			run.lifeStart = life;
+			run.baseType = base;
+			run.hideLeaves = bare;
+			run.proceduralMode = procedural;
+			run.live = procedural;	// exercise the live leaf walkers too
+			run.cols = CHECK_COLS;
+			run.rows = CHECK_ROWS;
+			run.load = 0;
+			run.save = 0;
+			run.message = NULL;
+			parseLeaves(&run, leafList);
+
+			growHeadless(&run, &myCounters);
+			trees++;
+
+			char actual[32];
+			snprintf(actual, sizeof(actual), "%016llx", myCounters.gridHash);
+			if (!update && strcmp(actual, expected) != 0) {
+				printf("%s:%d: v%d seed %d -M %d -L %d -b %d -c %s bare %d procedural %d: "
+					   "expected %s, got %s\n", path, lineNo, version, seed, multiplier,
+					   life, base, leaves, bare, procedural,
+					   expected[0] ? expected : "(none)", actual);
+				failures++;
 			}
-			(*walkers)[(*count)++] = (struct LeafWalker){.x = wk->x, .y = wk->y, .seed = child_seed};
+			snprintf(outLine, sizeof(outLine), "v%d %d %d %d %d %s %d %d %s\n", version, seed,
+					 multiplier, life, base, leaves, bare, procedural, actual);
 		}
 
-		wk->x += dx;
-		wk->y += dy;
-
-		if (wk->y >= 0 && wk->y < groundY) {
-			attr_t la = 0;
-			short lc = 0;
-			switch (type) {
-			case dying:
-				if (rand_r(&wk->seed) % 6 == 0) { lc = 22; }
-				else if (rand_r(&wk->seed) % 2 == 0) { la = A_BOLD; lc = 23; }
-				else { lc = 23; }
-				break;
-			case dead:
-				if (rand_r(&wk->seed) % 7 == 0) { la = A_BOLD; lc = 22; }
-				else if (rand_r(&wk->seed) % 2 == 0) { la = A_BOLD; lc = 23; }
-				else { lc = 23; }
-				break;
-			default:
-				break;
+		if (update) {
+			size_t len = strlen(outLine);
+			if (outLen + len + 1 > outCap) {
+				outCap = (outCap ? outCap * 2 : 4096) + len;
+				out = realloc(out, outCap);
 			}
-
-			grid_put(grid, wk->x, wk->y, conf->leaves[rand_r(&wk->seed) % conf->leavesSize], la, lc);
+			memcpy(out + outLen, outLine, len + 1);
+			outLen += len;
 		}
 	}
-}
-
-void generateLeaves_v1(struct config *conf, struct VirtualGrid *grid, enum branchType type, int x, int y, int life, unsigned int leaf_seed, int groundY) {
-	int capacity = 16;
-	int count = 1;
-	struct LeafWalker *walkers = malloc(sizeof(struct LeafWalker) * (size_t)capacity);
-	walkers[0] = (struct LeafWalker){.x = x, .y = y, .seed = leaf_seed};
+	fclose(fp);
 
-	for (int step = 0; step < life; step++) {
-		leafStepWalkers(conf, grid, type, groundY, &walkers, &count, &capacity);
+	if (update) {
+		fp = fopen(path, "w");
+		if (!fp) {
+			printf("error: could not write golden corpus: %s\n", path);
+			free(out);
+			return 1;
+		}
+		if (outLen) fwrite(out, 1, outLen, fp);
+		fclose(fp);
+		free(out);
+		printf("check: recorded %d trees in %s\n", trees, path);
+		return failures ? 1 : 0;
 	}
 
-	free(walkers);
+	printf("check: %d trees, %d mismatches\n", trees, failures);
+	return failures ? 1 : 0;
 }
 
-// v1 engine: frozen. Consumes the global rand() stream seeded by srand();
-// any change to its rand() call sequence breaks replay of saved v1 trees.
-void growTree_v1(struct config *conf, struct ncursesObjects *objects, struct counters *myCounters) {
-	int maxY, maxX;
-	getmaxyx(objects->treeWin, maxY, maxX);
-
-	int baseHeight = getBaseHeight(conf->baseType);
-	struct VirtualGrid *skeleton = grid_create(maxX, maxY + baseHeight, 0, 0);
-	struct VirtualGrid *trunkPlane = grid_create(maxX, maxY + baseHeight, 0, 0);
-	struct VirtualGrid *renderPlane = NULL;  // v1: never render the widened trunk (frozen look)
-	int trunk_x = maxX / 2;
-	int trunk_y = maxY - 1 - baseHeight;
-	int off_x = 0, off_y = 0;
-	int rimLo = trunk_x, rimHi = trunk_x;
-
-	drawBaseToGrid(skeleton, conf->baseType, trunk_x, trunk_y);
-	drawPotRim(skeleton, conf->baseType, trunk_x, trunk_y, rimLo, rimHi);
-
-	struct BranchList branchList;
-	initBranchList(&branchList);
-
-	myCounters->trunks = 0;
-	myCounters->shoots = 0;
-	myCounters->branches = 0;
-	myCounters->shootCounter = 5;
-	myCounters->globalTime = 0;
-	myCounters->trunkSplitCooldown = 0;
-
-	struct Branch initialBranch = {
-		.x = trunk_x,
-		.y = trunk_y,
-		.life = conf->lifeStart,
-		.age = 0,
-		.type = trunk,
-		.shootCooldown = conf->multiplier,
-		.dripLeafCooldown = conf->multiplier + conf->lifeStart / 4,
-		.totalLife = conf->lifeStart,
-		.multiplier = conf->multiplier
-	};
-	addBranch(&branchList, initialBranch, myCounters);
-
-	int turn = 0;
-	while (branchList.count > 0) {
-		myCounters->globalTime++;
-
-		if (branchList.branches[turn].life <= 0) {
-			struct Branch* b = &branchList.branches[turn];
-			if (conf->proceduralMode &&
-				b->type != dying && b->type != dead &&
-				b->totalLife > 0) {
-				double lifeRatio = ((double)b->age) / b->totalLife;
-				unsigned int leaf_seed = b->leaf_seed;
-
-				int avg_x, avg_y;
-				get_average_position(b, &avg_x, &avg_y);
-
-				int log_factor = 0, dummy = b->age;
-				while(dummy > 0) {
-					log_factor++;
-					dummy >>= 1;
-				}
-
-				int leafLife = log_factor + lifeRatio * ((b->type == trunk) ? 4 : 3);
-				enum branchType newType = (b->type == trunk) ? dead : dying;
-
-				generateLeaves_v1(conf, skeleton, newType, avg_x, avg_y, leafLife, leaf_seed, trunk_y + 1);
-			}
+// whole line of any length (state trace lines grow with the branch count);
+// caller frees, NULL at EOF
+static char *readLine(FILE *fp) {
+	size_t cap = 256, len = 0;
+	char *buf = malloc(cap);
+	while (fgets(buf + len, (int)(cap - len), fp)) {
+		len += strlen(buf + len);
+		if (len > 0 && buf[len - 1] == '\n') return buf;
+		cap *= 2;
+		buf = realloc(buf, cap);
+	}
+	if (len > 0) return buf;
+	free(buf);
+	return NULL;
+}
 
-			free(b->walkers);
-			b->walkers = NULL;
-			b->walker_count = 0;
-			b->walker_capacity = 0;
-			grid_destroy(b->leafGrid);
-			b->leafGrid = NULL;
+// Compare two --state-trace files and report the first tick where they
+// disagree: which of rng / grid / branch count differ, and the first branch
+// index whose hash differs. Returns 0 if identical, 1 on divergence.
+int runStateDiff(const char *pathA, const char *pathB) {
+	FILE *fa = fopen(pathA, "r");
+	FILE *fb = fopen(pathB, "r");
+	if (!fa || !fb) {
+		printf("error: could not open trace: %s\n", fa ? pathB : pathA);
+		if (fa) fclose(fa);
+		if (fb) fclose(fb);
+		return 1;
+	}
 
-			removeBranch(&branchList, turn);
-			if (turn >= branchList.count) {
-				turn = 0;
+	int ret = 0;
+	unsigned long long ticks = 0;
+	char *la = NULL, *lb = NULL;
+	for (;;) {
+		free(la);
+		free(lb);
+		la = readLine(fa);
+		lb = readLine(fb);
+		if (!la || !lb) {
+			if (la || lb) {
+				printf("traces agree for %llu ticks, then %s ends\n", ticks, la ? pathB : pathA);
+				ret = 1;
+			} else {
+				printf("traces identical (%llu ticks)\n", ticks);
 			}
+			break;
+		}
+		if (la[0] == '#' || lb[0] == '#') {
+			if (strcmp(la, lb) != 0)
+				printf("warning: trace headers differ:\n  %s  %s", la, lb);
+			continue;
+		}
+		if (strcmp(la, lb) == 0) {
+			ticks++;
 			continue;
 		}
 
-		updateBranch_v1(conf, skeleton, myCounters, turn, &branchList);
-
-		// record trunk cells in the trunk plane (tracking only, never
-		// blitted) and keep the pot rim hugging the trunk's footprint
-		{
-			struct Branch *ub = &branchList.branches[turn];
-			if (ub->type == trunk) {
-				grid_put(trunkPlane, ub->x, ub->y, "#", 0, 0);
-				if (ub->y == trunk_y && (ub->x < rimLo || ub->x > rimHi)) {
-					if (ub->x < rimLo) rimLo = ub->x;
-					if (ub->x > rimHi) rimHi = ub->x;
-					drawPotRim(skeleton, conf->baseType, trunk_x, trunk_y, rimLo, rimHi);
-				}
+		unsigned long long tick = 0, rngA = 0, rngB = 0, gridA = 0, gridB = 0;
+		int turn = 0, countA = 0, countB = 0;
+		sscanf(la, "%llu %d %d %llx %llx", &tick, &turn, &countA, &rngA, &gridA);
+		sscanf(lb, "%*u %*d %d %llx %llx", &countB, &rngB, &gridB);
+		printf("first divergence at tick %llu (turn %d):\n", tick, turn);
+		if (rngA != rngB) printf("  rng streams differ\n");
+		if (gridA != gridB) printf("  skeleton/trunk plane differ\n");
+		if (countA != countB) printf("  branch count differs: %d vs %d\n", countA, countB);
+
+		char *pa = strchr(la, ':'), *pb = strchr(lb, ':');
+		for (int i = 0; pa && pb; i++) {
+			char *ea, *eb;
+			unsigned long ha = strtoul(pa + 1, &ea, 16);
+			unsigned long hb = strtoul(pb + 1, &eb, 16);
+			if (ea == pa + 1 || eb == pb + 1) break;
+			if (ha != hb) {
+				printf("  first differing branch: index %d\n", i);
+				break;
 			}
+			pa = ea;
+			pb = eb;
 		}
+		ret = 1;
+		break;
+	}
 
-		if (conf->live && conf->proceduralMode) {
-			for (int i = 0; i < branchList.count; i++) {
-				struct Branch* b = &branchList.branches[i];
-
-				if (b->type != trunk && b->type != shootLeft && b->type != shootRight)
-					continue;
-				if (b->totalLife <= 0)
-					continue;
+	free(la);
+	free(lb);
+	fclose(fa);
+	fclose(fb);
+	return ret;
+}
 
-				int avg_x, avg_y;
-				get_average_position(b, &avg_x, &avg_y);
 
-				int log_factor = 0, dummy = b->age;
-				while(dummy > 0) {
-					log_factor++;
-					dummy >>= 1;
-				}
+// ==========================================================================
+// TEXT OUTPUT + BATCH  (no curses: trees rendered straight from the grids)
+// ==========================================================================
 
-				double lifeRatio = ((double)b->age) / b->totalLife;
-				int targetLeafLife = log_factor + lifeRatio * ((b->type == trunk) ? 4 : 3);
-
-				if (!b->walkers) {
-					b->walker_capacity = 16;
-					b->walker_count = 1;
-					b->walkers = malloc(sizeof(struct LeafWalker) * (size_t)b->walker_capacity);
-					b->walkers[0] = (struct LeafWalker){.x = avg_x, .y = avg_y, .seed = b->leaf_seed};
-					b->leaf_steps_drawn = 0;
-					b->leaf_cur_x = avg_x;
-					b->leaf_cur_y = avg_y;
-					b->leafGrid = grid_create(40, 40, avg_x - 20, avg_y - 20);
-				}
+// Seasonal RGB (init_color's 0-1000 scale) of the custom colours 16-19 and
+// 25: trunk, branch, leaf, darker leaf, deadwood. Not thread-safe
+// (localtime); batch workers use a copy taken up front.
+static void seasonPalette(short rgb[5][3]) {
+	float blend_ratio;
+	enum Season season = get_current_season_with_blend(&blend_ratio);
 
-				if (avg_x != b->leaf_cur_x || avg_y != b->leaf_cur_y) {
-					int delta_x = avg_x - b->leaf_cur_x;
-					int delta_y = avg_y - b->leaf_cur_y;
-					for (int w = 0; w < b->walker_count; w++) {
-						b->walkers[w].x += delta_x;
-						b->walkers[w].y += delta_y;
-					}
-					b->leafGrid->anchor_x += delta_x;
-					b->leafGrid->anchor_y += delta_y;
-					b->leaf_cur_x = avg_x;
-					b->leaf_cur_y = avg_y;
-				}
+	struct ColorRGB current_colors = season_colors[season];
+	struct ColorRGB prev_colors = season_colors[(season + 4) % 5];
 
-				if (b->leaf_steps_drawn < targetLeafLife) {
-					enum branchType leafType = (b->type == trunk) ? dead : dying;
-					leafStepWalkers(conf, b->leafGrid, leafType, trunk_y + 1,
-									&b->walkers, &b->walker_count, &b->walker_capacity);
-					b->leaf_steps_drawn++;
-				}
-			}
-		}
+	const short fixed[3][3] = {
+		{540, 270, 0},      // lighter brown: trunk
+		{280, 140, 0},      // darker brown: branches
+		{560, 510, 420},    // weathered deadwood (jin/shari): muted driftwood
+	};
+	memcpy(rgb[0], fixed[0], sizeof(rgb[0]));
+	memcpy(rgb[1], fixed[1], sizeof(rgb[1]));
+	rgb[2][0] = interpolate_color(current_colors.r,   prev_colors.r,   blend_ratio);
+	rgb[2][1] = interpolate_color(current_colors.g,   prev_colors.g,   blend_ratio);
+	rgb[2][2] = interpolate_color(current_colors.b,   prev_colors.b,   blend_ratio);
+	rgb[3][0] = interpolate_color(current_colors.r_2, prev_colors.r_2, blend_ratio);
+	rgb[3][1] = interpolate_color(current_colors.g_2, prev_colors.g_2, blend_ratio);
+	rgb[3][2] = interpolate_color(current_colors.b_2, prev_colors.b_2, blend_ratio);
+	memcpy(rgb[4], fixed[2], sizeof(rgb[4]));
+}
 
-		turn = (turn + 1) % branchList.count;
+void textAppend(struct textBuf *b, const char *s, size_t n) {
+	if (b->len + n > b->cap) {
+		b->cap = (b->len + n) * 2 > 4096 ? (b->len + n) * 2 : 4096;
+		b->data = realloc(b->data, b->cap);
+	}
+	memcpy(b->data + b->len, s, n);
+	b->len += n;
+}
 
-		if (conf->live && !(conf->load && myCounters->globalTime < conf->targetGlobalTime)) {
-			if (liveStepDisplay(conf, objects, skeleton, renderPlane, &branchList, myCounters,
-								trunk_x, trunk_y, baseHeight, &off_x, &off_y,
-								maxX, maxY, turn)) {
-				freeBranchList(&branchList);
-				grid_destroy(skeleton);
-				grid_destroy(trunkPlane);
-				quit(conf, objects, 0);
+// Draw str at (x, y) the way curses would: one character per column, a
+// double-width one taking two, clipped at the canvas edge. Overwriting
+// half of a double-width character blanks its other half.
+static void textPut(struct textCanvas *cv, int x, int y, const char *str, unsigned int attrs, short pair) {
+	if (y < 0 || y >= cv->h) return;
+	struct textCell *row = &cv->cells[y * cv->w];
+	mbstate_t st;
+	memset(&st, 0, sizeof(st));
+	size_t left = strlen(str);
+	while (left > 0 && x < cv->w) {
+		wchar_t wc;
+		size_t n = mbrtowc(&wc, str, left, &st);
+		int width;
+		if (n == (size_t)-1 || n == (size_t)-2 || n == 0) {
+			// not a UTF-8 locale: the glyphs are UTF-8 all the same, so
+			// step over one sequence and call it one column
+			unsigned char lead = (unsigned char)*str;
+			n = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+			if (n > left) n = left;
+			width = 1;
+			memset(&st, 0, sizeof(st));
+		} else {
+			width = wcwidth(wc);
+			if (width < 1) width = 1;
+		}
+		if (x >= 0) {
+			for (int d = 0; d < width && x + d < cv->w; d++) {
+				struct textCell *tc = &row[x + d];
+				if (tc->wide == -1 && x + d > 0) row[x + d - 1] = (struct textCell){0};
+				if (tc->wide == 1 && x + d + 1 < cv->w) row[x + d + 1] = (struct textCell){0};
 			}
+			if (width == 2 && x + 1 >= cv->w) break;	// no room for both halves
+			struct textCell *tc = &row[x];
+			memcpy(tc->ch, str, n < sizeof(tc->ch) ? n : sizeof(tc->ch) - 1);
+			tc->ch[n < sizeof(tc->ch) ? n : sizeof(tc->ch) - 1] = '\0';
+			tc->attrs = attrs;
+			tc->pair = pair;
+			tc->wide = (width == 2);
+			if (width == 2) row[x + 1] = (struct textCell){.wide = -1};
 		}
+		x += width;
+		str += n;
+		left -= n;
 	}
+}
 
-	if (!conf->no_disp) {
-		blitTree(skeleton, renderPlane, trunk_y, &branchList, objects, off_x, off_y);
-		update_panels();
-		doupdate();
-	}
-
-	finalHold(conf, objects, skeleton, renderPlane, &branchList, trunk_x, trunk_y, baseHeight, &off_x, &off_y);
-
-	freeBranchList(&branchList);
+// cellEmitter for renderText: one widened-trunk cell
+static void emitToText(void *ctx, int x, int y, const char *ch, unsigned int attrs, short pair) {
+	textPut(ctx, x, y, ch, attrs, pair);
+}
 
-	grid_destroy(skeleton);
-	grid_destroy(trunkPlane);
+static void textBlitGrid(struct textCanvas *cv, const struct VirtualGrid *g) {
+	struct gridIter it;
+	for (gridIterBegin(&it, g); gridIterNext(&it); ) {
+		const struct gridTile *t = it.tile;
+		textPut(cv, g->anchor_x + it.lx, g->anchor_y + it.ly, grid_glyph(g, t, it.i),
+				t->attrs[it.i], t->color[it.i]);
+	}
 }
 
+// SGR escape selecting bold and a colour pair's foreground, as init()
+// sets the pairs up on a 256-colour terminal: pairs 1-15 are the 16
+// standard colours, 20-24 the seasonal palette in 24-bit colour, anything
+// else the terminal default. Returns its length.
+static int textSgr(char *buf, size_t size, unsigned int attrs, short pair, short palette[5][3]) {
+	const char *bold = (attrs & CB_BOLD) ? ";1" : "";
+	if (pair >= 1 && pair <= 7)
+		return snprintf(buf, size, "\033[0%s;%dm", bold, 30 + pair);
+	if (pair >= 8 && pair <= 15)
+		return snprintf(buf, size, "\033[0%s;%dm", bold, 90 + pair - 8);
+	if (pair >= 20 && pair <= 24) {
+		const short *rgb = palette[pair - 20];
+		return snprintf(buf, size, "\033[0%s;38;2;%d;%d;%dm", bold,
+						rgb[0] * 255 / 1000, rgb[1] * 255 / 1000, rgb[2] * 255 / 1000);
+	}
+	return snprintf(buf, size, "\033[0%sm", bold);
+}
 
-// ==========================================================================
-// V2 ENGINE  (msaw streams: pads, lean, widening, deadwood)
-// ==========================================================================
+// Render a tree into out as text: layers composited as blitTree does,
+// clipped to its maxX x maxY area, from the tree's top row down to the
+// base, trailing blanks trimmed. Unless plain, an SGR escape is written
+// only where bold/colour change, and each line ends reset.
+void renderText(const struct treeView *view, short palette[5][3], int plain, struct textBuf *out) {
+	struct textCanvas cv = {.w = view->maxX, .h = view->maxY};
+	cv.cells = calloc((size_t)cv.w * (size_t)cv.h, sizeof(struct textCell));
+	if (view->trunkPlane)
+		widenedTrunkCells(view->trunkPlane, emitToText, &cv);
+	textBlitGrid(&cv, view->skeleton);
+	textBlitGrid(&cv, view->canopy->grid);
+
+	int top = 0;
+	while (top < cv.h) {
+		int x = 0;
+		while (x < cv.w && !cv.cells[top * cv.w + x].ch[0]) x++;
+		if (x < cv.w) break;
+		top++;
+	}
+	for (int y = top; y < cv.h; y++) {
+		const struct textCell *row = &cv.cells[y * cv.w];
+		int end = cv.w;
+		while (end > 0 && !row[end - 1].ch[0] && row[end - 1].wide != -1) end--;
+
+		unsigned int curAttrs = 0;
+		short curPair = 0;
+		for (int x = 0; x < end; x++) {
+			const struct textCell *tc = &row[x];
+			if (tc->wide == -1) continue;	// right half of the char before
+			if (!tc->ch[0]) {
+				textAppend(out, " ", 1);
+				continue;
+			}
+			if (!plain && (tc->attrs != curAttrs || tc->pair != curPair)) {
+				char sgr[48];
+				int n = textSgr(sgr, sizeof(sgr), tc->attrs, tc->pair, palette);
+				textAppend(out, sgr, (size_t)n);
+				curAttrs = tc->attrs;
+				curPair = tc->pair;
+			}
+			textAppend(out, tc->ch, strlen(tc->ch));
+		}
+		if (curAttrs || curPair) textAppend(out, "\033[0m", 4);
+		textAppend(out, "\n", 1);
+	}
+	free(cv.cells);
+}
 
-struct ColorResult chooseColorResult_v2(enum branchType type, struct msaw *cosmetic) {
-	struct ColorResult cr = {0, 0};
-	int r;
-	switch(type) {
-	case trunk:
-		r = mrand(cosmetic, 4);
-		if (r < 2) { cr.attrs = A_BOLD; cr.color_pair = 20; }
-		else if (r == 2) { cr.color_pair = 20; }
-		else { cr.color_pair = 21; }
-		break;
+// The text frontend: no screen, so growth is never shown live; the
+// finished tree is rendered into tf->out.
+static void textBegin(void *ctx, struct config *conf, int *maxY, int *maxX) {
+	(void)ctx;
+	*maxY = conf->rows;
+	*maxX = conf->cols;
+}
 
-	case shootLeft:
-	case shootRight:
-		r = mrand(cosmetic, 10);
-		if (r < 2) { cr.attrs = A_BOLD; cr.color_pair = 20; }
-		else if (r < 6) { cr.attrs = A_BOLD; cr.color_pair = 21; }
-		else { cr.color_pair = 21; }
-		break;
+static int textStep(void *ctx, const struct treeView *view) {
+	(void)ctx;
+	(void)view;
+	return 0;
+}
 
-	case dying:
-		r = mrand(cosmetic, 6);
-		if (r < 3) { cr.color_pair = 22; }
-		else if (r < 5) { cr.attrs = A_BOLD; cr.color_pair = 22; }
-		else { cr.color_pair = 23; }
-		break;
+static void textFinish(void *ctx, const struct treeView *view) {
+	struct textFrontend *tf = ctx;
+	renderText(view, tf->palette, tf->plain, &tf->out);
+}
 
-	case dead:
-		r = mrand(cosmetic, 18);
-		if (r < 2) { cr.attrs = A_BOLD; cr.color_pair = 23; }
-		else if (r < 8) { cr.attrs = A_BOLD; cr.color_pair = 22; }
-		else { cr.color_pair = 22; }
-		break;
+// most jobs one --batch may queue (a range or a seed file)
+#define BATCH_SEEDS_MAX 1000000L
+
+// --batch seeds: "FIRST-LAST" (inclusive), a single seed, or a file of
+// seeds one per line (blank lines and # comments skipped). Returns the
+// count, or -1 with an error printed.
+int parseSeeds(const char *spec, int **seeds) {
+	// a range is digits, optionally '-' and digits; anything else names a file
+	if (isdigit((unsigned char)spec[0])) {
+		char *endp;
+		errno = 0;
+		long first = strtol(spec, &endp, 10), last = first;
+		int ok = errno == 0;
+		if (*endp == '-' && isdigit((unsigned char)endp[1])) {
+			const char *p = endp + 1;
+			last = strtol(p, &endp, 10);
+			ok = ok && errno == 0;
+		}
+		if (*endp == '\0') {
+			if (!ok || first > 2147483647L || last > 2147483647L || last < first) {
+				printf("error: invalid seed range: '%s'\n", spec);
+				return -1;
+			}
+			if (last - first + 1 > BATCH_SEEDS_MAX) {
+				printf("error: seed range too large: '%s' (at most %ld seeds)\n", spec, BATCH_SEEDS_MAX);
+				return -1;
+			}
+			int count = (int)(last - first + 1);
+			*seeds = malloc(sizeof(int) * (size_t)count);
+			for (int i = 0; i < count; i++)
+				(*seeds)[i] = (int)first + i;
+			return count;
+		}
 	}
-	return cr;
-}
-
-// v2: nudge a freshly-rolled dx toward the branch's committed lean. Higher
-// |lean| -> more consistent pull; dx is held within [lo, hi] so the lean bends
-// the wander rather than overriding it. Draws one value from the growth stream.
-static int applyLean(struct msaw *growth, int dx, int lean, int lo, int hi) {
-	if (lean == 0) return dx;
-	int s = (lean > 0) ? 1 : -1;
-	int strength = (lean > 0) ? lean : -lean;
-	if (strength > LEAN_MAX) strength = LEAN_MAX;
-	if (mrand(growth, LEAN_DENOM) < strength) {
-		dx += s;
-		if (dx < lo) dx = lo;
-		if (dx > hi) dx = hi;
-	}
-	return dx;
-}
-
-// v2: ported from setDeltas onto an explicit msaw growth stream, plus a lean
-// pull on the trunk and shoot wander (see applyLean). dying/dead drift is left
-// symmetric here — foliage shaping is handled by the canopy-pad walker bias.
-void setDeltas_v2(enum branchType type, int life, int totalLife, int age,
-				  int multiplier, int *returnDx, int *returnDy,
-				  int lean, struct msaw *growth) {
-	int dx = 0;
-	int dy = 0;
-	int dice;
-	switch (type) {
-	case trunk: // trunk
-
-		// new or dead trunk
-		if (age <= 2 || life < 4) {
-			dy = 0;
-			dx = mrand(growth, 3) - 1;
+
+	FILE *fp = fopen(spec, "r");
+	if (!fp) {
+		printf("error: not a seed range and could not open seed file: %s\n", spec);
+		return -1;
+	}
+	int count = 0, cap = 256, lineNo = 0;
+	*seeds = malloc(sizeof(int) * (size_t)cap);
+	char line[128];
+	while (fgets(line, sizeof(line), fp)) {
+		lineNo++;
+		char *p = line;
+		while (isspace((unsigned char)*p)) p++;
+		if (*p == '\0' || *p == '#') continue;
+		char *endp;
+		errno = 0;
+		long s = strtol(p, &endp, 10);
+		while (isspace((unsigned char)*endp)) endp++;
+		if (errno || endp == p || *endp != '\0' || s < 0 || s > 2147483647L) {
+			printf("error: %s:%d: invalid seed\n", spec, lineNo);
+			fclose(fp);
+			free(*seeds);
+			return -1;
 		}
-		// young trunk should grow wide]
-		else if (isYoungTrunk(age, totalLife)) {
-			// every (multiplier * 0.4) steps, raise tree to next level
-			int step = (int)(multiplier * 0.6);
-			if (step < 1) step = 1;
-			if (age % step == 0) dy = -1;
-			else dy = 0;
-
-			dice = mrand(growth, 10);
-			if (dice >= 0 && dice <=0) dx = -2;			// 10%
-			else if (dice >= 1 && dice <= 3) dx = -1;	// 30%
-			else if (dice >= 4 && dice <= 5) dx = 0;	// 20%
-			else if (dice >= 6 && dice <= 8) dx = 1;	// 30%
-			else if (dice >= 9 && dice <= 9) dx = 2;	// 10%
+		if (count == BATCH_SEEDS_MAX) {
+			printf("error: %s: more than %ld seeds\n", spec, BATCH_SEEDS_MAX);
+			fclose(fp);
+			free(*seeds);
+			return -1;
 		}
-		else if (isEarlyTrunk(age, totalLife)) {
-			// every (multiplier * 0.3) steps, raise tree to next level
-			int step = (int)(multiplier * 0.3);
-			if (step < 1) step = 1;
-			if (age % step == 0) dy = -1;
-			else dy = 0;
-
-			dice = mrand(growth, 10);
-			if (dice >= 0 && dice <=0) dx = -2;			// 10%
-			else if (dice >= 1 && dice <= 3) dx = -1;	// 30%
-			else if (dice >= 4 && dice <= 5) dx = 0;	// 20%
-			else if (dice >= 6 && dice <= 8) dx = 1;	// 30%
-			else if (dice >= 9 && dice <= 9) dx = 2;	// 10%
+		if (count == cap) {
+			cap *= 2;
+			*seeds = realloc(*seeds, sizeof(int) * (size_t)cap);
 		}
-		// old-aged trunk
-		else {
-			dice = mrand(growth, 10);
-			if (dice > 3) dy = -1;
-			else dy = 0;
-
-			dice = mrand(growth, 20);
-			if (dice >= 0 && dice <=0) dx = -2;			// 10%
-			else if (dice >= 1 && dice <= 7) dx = -1;	// 30%
-			else if (dice >= 8 && dice <= 12) dx = 0;	// 20%
-			else if (dice >= 13 && dice <= 18) dx = 1;	// 30%
-			else if (dice >= 19 && dice <= 19) dx = 2;	// 10%
+		(*seeds)[count++] = (int)s;
+	}
+	fclose(fp);
+	return count;
+}
+
+static void *batchWorker(void *arg) {
+	struct batch *b = arg;
+	for (;;) {
+		pthread_mutex_lock(&b->lock);
+		while (!b->outPattern && b->next < b->count && b->next >= b->written + b->window)
+			pthread_cond_wait(&b->room, &b->lock);
+		if (b->next >= b->count) {
+			pthread_mutex_unlock(&b->lock);
+			return NULL;
+		}
+		int i = b->next++;
+		pthread_mutex_unlock(&b->lock);
+
+		struct config run = *b->conf;
+		run.seed = b->seeds[i];
+		struct counters myCounters = {0};
+		struct textFrontend tf = {.plain = b->plain};
+		memcpy(tf.palette, b->palette, sizeof(tf.palette));
+		const struct frontend text = {
+			.ctx = &tf,
+			.begin = textBegin,
+			.step = textStep,
+			.finish = textFinish
+		};
+		growTree(&run, &text, &myCounters);
+
+		if (b->outPattern) {
+			char path[4096];
+			snprintf(path, sizeof(path), b->outPattern, run.seed);
+			FILE *fp = fopen(path, "w");
+			int ok = fp && fwrite(tf.out.data, 1, tf.out.len, fp) == tf.out.len;
+			if (fp && fclose(fp) != 0) ok = 0;
+			free(tf.out.data);
+			if (!ok) {
+				pthread_mutex_lock(&b->lock);
+				printf("error: could not write %s\n", path);
+				b->failures++;
+				pthread_mutex_unlock(&b->lock);
+			}
+			continue;
 		}
-		break;
 
-	case 1: // left shoot: trend left and little vertical movement
-		dice = mrand(growth, 10);
-		if (dice >= 0 && dice <= 2) dy = -1;
-		else if (dice >= 3 && dice <= 7) dy = 0;
-		else if (dice >= 8 && dice <= 9) dy = 1;
-
-		dice = mrand(growth, 10);
-		if (dice >= 0 && dice <=1) dx = -2;
-		else if (dice >= 2 && dice <= 5) dx = -1;
-		else if (dice >= 6 && dice <= 8) dx = 0;
-		else if (dice >= 9 && dice <= 9) dx = 1;
-		break;
+		pthread_mutex_lock(&b->lock);
+		b->done[i] = tf.out;
+		b->isDone[i] = 1;
+		pthread_cond_signal(&b->ready);
+		pthread_mutex_unlock(&b->lock);
+	}
+}
 
-	case 2: // right shoot: trend right and little vertical movement
-		dice = mrand(growth, 10);
-		if (dice >= 0 && dice <= 2) dy = -1;
-		else if (dice >= 3 && dice <= 7) dy = 0;
-		else if (dice >= 8 && dice <= 9) dy = 1;
-
-		dice = mrand(growth, 10);
-		if (dice >= 0 && dice <=1) dx = 2;
-		else if (dice >= 2 && dice <= 5) dx = 1;
-		else if (dice >= 6 && dice <= 8) dx = 0;
-		else if (dice >= 9 && dice <= 9) dx = -1;
-		break;
+// --batch: grow one tree per seed with conf's other options on jobs
+// threads, and write each as ANSI (or plain) text to outPattern with the
+// seed substituted for %d, or to stdout concatenated in seed order. The
+// output never depends on thread timing.
+int runBatch(const struct config *conf, const char *seedSpec, const char *outPattern, int jobs, int plain) {
+	if (outPattern) {
+		const char *pct = strchr(outPattern, '%');
+		if (!pct || strncmp(pct, "%d", 2) != 0 || strchr(pct + 1, '%')) {
+			printf("error: --batch-out needs exactly one %%d for the seed: '%s'\n", outPattern);
+			return 1;
+		}
+	}
 
-	case 3: // dying: discourage vertical growth(?); trend left/right (-3,3)
-		dice = mrand(growth, 10);
-		if (dice >= 0 && dice <=0) dy = -1;
-		else if (dice >= 1 && dice <=8) dy = 0;
-		else if (dice >= 9 && dice <=9) dy = 1;
-
-		dice = mrand(growth, 15);
-		if (dice >= 0 && dice <=0) dx = -3;
-		else if (dice >= 1 && dice <= 2) dx = -2;
-		else if (dice >= 3 && dice <= 5) dx = -1;
-		else if (dice >= 6 && dice <= 8) dx = 0;
-		else if (dice >= 9 && dice <= 11) dx = 1;
-		else if (dice >= 12 && dice <= 13) dx = 2;
-		else if (dice >= 14 && dice <= 14) dx = 3;
-		break;
+	struct batch b = {
+		.conf = conf,
+		.outPattern = outPattern,
+		.plain = plain,
+	};
+	b.count = parseSeeds(seedSpec, &b.seeds);
+	if (b.count < 0) return 1;
+	if (jobs > b.count) jobs = b.count > 0 ? b.count : 1;
+	b.window = 4 * jobs;
+	seasonPalette(b.palette);
+	if (!outPattern) {
+		b.done = calloc((size_t)b.count + 1, sizeof(struct textBuf));
+		b.isDone = calloc((size_t)b.count + 1, 1);
+	}
+	pthread_mutex_init(&b.lock, NULL);
+	pthread_cond_init(&b.ready, NULL);
+	pthread_cond_init(&b.room, NULL);
+
+	pthread_t *workers = malloc(sizeof(pthread_t) * (size_t)jobs);
+	int started = 0;
+	for (; started < jobs; started++) {
+		if (pthread_create(&workers[started], NULL, batchWorker, &b) != 0) break;
+	}
+	if (started == 0) {
+		printf("error: could not start batch threads\n");
+		b.failures++;
+	} else if (!outPattern) {
+		for (int i = 0; i < b.count; i++) {
+			pthread_mutex_lock(&b.lock);
+			while (!b.isDone[i])
+				pthread_cond_wait(&b.ready, &b.lock);
+			pthread_mutex_unlock(&b.lock);
+
+			fwrite(b.done[i].data, 1, b.done[i].len, stdout);
+			free(b.done[i].data);
+
+			pthread_mutex_lock(&b.lock);
+			b.written = i + 1;
+			pthread_cond_broadcast(&b.room);
+			pthread_mutex_unlock(&b.lock);
+		}
+		fflush(stdout);
+	}
+	for (int i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+
+	free(workers);
+	free(b.done);
+	free(b.isDone);
+	free(b.seeds);
+	pthread_cond_destroy(&b.room);
+	pthread_cond_destroy(&b.ready);
+	pthread_mutex_destroy(&b.lock);
+	return b.failures ? 1 : 0;
+}
 
-	case 4: // dead: fill in surrounding area
-		dice = mrand(growth, 12);
-		if (dice >= 0 && dice <= 1) dy = -1;
-		else if (dice >= 2 && dice <= 8) dy = 0;
-		else if (dice >= 9 && dice <= 11) dy = 1;
-
-		dice = mrand(growth, 15);
-		if (dice >= 0 && dice <=1) dx = -3;
-		else if (dice >= 2 && dice <= 3) dx = -2;
-		else if (dice >= 4 && dice <= 5) dx = -1;
-		else if (dice >= 6 && dice <= 8) dx = 0;
-		else if (dice >= 9 && dice <= 10) dx = 1;
-		else if (dice >= 11 && dice <= 12) dx = 2;
-		else if (dice >= 13 && dice <= 14) dx = 3;
-		break;
+// The terminal's size, as curses would find it: the tty's window size,
+// else $COLUMNS / $LINES, else 80x24.
+void termSize(int *cols, int *rows) {
+	struct winsize ws;
+	*cols = 0;
+	*rows = 0;
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) {
+		*cols = ws.ws_col;
+		*rows = ws.ws_row;
+	}
+	const char *env;
+	if (*cols < 1 && (env = getenv("COLUMNS"))) *cols = atoi(env);
+	if (*rows < 1 && (env = getenv("LINES"))) *rows = atoi(env);
+	if (*cols < 1) *cols = 80;
+	if (*rows < 1) *rows = 24;
+}
+
+int writeAll(int fd, const char *data, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return 1;
+		}
+		data += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+// -p without -l: grow the tree on the terminal's area with the text
+// frontend and write it out in one go. Curses is never started, so there
+// is no terminal setup, screen to read back or teardown. With useCache the
+// render is looked up in (and stored to) the render cache first.
+int printTreeText(struct config *conf, struct counters *myCounters, int useCache) {
+	termSize(&conf->cols, &conf->rows);
+
+	struct textFrontend tf = {.plain = 0};
+	seasonPalette(tf.palette);
+
+	struct textBuf key = {0};
+	char *dir = NULL, *path = NULL;
+	if (useCache && (dir = renderCacheDir())) {
+		renderCacheKey(conf, tf.palette, &key);
+		path = renderCachePath(dir, &key);
+	}
+	if (!path || renderCacheLoad(path, &key, &tf.out)) {
+		const struct frontend text = {
+			.ctx = &tf,
+			.begin = textBegin,
+			.step = textStep,
+			.finish = textFinish
+		};
+		growTree(conf, &text, myCounters);
+		if (path) renderCacheStore(dir, path, &key, &tf.out);
 	}
+	free(key.data);
+	free(path);
+	free(dir);
 
-	// commit the woody wander toward the branch's lean (foliage is shaped by
-	// the canopy-pad bias instead, so dying/dead are left alone)
-	if (type == trunk || type == shootLeft || type == shootRight)
-		dx = applyLean(growth, dx, lean, -2, 2);
+	if (conf->message) {
+		textAppend(&tf.out, conf->message, strlen(conf->message));
+		textAppend(&tf.out, "\n", 1);
+	}
 
-	*returnDx = dx;
-	*returnDy = dy;
+	int ret = writeAll(STDOUT_FILENO, tf.out.data, tf.out.len);
+	free(tf.out.data);
+	if (conf->save)
+		saveToFile(conf, myCounters->globalTime);
+	return ret;
 }
 
-// v2: faithful port of chooseString; leaf glyph choice draws from the
-// cosmetic stream so it can be retuned without invalidating saved trees
-char* chooseString_v2(const struct config *conf, enum branchType type, int life,
-					  int dx, int dy, struct msaw *cosmetic) {
-	char* branchStr;
 
-	const unsigned int maxStrLen = 32;
+// ==========================================================================
+// RENDER CACHE  (-p: finished renders on disk, keyed by what grew them)
+// ==========================================================================
 
-	branchStr = malloc(maxStrLen);
-	strcpy(branchStr, "?");	// fallback character
+#define RENDER_CACHE_VERSION 1
+#define RENDER_CACHE_BYTES (4L * 1024 * 1024)	// evict least recently used beyond this
+
+// running total of the entries' bytes, so a store below the budget need
+// not scan the directory
+#define RENDER_CACHE_LEDGER ".size"
+
+// Every input the rendered bytes depend on, as one header line: the
+// generation options, the screen size, the seasonal palette, and whether
+// the locale can size wide characters. Stored at the top of each entry
+// and compared on load, so a hash collision is only ever a miss.
+static void renderCacheKey(const struct config *conf, short palette[5][3], struct textBuf *key) {
+	char field[160];
+	int n = snprintf(field, sizeof(field), "cbonsai-render %d v%d s%d L%d M%d b%d P%d bare%d %dx%d u%d pal",
+					 RENDER_CACHE_VERSION, conf->version, conf->seed, conf->lifeStart, conf->multiplier,
+					 conf->baseType, conf->proceduralMode, conf->hideLeaves, conf->cols, conf->rows,
+					 MB_CUR_MAX > 1);
+	textAppend(key, field, (size_t)n);
+	for (int i = 0; i < 5; i++) {
+		n = snprintf(field, sizeof(field), "%c%d,%d,%d", i ? ':' : ' ', palette[i][0], palette[i][1], palette[i][2]);
+		textAppend(key, field, (size_t)n);
+	}
+	textAppend(key, " c", 2);
+	for (int i = 0; i < conf->leavesSize; i++) {
+		// length-prefixed: leaf strings may contain anything but newlines
+		n = snprintf(field, sizeof(field), " %zu:", strlen(conf->leaves[i]));
+		textAppend(key, field, (size_t)n);
+		for (const char *p = conf->leaves[i]; *p; p++)
+			textAppend(key, *p == '\n' ? " " : p, 1);
+	}
+	textAppend(key, "\n", 1);
+}
 
-	if (life < 4) type = dying;
+// The cache directory, next to the default save file (see
+// createDefaultCachePath), created if missing. NULL: no $XDG_CACHE_HOME or
+// $HOME to put it in, or it could not be created.
+char *renderCacheDir(void) {
+	const char *xdg = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	char parent[4096];
+	if (xdg && *xdg) snprintf(parent, sizeof(parent), "%s", xdg);
+	else if (home && *home) snprintf(parent, sizeof(parent), "%s/.cache", home);
+	else return NULL;
+
+	char *dir = malloc(strlen(parent) + sizeof("/cbonsai-renders"));
+	sprintf(dir, "%s/cbonsai-renders", parent);
+	mkdir(parent, 0700);
+	if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+		free(dir);
+		return NULL;
+	}
+	return dir;
+}
 
-	switch(type) {
-	case trunk:
-		if (dy == 0) strcpy(branchStr, "/~");
-		else if (dx < 0) strcpy(branchStr, "\\|");
-		else if (dx == 0) strcpy(branchStr, "/|\\");
-		else if (dx > 0) strcpy(branchStr, "|/");
-		break;
-	case shootLeft:
-		if (dy > 0) strcpy(branchStr, "\\");
-		else if (dy == 0) strcpy(branchStr, "\\_");
-		else if (dx < 0) strcpy(branchStr, "\\|");
-		else if (dx == 0) strcpy(branchStr, "/|");
-		else if (dx > 0) strcpy(branchStr, "/");
-		break;
-	case shootRight:
-		if (dy > 0) strcpy(branchStr, "/");
-		else if (dy == 0) strcpy(branchStr, "_/");
-		else if (dx < 0) strcpy(branchStr, "\\|");
-		else if (dx == 0) strcpy(branchStr, "/|");
-		else if (dx > 0) strcpy(branchStr, "/");
-		break;
-	case dying:
-	case dead:
-		strncpy(branchStr, conf->leaves[mrand(cosmetic, conf->leavesSize)], maxStrLen - 1);
-		branchStr[maxStrLen - 1] = '\0';
-	}
+// dir/<FNV-1a of the key>.ansi
+char *renderCachePath(const char *dir, const struct textBuf *key) {
+	char *path = malloc(strlen(dir) + 24);
+	sprintf(path, "%s/%016llx.ansi", dir, renderKeyHash(key));
+	return path;
+}
 
-	return branchStr;
+// FNV-1a of a renderCacheKey line, as grid_hash
+unsigned long long renderKeyHash(const struct textBuf *key) {
+	unsigned long long h = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < key->len; i++)
+		h = (h ^ (unsigned char)key->data[i]) * 0x100000001b3ULL;
+	return h;
 }
 
-// v2: is a live structural branch head (trunk/shoot, excluding `exceptIdx`)
-// within `minDist` Manhattan of (x, y)? Used to throttle splits and shoots in
-// crowded regions. Pure spatial test (no RNG of its own), though gating a
-// spawn does skip that spawn's draws, so changing the distances reshapes the
-// tree. Deterministic for a given build + seed.
-static int structuralCrowded(const struct BranchList *list, int x, int y,
-							 int exceptIdx, int minDist) {
-	for (int i = 0; i < list->count; i++) {
-		if (i == exceptIdx) continue;
-		const struct Branch *b = &list->branches[i];
-		if (b->type != trunk && b->type != shootLeft && b->type != shootRight)
-			continue;
-		if (abs(b->x - x) + abs(b->y - y) < minDist)
-			return 1;
+// Read a cached render into out. Returns 0 on a hit; a hit is marked
+// recently used by bumping its mtime.
+int renderCacheLoad(const char *path, const struct textBuf *key, struct textBuf *out) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return 1;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < key->len) {
+		close(fd);
+		return 1;
+	}
+	size_t size = (size_t)st.st_size;
+	char *data = malloc(size ? size : 1);
+	size_t got = 0;
+	while (got < size) {
+		ssize_t n = read(fd, data + got, size - got);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		got += (size_t)n;
+	}
+	close(fd);
+	if (got != size || memcmp(data, key->data, key->len) != 0) {
+		free(data);
+		return 1;
 	}
+	textAppend(out, data + key->len, size - key->len);
+	free(data);
+	utimes(path, NULL);
 	return 0;
 }
 
-// v2: ported from updateBranch_v1 onto explicit msaw streams.
-// Growth decisions draw from `growth`, colors/glyphs from `cosmetic`,
-// and each spawned branch gets its own leaf stream via msaw_split.
-// Diverges from v1 in the terminal phase: dead branches no longer re-trigger
-// the near-dead spawn rule (v1 cascaded exponentially there), dying branches
-// and dying shoots emit children at half rate, and shoots get a life floor so
-// ones spawned near the top act like branches instead of leaf fountains.
-// Splits and shoots are additionally suppressed where heads are crowded
-// (structuralCrowded), which keeps high multiplier from tangling.
-void updateBranch_v2(struct config *conf, struct VirtualGrid *skeleton,
-				struct counters *myCounters, int branchIdx,
-				struct BranchList* list,
-				struct msaw *growth, struct msaw *cosmetic, struct msaw *deadRng) {
-
-	struct Branch *branch = &list->branches[branchIdx];
-	// non-trunk branches age one life per tick; a trunk instead pays life per
-	// row it climbs (charged after setDeltas) so its height tracks L, not M
-	if (branch->type != trunk)
-		branch->life--;
-
-	// Random die-off check - more likely on shoots
-	if (branch->type == trunk) {
-		if (mrand(growth, 66) == 0) {   // 2% chance for trunk
-			branch->life -= (branch->life/2);  // Lose 1/4 of life
-		}
-	} else if (branch->type == shootLeft || branch->type == shootRight) {
-		if (mrand(growth, 20) == 0) {    // 5% chance for shoots
-			branch->life /= 2;      // Lose half of life
-		}
+// Store a render atomically: written to a temporary file in the same
+// directory and renamed over path, so a concurrent reader sees either the
+// old entry, the new one, or none. Any failure just leaves it uncached.
+void renderCacheStore(const char *dir, const char *path, const struct textBuf *key, const struct textBuf *render) {
+	char *tmp = malloc(strlen(dir) + sizeof("/.tmp-XXXXXX"));
+	sprintf(tmp, "%s/.tmp-XXXXXX", dir);
+	int fd = mkstemp(tmp);
+	if (fd < 0) {
+		free(tmp);
+		return;
+	}
+	int failed = writeAll(fd, key->data, key->len) || writeAll(fd, render->data, render->len);
+	if (close(fd) != 0) failed = 1;
+	struct stat old;
+	long long replaced = stat(path, &old) == 0 ? (long long)old.st_size : 0;
+	if (failed || rename(tmp, path) != 0) {
+		unlink(tmp);
+		free(tmp);
+		return;
 	}
+	free(tmp);
+	renderCacheAccount(dir, (long long)(key->len + render->len) - replaced);
+}
 
-	branch->age++;
-
-	// jin/shari: a fork destined for deadwood grows alive and leafy, then dies
-	// back — once its life falls to diebackLife it becomes bare bleached wood
-	// for the rest of its (now short) life. Life-based so it triggers reliably
-	// as the trunk spends its height budget.
-	if (branch->diebackLife > 0 && !branch->deadwood && branch->life <= branch->diebackLife)
-		branch->deadwood = 1;
-
-	setDeltas_v2(branch->type, branch->life, branch->totalLife,
-			  branch->age, branch->multiplier, &branch->dx, &branch->dy,
-			  branch->lean, growth);
-
-	int groundY = skeleton->anchor_y + skeleton->height - getBaseHeight(conf->baseType);
-	if (branch->dy > 0 && branch->y > (groundY - 6))
-		branch->dy--;
-
-	// trunk life is a height budget: pay per climbed row so total height is
-	// ~ L / TRUNK_RISE_COST whether it rises often (low M) or rarely (high M).
-	// A stalled low-life tip still drains 1/tick so it can't hang forever.
-	if (branch->type == trunk) {
-		if (branch->dy < 0) branch->life -= TRUNK_RISE_COST;
-		else if (branch->life < 4) branch->life--;
-	}
-
-	// near-dead branch should branch into a lot of leaves; dead branches
-	// don't re-trigger this (would cascade exponentially), dying ones only
-	// emit at half rate so clusters don't snowball, and deadwood stays bare
-	if (branch->life < 6 && branch->type != dead && !branch->deadwood) {
-		if (branch->type != dying || mrand(growth, 2) == 0) {
-			struct Branch newBranch = {
-				.x = branch->x,
-				.y = branch->y,
-				.type = dead,
-				.life = branch->life,
-				.age = 0,
-				.totalLife = branch->life,
-				.multiplier = branch->multiplier,
-				.shootCooldown = conf->multiplier,
-				.dripLeafCooldown = branch->life / 4,
-				.history_count = 0,
-				.history_index = 0,
-				.x_history[0] = branch->x,
-				.y_history[0] = branch->y
-			};
-			msaw_split(growth, &newBranch.leaf_rng);
-			addBranch(list, newBranch, myCounters);
-			branch = &list->branches[branchIdx];
-		}
+// Add delta to the ledger's total, and only if that crosses
+// RENDER_CACHE_BYTES (or there is no usable total yet) scan and evict,
+// resetting the total to what the scan found. The ledger is locked
+// throughout, so concurrent stores neither lose an update nor evict at
+// once; entries deleted behind its back only make it overestimate, which
+// costs an early scan.
+static void renderCacheAccount(const char *dir, long long delta) {
+	char path[4096];
+	snprintf(path, sizeof(path), "%s/" RENDER_CACHE_LEDGER, dir);
+	int fd = open(path, O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		renderCacheEvict(dir);
+		return;
 	}
-	else if (branch->type == shootLeft || branch->type == shootRight) {
-		// dying shoot emits at half rate (v1 spawned every tick)
-		if (branch->life < 7 + (branch->multiplier /5)) {
-			if (mrand(growth, 2) == 0) {
-				struct Branch newBranch = {
-					.x = branch->x,
-					.y = branch->y,
-					.type = dying,
-					.life = branch->life + 1,
-					.age = 0,
-					.totalLife = branch->life + 1,
-					.multiplier = branch->multiplier,
-					.shootCooldown = conf->multiplier,
-					.dripLeafCooldown = (branch->life + 1) / 4,
-					.history_count = 0,
-					.history_index = 0,
-					.x_history[0] = branch->x,
-					.y_history[0] = branch->y
-				};
-				msaw_split(growth, &newBranch.leaf_rng);
-				addBranch(list, newBranch, myCounters);
-				branch = &list->branches[branchIdx];
-			}
+	struct flock lock = {.l_type = F_WRLCK, .l_whence = SEEK_SET};
+	while (fcntl(fd, F_SETLKW, &lock) == -1 && errno == EINTR)
+		;
+	char buf[32];
+	ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+	long long total = -1;
+	if (n > 0) {
+		buf[n] = '\0';
+		char *endp;
+		total = strtoll(buf, &endp, 10);
+		if (endp == buf || *endp != '\n' || total < 0) total = -1;
+	}
+	if (total < 0 || total + delta > RENDER_CACHE_BYTES)
+		total = renderCacheEvict(dir);
+	else
+		total += delta;
+	int len = snprintf(buf, sizeof(buf), "%lld\n", total);
+	if (pwrite(fd, buf, (size_t)len, 0) != len || ftruncate(fd, len) != 0)
+		unlink(path);	// next store rebuilds it with a scan
+	close(fd);	// drops the lock
+}
+
+static int renderCacheOlder(const void *a, const void *b) {
+	const struct renderCacheEntry *ea = a, *eb = b;
+	return (ea->mtime > eb->mtime) - (ea->mtime < eb->mtime);
+}
+
+// Delete least recently used entries until the cache fits in
+// RENDER_CACHE_BYTES, along with temporaries left by a writer that died.
+// Returns the bytes left. Racing evictions at worst delete an entry
+// twice, which is harmless.
+long long renderCacheEvict(const char *dir) {
+	DIR *d = opendir(dir);
+	if (!d) return 0;
+	int count = 0, cap = 64;
+	struct renderCacheEntry *entries = malloc(sizeof(*entries) * (size_t)cap);
+	long long total = 0;
+	time_t now = time(NULL);
+	char path[4096];
+	struct dirent *de;
+	while ((de = readdir(d))) {
+		size_t len = strlen(de->d_name);
+		int isTmp = strncmp(de->d_name, ".tmp-", 5) == 0;
+		int isEntry = len > 5 && strcmp(de->d_name + len - 5, ".ansi") == 0;
+		if ((!isTmp && !isEntry) || len >= sizeof(entries->name)) continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		struct stat st;
+		if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+		if (isTmp) {
+			if (now - st.st_mtime > 60) unlink(path);
+			continue;
 		}
-		else if (branch->dripLeafCooldown <= 0 && mrand(growth, 3) == 0) {
-			struct Branch newBranch = {
-				.x = branch->x,
-				.y = branch->y,
-				.type = dying,
-				.life = 5,
-				.age = 0,
-				.totalLife = 5,
-				.multiplier = branch->multiplier,
-				.shootCooldown = conf->multiplier,
-				.dripLeafCooldown = (branch->multiplier*2)/3,
-				.history_count = 0,
-				.history_index = 0,
-				.x_history[0] = branch->x,
-				.y_history[0] = branch->y
-			};
-			msaw_split(growth, &newBranch.leaf_rng);
-			addBranch(list, newBranch, myCounters);
-			branch = &list->branches[branchIdx];
-			// higher multiplier -> shorter gap between drip leaves (v1 had a
-			// sign slip here, 25 + M, which made the drip fire ~once)
-			branch->dripLeafCooldown = 7 + (25 - branch->multiplier);
+		if (count == cap) {
+			cap *= 2;
+			entries = realloc(entries, sizeof(*entries) * (size_t)cap);
+		}
+		strcpy(entries[count].name, de->d_name);
+		entries[count].mtime = st.st_mtime;
+		entries[count].size = st.st_size;
+		total += st.st_size;
+		count++;
+	}
+	closedir(d);
+
+	if (total > RENDER_CACHE_BYTES) {
+		qsort(entries, (size_t)count, sizeof(*entries), renderCacheOlder);
+		for (int i = 0; i < count && total > RENDER_CACHE_BYTES; i++) {
+			snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name);
+			unlink(path);
+			total -= entries[i].size;
 		}
 	}
-	// dying trunk should branch into a lot of leaves (deadwood dies bare)
-	else if (branch->type == trunk && branch->life < (branch->multiplier + 2) && !branch->deadwood) {
-		struct Branch newBranch = {
-			.x = branch->x,
-			.y = branch->y,
-			.type = dying,
-			.life = branch->life,
-			.age = 0,
-			.totalLife = branch->life,
-			.multiplier = branch->multiplier,
-			.shootCooldown = conf->multiplier,
-			.dripLeafCooldown = branch->life / 4,
-			.history_count = 0,
-			.history_index = 0,
-			.x_history[0] = branch->x,
-			.y_history[0] = branch->y
-		};
-		msaw_split(growth, &newBranch.leaf_rng);
-		addBranch(list, newBranch, myCounters);
-		branch = &list->branches[branchIdx];
-	}
-	else if (branch->type == trunk) {
-		// (trunk life is now charged per climbed row above, not per tick)
-		// First check for trunk splits - only in early phase and with enough life
-		if (!isYoungTrunk(branch->age, branch->totalLife)) {
-			int splitThreshold = (24 - branch->multiplier) + (2 * myCounters->trunks);
-			double ageRatio = (double)branch->age / branch->totalLife;
-
-			if (ageRatio < 0.1) {      // Bottom 10%
-				splitThreshold = (splitThreshold * 2)/7;
-			} else if (ageRatio < 0.4) {
-				splitThreshold = (splitThreshold * 3)/7;
-			} else {
-				splitThreshold = (splitThreshold * 5)/7;
-			}
+	free(entries);
+	return total;
+}
 
-			// never a guaranteed split: at high multiplier the threshold can
-			// otherwise reach 1 (mrand(.,1)==0 always), turning every cooldown
-			// into a split and exploding the trunk count
-			if (splitThreshold < 2) splitThreshold = 2;
-
-			if (myCounters->trunkSplitCooldown < 0 && !branch->deadwood && mrand(growth, splitThreshold) == 0
-				&& !structuralCrowded(list, branch->x, branch->y, branchIdx, SPLIT_MIN_DIST)) {
-				myCounters->trunkSplitCooldown = 2 + ((22 - conf->multiplier)*3)/4 +
-					(int)(5 * ((double)branch->totalLife - branch->age)/branch->totalLife);
-				myCounters->trunks++;
-				branch->shootGrace = SPLIT_SHOOT_GRACE;  // parent gets a clean stretch after the split
-				branch->shootCooldown = (25 - branch->multiplier)/4;
-				// sequence the two draws explicitly (v1 left this order
-				// unspecified inside the initializer list)
-				int splitLife = branch->life - mrand(growth, 6);
-				int splitTotalLife = branch->life - mrand(growth, 6);
-				// fork divergence: child and parent commit to opposite sides so
-				// a split reads as a real fork. Divergence grows with the
-				// multiplier, so high M makes bold forks instead of a tangle.
-				int divStrength = 1 + branch->multiplier / 7;   // M8->2, M20->3
-				if (divStrength > LEAN_MAX) divStrength = LEAN_MAX;
-				int side = (mrand(growth, 2) == 0) ? 1 : -1;
-				int childLean = branch->lean + side * divStrength;
-				int parentLean = branch->lean - side * divStrength;
-				if (childLean > LEAN_MAX) childLean = LEAN_MAX;
-				else if (childLean < -LEAN_MAX) childLean = -LEAN_MAX;
-				if (parentLean > LEAN_MAX) parentLean = LEAN_MAX;
-				else if (parentLean < -LEAN_MAX) parentLean = -LEAN_MAX;
-				// jin/shari: occasionally this fork is destined to die back — it
-				// grows alive and leafy, then turns to bare wood once its life
-				// drops to ~a third remaining. Decided on its own stream so
-				// trees with no dead limb are byte-identical to before.
-				int childDieback = 0;
-				if (mrand(deadRng, DEADWOOD_CHANCE) == 0)
-					childDieback = splitTotalLife / 3 + mrand(deadRng, splitTotalLife / 6 + 1);
-				struct Branch newBranch = {
-					.x = branch->x,
-					.y = branch->y,
-					.type = trunk,
-					.life = splitLife,
-					.age = 0,
-					.totalLife = splitTotalLife,
-					.multiplier = branch->multiplier,
-					.lean = childLean,
-					.splitDepth = branch->splitDepth + 1,
-					.shootGrace = SPLIT_SHOOT_GRACE,   // child also starts with a clean stretch
-					.diebackLife = childDieback,
-					.shootCooldown = conf->multiplier,
-					.dripLeafCooldown = branch->life / 4,
-					.history_count = 0,
-					.history_index = 0,
-					.x_history[0] = branch->x,
-					.y_history[0] = branch->y
-				};
-				msaw_split(growth, &newBranch.leaf_rng);
-				addBranch(list, newBranch, myCounters);
-				branch = &list->branches[branchIdx];
-				branch->lean = parentLean;
-				// cost of splitting — smaller at higher multiplier, since high M
-				// splits far more often (keeps total split drain ~M-independent)
-				int splitCoef = (32 - conf->multiplier) / 5;   // M7->5, M14->3, M20->2
-				if (splitCoef < 1) splitCoef = 1;
-				branch->life -= mrand(growth, 1) + (int)(splitCoef * ((double)branch->totalLife - branch->age)/branch->totalLife);
-			}
-		}
 
-		// Then check for regular branch shoots (deadwood limbs stay bare)
-		int branchDice = getBranchRollThreshold(branch->age, branch->totalLife, branch->multiplier);
-		if (branch->shootCooldown <= 0 && !branch->deadwood && branch->shootGrace <= 0
-			&& mrand(growth, branchDice) == 0
-			&& !structuralCrowded(list, branch->x, branch->y, branchIdx, SHOOT_MIN_DIST)) {
-			branch->shootCooldown = myCounters->trunks + (25 - branch->multiplier)/6;
-			int shootLife = ((branch->life * 3)/4 + mrand(growth, branch->multiplier) - 2);
-			// ceiling: shoot life (and thus sideways reach) tracks the trunk's
-			// height budget, so a shoot off a fresh high-life base can't run
-			// clear across the screen. Applied before the floor so the floor
-			// always wins as the lower bound on tiny trees.
-			int shootCap = branch->totalLife / SHOOT_LIFE_CAP_DIV + branch->multiplier/3;
-			if (shootLife > shootCap)
-				shootLife = shootCap;
-			// floor keeps shoots near the top of the trunk acting like
-			// branches for a few steps before their dying phase, instead
-			// of being born straight into it
-			if (shootLife < 8 + branch->multiplier/3)
-				shootLife = 8 + branch->multiplier/3;
-
-			myCounters->shoots++;
-			myCounters->shootCounter++;
-
-			// side-runs: commit to one flank for a short run, then flip, so
-			// shoots group into alternating clusters (feeds the canopy pads)
-			if (myCounters->shootRunRemaining <= 0) {
-				myCounters->shootSide = (myCounters->shootSide == shootLeft) ? shootRight : shootLeft;
-				myCounters->shootRunRemaining = 1 + mrand(growth, 1 + branch->multiplier / SHOOT_RUN_MDIV);
-			}
-			enum branchType shootType = (enum branchType)myCounters->shootSide;
-			myCounters->shootRunRemaining--;
-
-			struct Branch newBranch = {
-				.x = branch->x,
-				.y = branch->y,
-				.type = shootType,
-				.life = shootLife,
-				.age = 0,
-				.totalLife = shootLife,
-				.multiplier = branch->multiplier,
-				.lean = branch->lean,   // shoots sweep with the trunk they grow from
-				.shootCooldown = conf->multiplier,
-				.dripLeafCooldown = shootLife / 4,
-				.history_count = 0,
-				.history_index = 0,
-				.x_history[0] = branch->x,
-				.y_history[0] = branch->y
-			};
-			msaw_split(growth, &newBranch.leaf_rng);
-			addBranch(list, newBranch, myCounters);
-			branch = &list->branches[branchIdx];
-
-			branch->life -= mrand(growth, 3); // cost of sprouting
-		}
-	}
-	myCounters->trunkSplitCooldown--;
-	branch->shootGrace--;
-	branch->shootCooldown--;
-	branch->dripLeafCooldown--;
-
-	// move in x and y directions
-	branch->x += branch->dx;
-	branch->y += branch->dy;
-	if(conf->proceduralMode && branch->type != dying && branch->type != dead)
-		update_position_history(branch);
-
-	enum branchType displayType = (branch->life < 4) ? dying : branch->type;
-	struct ColorResult cr = chooseColorResult_v2(displayType, cosmetic);
-
-	// choose string to use for this branch
-	char *branchStr = chooseString_v2(conf, displayType, branch->life, branch->dx, branch->dy, cosmetic);
-
-	// deadwood (jin/shari): bare bleached wood. Force a trunk glyph (otherwise
-	// chooseString_v2 emits leaf glyphs once life<4) and a mostly-bleached
-	// colour, occasionally dark, for a weathered look.
-	if (branch->deadwood) {
-		const char *tg = (branch->dy == 0) ? "/~"
-					   : (branch->dx < 0)  ? "\\|"
-					   : (branch->dx == 0) ? "/|\\"
-					   :                     "|/";
-		strcpy(branchStr, tg);
-		cr.attrs = 0;   // no bold: keeps the dead wood muted rather than bright
-		cr.color_pair = (mrand(cosmetic, 4) == 0) ? 21 : 24;
-	}
-
-	// grab wide character from branchStr
-	wchar_t wc = 0;
-	mbstate_t ps = {0};
-	mbrtowc(&wc, branchStr, 32, &ps);
-
-	// write to grid, but ensure wide characters don't overlap.
-	// --bare suppresses leaf glyphs only (dying/dead); the RNG was already
-	// drawn above, so the woody structure stays byte-identical with/without it.
-	int w = wcwidth(wc);
-	if (w <= 0) w = 1;
-	int isLeafGlyph = (displayType == dying || displayType == dead);
-	if(branch->x % w == 0 && !(conf->hideLeaves && isLeafGlyph)) {
-		grid_put(skeleton, branch->x, branch->y, branchStr, cr.attrs, cr.color_pair);
-	}
-
-	free(branchStr);
-}
-
-// v2: faithful port of leafStepWalkers; each walker advances its own msaw
-// stream (replacing rand_r) and children fork via msaw_split
-static void leafStep_v2(struct config *conf, struct VirtualGrid *grid,
-						enum branchType type, int groundY,
-						struct LeafWalker **walkers, int *count, int *capacity) {
-	int prev_count = *count;
-	for (int w = 0; w < prev_count; w++) {
-		struct LeafWalker *wk = &(*walkers)[w];
-
-		int dx = 0, dy = 0, dice;
-		switch (type) {
-		case dying:
-			dice = mrand(&wk->rng, 10);
-			if (dice >= 0 && dice <= 0) dy = -1;
-			else if (dice >= 1 && dice <= 8) dy = 0;
-			else if (dice >= 9 && dice <= 9) dy = 1;
-
-			dice = mrand(&wk->rng, 15);
-			if (dice >= 0 && dice <= 0) dx = -3;
-			else if (dice >= 1 && dice <= 2) dx = -2;
-			else if (dice >= 3 && dice <= 5) dx = -1;
-			else if (dice >= 6 && dice <= 8) dx = 0;
-			else if (dice >= 9 && dice <= 11) dx = 1;
-			else if (dice >= 12 && dice <= 13) dx = 2;
-			else if (dice >= 14 && dice <= 14) dx = 3;
-			break;
-		case dead:
-			dice = mrand(&wk->rng, 12);
-			if (dice >= 0 && dice <= 1) dy = -1;
-			else if (dice >= 2 && dice <= 8) dy = 0;
-			else if (dice >= 9 && dice <= 11) dy = 1;
-
-			dice = mrand(&wk->rng, 15);
-			if (dice >= 0 && dice <= 1) dx = -3;
-			else if (dice >= 2 && dice <= 3) dx = -2;
-			else if (dice >= 4 && dice <= 5) dx = -1;
-			else if (dice >= 6 && dice <= 8) dx = 0;
-			else if (dice >= 9 && dice <= 10) dx = 1;
-			else if (dice >= 11 && dice <= 12) dx = 2;
-			else if (dice >= 13 && dice <= 14) dx = 3;
-			break;
-		default:
-			break;
-		}
+// ==========================================================================
+// TREE SERVICE  (--serve daemon, --client)
+// ==========================================================================
 
-		// canopy pads: lean the walk outward from the trunk. This remaps dx
-		// without drawing extra RNG, so the walker stream is unchanged.
-		if (wk->outward > 0) {
-			if (dx == 0) dx = LEAF_PAD_BIAS;
-			else if (dx < -LEAF_PAD_INWARD) dx = -LEAF_PAD_INWARD;
-		} else if (wk->outward < 0) {
-			if (dx == 0) dx = -LEAF_PAD_BIAS;
-			else if (dx > LEAF_PAD_INWARD) dx = LEAF_PAD_INWARD;
-		}
+// One request per connection. The client sends a single line
+//   cbonsai-serve 1 ENGINE SEED LIFE MULT BASE PROCEDURAL BARE COLS ROWS LEAVES
+// (LEAVES: the -c strings joined by commas, to the end of the line) and
+// gets back "ok LENGTH\n" and the rendered tree, or "error MESSAGE\n".
+#define SERVE_PROTOCOL 1
 
-		if (dy > 0 && wk->y > (groundY - 2))
-			dy--;
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0	// no per-call flag; --serve ignores SIGPIPE instead
+#endif
 
-		struct msaw child_rng;
-		msaw_split(&wk->rng, &child_rng);
-		if (*count < 4096) {
-			if (*count >= *capacity) {
-				*capacity *= 2;
-				*walkers = realloc(*walkers, sizeof(struct LeafWalker) * (size_t)*capacity);
-				wk = &(*walkers)[w];
-			}
-			struct LeafWalker child = {.x = wk->x, .y = wk->y, .seed = 0,
-									   .outward = wk->outward};
-			child.rng = child_rng;
-			(*walkers)[(*count)++] = child;
-		}
+// $XDG_RUNTIME_DIR/cbonsai.sock, else /tmp/cbonsai-UID/serve.sock in a
+// directory only this user can enter. NULL if that directory exists but
+// belongs to someone else or is open to others: whoever owns it could
+// put their own server there.
+char *defaultSocketPath(void) {
+	const char *runtime = getenv("XDG_RUNTIME_DIR");
+	char path[4096];
+	if (runtime && *runtime) {
+		snprintf(path, sizeof(path), "%s/cbonsai.sock", runtime);
+	} else {
+		char dir[64];
+		snprintf(dir, sizeof(dir), "/tmp/cbonsai-%u", (unsigned)getuid());
+		mkdir(dir, 0700);
+		struct stat st;
+		if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077))
+			return NULL;
+		snprintf(path, sizeof(path), "%s/serve.sock", dir);
+	}
+	char *result = malloc(strlen(path) + 1);
+	strcpy(result, path);
+	return result;
+}
 
-		wk->x += dx;
-		wk->y += dy;
-
-		if (wk->y >= 0 && wk->y < groundY) {
-			attr_t la = 0;
-			short lc = 0;
-			switch (type) {
-			case dying:
-				if (mrand(&wk->rng, 6) == 0) { lc = 22; }
-				else if (mrand(&wk->rng, 2) == 0) { la = A_BOLD; lc = 23; }
-				else { lc = 23; }
-				break;
-			case dead:
-				if (mrand(&wk->rng, 7) == 0) { la = A_BOLD; lc = 22; }
-				else if (mrand(&wk->rng, 2) == 0) { la = A_BOLD; lc = 23; }
-				else { lc = 23; }
-				break;
-			default:
-				break;
-			}
+// The uid at the other end of a connected Unix socket. Returns 0 if the
+// platform can tell.
+static int peerUid(int fd, uid_t *uid) {
+#ifdef SO_PEERCRED
+	struct peerCred cred;
+	socklen_t len = sizeof(cred);
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 || len != sizeof(cred)) return 1;
+	*uid = cred.uid;
+	return 0;
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
+	gid_t gid;
+	return getpeereid(fd, uid, &gid) != 0;
+#else
+	(void)fd;
+	(void)uid;
+	return 1;
+#endif
+}
 
-			// draw the leaf glyph (still consume the RNG when --bare so the
-			// hidden-foliage tree is identical to the shown one)
-			char *leafStr = conf->leaves[mrand(&wk->rng, conf->leavesSize)];
-			if (!conf->hideLeaves)
-				grid_put(grid, wk->x, wk->y, leafStr, la, lc);
-		}
-	}
+// path is a socket this user created: where peerUid cannot tell, another
+// user's socket is still turned away before anything is read from it
+static int socketIsOurs(const char *path) {
+	struct stat st;
+	return lstat(path, &st) == 0 && S_ISSOCK(st.st_mode) && st.st_uid == getuid();
 }
 
-void generateLeaves_v2(struct config *conf, struct VirtualGrid *grid, enum branchType type,
-					   int x, int y, int life, const struct msaw *leafRng, int groundY,
-					   int outward) {
-	int capacity = 16;
-	int count = 1;
-	struct LeafWalker *walkers = malloc(sizeof(struct LeafWalker) * (size_t)capacity);
-	walkers[0] = (struct LeafWalker){.x = x, .y = y, .seed = 0, .outward = outward};
-	walkers[0].rng = *leafRng;
-
-	for (int step = 0; step < life; step++) {
-		leafStep_v2(conf, grid, type, groundY, &walkers, &count, &capacity);
-	}
-
-	free(walkers);
-}
-
-// v2: advance the trunk-widening animation by one tick. Each trunk cell grows
-// its rendered half-width toward a target — distance-from-base taper scaled by
-// the tree's maturity (gated by TRUNK_MIN_HEIGHT) — one step at a time, with a
-// random [0,7]-tick gap between steps, so the lower trunk fills out gradually
-// rather than all at once. Pure presentation: draws from `rng` only.
-static void advanceTrunkWiden(struct VirtualGrid *tp, int trunk_y, struct msaw *rng) {
-	int apexY = trunk_y;
-	for (int gy = 0; gy < tp->height; gy++) {
-		int found = 0;
-		for (int gx = 0; gx < tp->width; gx++)
-			if (tp->cells[gy * tp->width + gx].occupied) { found = 1; break; }
-		if (found) { apexY = tp->anchor_y + gy; break; }
-	}
-	int height = trunk_y - apexY;
-	int baseHalf = 0;
-	if (height >= TRUNK_MIN_HEIGHT) {
-		baseHalf = 1 + (height - TRUNK_MIN_HEIGHT) / TRUNK_GROW_DIV;
-		if (baseHalf > TRUNK_MAX_HALF) baseHalf = TRUNK_MAX_HALF;
-	}
-
-	for (int gy = 0; gy < tp->height; gy++) {
-		for (int gx = 0; gx < tp->width; gx++) {
-			struct GridCell *c = &tp->cells[gy * tp->width + gx];
-			if (!c->occupied) continue;
-			int cy = tp->anchor_y + gy;
-			// fork-thinning: each split deep scales the base width by 4/5
-			int sh = baseHalf;
-			for (int d = 0; d < c->splitDepth; d++) sh = (sh * 4) / 5;
-			int target = sh - (trunk_y - cy) / TRUNK_TAPER_DIV;
-			if (target < 0) target = 0;
-			if (c->widenHalf < target) {
-				if (c->widenTimer > 0) c->widenTimer--;
-				else { c->widenHalf++; c->widenTimer = mrand(rng, 8); }  // 0..7
-			}
+// writeAll for sockets: a peer that went away is an error, not a SIGPIPE
+int sendAll(int fd, const char *data, size_t len) {
+	while (len > 0) {
+		ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return 1;
 		}
+		data += n;
+		len -= (size_t)n;
 	}
+	return 0;
 }
 
-// v2 trunk widening: render the body under the skeleton using each cell's
-// animated half-width (advanceTrunkWiden owns the timing). "Widen from the
-// inside" — the stored centerline glyph's outer chars become the sloped edges
-// (lean baked in), its middle becomes the fill. The left/right reach are
-// computed independently so the trunk can bulge to the outside of a lean and
-// stop short of a neighbouring arm (no welding into a slab).
-static void drawWidenedTrunk(struct VirtualGrid *tp, WINDOW *win,
-							 int trunk_y, int off_x, int off_y) {
-	(void)trunk_y;  // taper baked into each cell's widenHalf
-	int wh, ww;
-	getmaxyx(win, wh, ww);
-
-	for (int gy = 0; gy < tp->height; gy++) {
-		struct GridCell *row = &tp->cells[gy * tp->width];
-		for (int gx = 0; gx < tp->width; gx++) {
-			struct GridCell *cell = &row[gx];
-			if (!cell->occupied) continue;
-			int cx = tp->anchor_x + gx;
-			int cy = tp->anchor_y + gy;
-
-			int half = cell->widenHalf;
-
-			// look at the connected centerline in the rows above/below (nearest
-			// occupied cell within reach) so the body can follow the trunk's bends
-			int aboveOff = 99, belowOff = 99, aboveHalf = 0;
-			if (gy > 0) {
-				struct GridCell *up = &tp->cells[(gy - 1) * tp->width];
-				for (int o = -2; o <= 2; o++) {
-					int nx = gx + o;
-					if (nx >= 0 && nx < tp->width && up[nx].occupied && abs(o) < abs(aboveOff)) {
-						aboveOff = o; aboveHalf = up[nx].widenHalf;
-					}
-				}
-			}
-			if (gy + 1 < tp->height) {
-				struct GridCell *dn = &tp->cells[(gy + 1) * tp->width];
-				for (int o = -2; o <= 2; o++) {
-					int nx = gx + o;
-					if (nx >= 0 && nx < tp->width && dn[nx].occupied && abs(o) < abs(belowOff))
-						belowOff = o;
-				}
-			}
-
-			// bottom-most layer (nothing below): grow out to match the trunk
-			// just above it instead of being width-limited, so the base doesn't
-			// pinch in. It stays symmetric (the bias below is skipped for it),
-			// so it ends up ~1 wider than the biased row above — the natural
-			// off-by-one flare.
-			int isBase = (belowOff == 99);
-			if (isBase && aboveHalf > half) half = aboveHalf;
-
-			if (half < 1) continue;   // not yet widened: centerline only
-
-			const char *g = cell->ch;
-			int len = (int)strlen(g);
-			char ledge[2] = { g[0], 0 };
-			char redge[2] = { len > 0 ? g[len - 1] : '|', 0 };
-			char fill[2]  = { (len == 3) ? g[1] : '|', 0 };
-
-			int lh = half, rh = half;
-
-			// bias toward the side(s) where the trunk continues above/below,
-			// so the body follows the centerline's bends rather than growing
-			// straight out (thin the side with no trunk neighbour). Skipped for
-			// the base, which stays symmetric and full.
-			if (!isBase) {
-				int wantRight = (aboveOff != 99 && aboveOff > 0) || (belowOff != 99 && belowOff > 0);
-				int wantLeft  = (aboveOff != 99 && aboveOff < 0) || (belowOff != 99 && belowOff < 0);
-				if (wantRight && !wantLeft && lh > 0) lh--;
-				else if (wantLeft && !wantRight && rh > 0) rh--;
-			}
+// Read one '\n'-terminated line (terminator stripped). Returns 0 on success,
+// 1 on EOF, error, timeout or a line that does not fit.
+int recvLine(int fd, char *buf, size_t size) {
+	size_t len = 0;
+	for (;;) {
+		char ch;
+		ssize_t n = recv(fd, &ch, 1, 0);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return 1;
+		if (ch == '\n') break;
+		if (len + 1 >= size) return 1;
+		buf[len++] = ch;
+	}
+	buf[len] = '\0';
+	return 0;
+}
 
-			// anti-weld: a flank only fills empty cells and stops short of a
-			// neighbouring arm's centerline, splitting the gap so two arms
-			// never merge into a slab
-			int e = 0;
-			while (e < rh && (gx + 1 + e >= tp->width || !row[gx + 1 + e].occupied)) e++;
-			if (gx + 1 + e < tp->width && row[gx + 1 + e].occupied) { rh = (e - 1) / 2; if (rh < 0) rh = 0; }
-			e = 0;
-			while (e < lh && (gx - 1 - e < 0 || !row[gx - 1 - e].occupied)) e++;
-			if (gx - 1 - e >= 0 && row[gx - 1 - e].occupied) { lh = (e - 1) / 2; if (lh < 0) lh = 0; }
-
-			if (lh < 1 && rh < 1) continue;
-
-			for (int d = -lh; d <= rh; d++) {
-				int wx = cx + d + off_x;
-				int wy = cy + off_y;
-				if (wx < 0 || wx >= ww || wy < 0 || wy >= wh) continue;
-				if (d == 0) continue;                 // centerline drawn by skeleton
-				const char *ch; short pair; attr_t at = 0;
-				if (d == -lh)      { ch = ledge; pair = 21; at = A_BOLD; }
-				else if (d == rh)  { ch = redge; pair = 21; at = A_BOLD; }
-				else               { ch = fill;  pair = 20; }
-				wattron(win, at | COLOR_PAIR(pair));
-				mvwaddstr(win, wy, wx, ch);
-				wattroff(win, at | COLOR_PAIR(pair));
-			}
+// Format conf's tree as a request line. Returns its length, or -1 if it
+// does not fit in size.
+int serveRequestLine(const struct config *conf, char *buf, size_t size) {
+	int n = snprintf(buf, size, "cbonsai-serve %d %d %d %d %d %d %d %d %d %d ",
+					 SERVE_PROTOCOL, conf->version, conf->seed, conf->lifeStart, conf->multiplier,
+					 conf->baseType, conf->proceduralMode, conf->hideLeaves, conf->cols, conf->rows);
+	for (int i = 0; i < conf->leavesSize; i++) {
+		for (const char *p = conf->leaves[i]; *p; p++) {
+			if ((size_t)n + 2 >= size) return -1;
+			buf[n++] = *p == '\n' ? ' ' : *p;
 		}
+		if (i + 1 < conf->leavesSize) buf[n++] = ',';
 	}
+	if ((size_t)n + 2 >= size) return -1;
+	buf[n++] = '\n';
+	buf[n] = '\0';
+	return n;
 }
 
-// v2 engine: structurally a faithful port of v1, but fully self-seeded
-// from explicit msaw streams — it never touches the global rand() stream,
-// so growth, cosmetics and leaf walkers are independently deterministic.
-void growTree_v2(struct config *conf, struct ncursesObjects *objects, struct counters *myCounters) {
-	int maxY, maxX;
-	getmaxyx(objects->treeWin, maxY, maxX);
-
-	struct msaw growth, cosmetic, widenRng, deadRng;
-	msaw_seed(&growth, (uint64_t)conf->seed);
-	msaw_seed(&cosmetic, (uint64_t)conf->seed ^ MSAW_COSMETIC_SALT);
-	msaw_seed(&widenRng, (uint64_t)conf->seed ^ MSAW_WIDEN_SALT);
-	msaw_seed(&deadRng, (uint64_t)conf->seed ^ MSAW_DEADWOOD_SALT);
-
-	int baseHeight = getBaseHeight(conf->baseType);
-	struct VirtualGrid *skeleton = grid_create(maxX, maxY + baseHeight, 0, 0);
-	struct VirtualGrid *trunkPlane = grid_create(maxX, maxY + baseHeight, 0, 0);
-	struct VirtualGrid *renderPlane = trunkPlane;  // v2: render the widened trunk under the skeleton
-	int trunk_x = maxX / 2;
-	int trunk_y = maxY - 1 - baseHeight;
-	int off_x = 0, off_y = 0;
-	int rimLo = trunk_x, rimHi = trunk_x;
-
-	drawBaseToGrid(skeleton, conf->baseType, trunk_x, trunk_y);
-	drawPotRim(skeleton, conf->baseType, trunk_x, trunk_y, rimLo, rimHi);
-
-	struct BranchList branchList;
-	initBranchList(&branchList);
-
-	myCounters->trunks = 0;
-	myCounters->shoots = 0;
-	myCounters->branches = 0;
-	myCounters->shootCounter = 5;
-	myCounters->globalTime = 0;
-	myCounters->trunkSplitCooldown = 0;
-	// random starting flank; runs flip from here (see shoot side-runs below)
-	myCounters->shootSide = (mrand(&growth, 2) == 0) ? shootLeft : shootRight;
-	myCounters->shootRunRemaining = 0;
-
-	// gentle random whole-tree lean (windswept variety); the dramatic shaping
-	// comes from fork divergence, so the base tilt stays mild
-	int baseLean = mrand(&growth, 3) - 1;   // -1, 0, +1
-	struct Branch initialBranch = {
-		.x = trunk_x,
-		.y = trunk_y,
-		.life = conf->lifeStart,
-		.age = 0,
-		.type = trunk,
-		.shootCooldown = conf->multiplier,
-		.dripLeafCooldown = conf->multiplier + conf->lifeStart / 4,
-		.totalLife = conf->lifeStart,
-		.multiplier = conf->multiplier,
-		.lean = baseLean
-	};
-	msaw_split(&growth, &initialBranch.leaf_rng);
-	addBranch(&branchList, initialBranch, myCounters);
-
-	int turn = 0;
-	while (branchList.count > 0) {
-		myCounters->globalTime++;
-
-		if (branchList.branches[turn].life <= 0) {
-			struct Branch* b = &branchList.branches[turn];
-			if (conf->proceduralMode &&
-				b->type != dying && b->type != dead &&
-				!b->deadwood &&                  // deadwood dies bare, no leaf burst
-				b->totalLife > 0) {
-				double lifeRatio = ((double)b->age) / b->totalLife;
-
-				int avg_x, avg_y;
-				get_average_position(b, &avg_x, &avg_y);
-
-				int log_factor = 0, dummy = b->age;
-				while(dummy > 0) {
-					log_factor++;
-					dummy >>= 1;
-				}
+// Fill in conf from a request line, validated as main validates the same
+// options. conf->leaves point into line. Returns 0 on success.
+int serveParseRequest(char *line, struct config *conf) {
+	int protocol, used = 0;
+	if (sscanf(line, "cbonsai-serve %d %d %d %d %d %d %d %d %d %d %n", &protocol,
+			   &conf->version, &conf->seed, &conf->lifeStart, &conf->multiplier, &conf->baseType,
+			   &conf->proceduralMode, &conf->hideLeaves, &conf->cols, &conf->rows, &used) != 10 || !used)
+		return 1;
+	if (protocol != SERVE_PROTOCOL || conf->version < 1 || conf->version > 2 || conf->seed < 0 ||
+		conf->lifeStart < 10 || conf->lifeStart > 500 || conf->multiplier < 1 || conf->multiplier > 20 ||
+		conf->cols < 1 || conf->cols > 1000 || conf->rows < 1 || conf->rows > 1000)
+		return 1;
 
-				int leafLife = log_factor + lifeRatio * ((b->type == trunk) ? 4 : 3);
-				enum branchType newType = (b->type == trunk) ? dead : dying;
+	int maxLeaves = (int)(sizeof(conf->leaves) / sizeof(conf->leaves[0]));
+	char *save = NULL;
+	conf->leavesSize = 0;
+	for (char *token = strtok_r(line + used, ",", &save); token; token = strtok_r(NULL, ",", &save)) {
+		if (conf->leavesSize < maxLeaves) conf->leaves[conf->leavesSize++] = token;
+	}
+	return conf->leavesSize == 0;
+}
 
-				// canopy pads: clusters lean away from the trunk centerline
-				int leafOutward = (avg_x < trunk_x) ? -1 : (avg_x > trunk_x) ? 1 : 0;
-				generateLeaves_v2(conf, skeleton, newType, avg_x, avg_y, leafLife, &b->leaf_rng, trunk_y + 1, leafOutward);
-			}
+// Copy a cached render into out and mark it used. Caller holds s->lock.
+static int serveLookup(struct server *s, unsigned long long hash, const struct textBuf *key, struct textBuf *out) {
+	for (int i = 0; i < s->lruCount; i++) {
+		struct serveEntry *e = &s->lru[i];
+		if (e->hash != hash || e->key.len != key->len || memcmp(e->key.data, key->data, key->len))
+			continue;
+		e->used = ++s->clock;
+		textAppend(out, e->render.data, e->render.len);
+		return 0;
+	}
+	return 1;
+}
 
-			free(b->walkers);
-			b->walkers = NULL;
-			b->walker_count = 0;
-			b->walker_capacity = 0;
-			grid_destroy(b->leafGrid);
-			b->leafGrid = NULL;
+// Add a render, replacing the least recently used one when full. Caller
+// holds s->lock; two workers that grew the same tree keep one copy.
+static void serveInsert(struct server *s, unsigned long long hash, const struct textBuf *key, const struct textBuf *render) {
+	struct textBuf dummy = {0};
+	if (!serveLookup(s, hash, key, &dummy)) {
+		free(dummy.data);
+		return;
+	}
+	struct serveEntry *e;
+	if (s->lruCount < SERVE_LRU_ENTRIES) {
+		e = &s->lru[s->lruCount++];
+	} else {
+		e = &s->lru[0];
+		for (int i = 1; i < s->lruCount; i++)
+			if (s->lru[i].used < e->used) e = &s->lru[i];
+		free(e->key.data);
+		free(e->render.data);
+	}
+	*e = (struct serveEntry){.hash = hash, .used = ++s->clock};
+	textAppend(&e->key, key->data, key->len);
+	textAppend(&e->render, render->data, render->len);
+}
 
-			removeBranch(&branchList, turn);
-			if (turn >= branchList.count) {
-				turn = 0;
-			}
-			continue;
-		}
+static void serveAnswer(struct server *s, const struct serveJob *job) {
+	char line[4096];
+	struct config conf = *s->conf;
+	if (recvLine(job->fd, line, sizeof(line)))
+		return;
+	if (serveParseRequest(line, &conf)) {
+		sendAll(job->fd, "error bad request\n", 18);
+		return;
+	}
 
-		updateBranch_v2(conf, skeleton, myCounters, turn, &branchList, &growth, &cosmetic, &deadRng);
-
-		// record trunk cells in the trunk plane, storing the centerline glyph
-		// (its outer chars become the widened edges) and keeping the pot rim
-		// hugging the trunk's footprint
-		{
-			struct Branch *ub = &branchList.branches[turn];
-			if (ub->type == trunk && !ub->deadwood) {  // deadwood stays a thin bare spar
-				// same centerline glyph chooseString_v2 draws for a trunk;
-				// drawWidenedTrunk relocates its edge chars outward
-				const char *tg = (ub->dy == 0) ? "/~"
-							   : (ub->dx < 0)  ? "\\|"
-							   : (ub->dx == 0) ? "/|\\"
-							   :                 "|/";
-				grid_put(trunkPlane, ub->x, ub->y, tg, 0, 0);
-				struct GridCell *tc = grid_at(trunkPlane, ub->x, ub->y);
-				if (tc) {
-					tc->splitDepth = ub->splitDepth;   // deeper forks widen less
-					// random initial delay so the lower trunk widens
-					// cell-by-cell (staggered) rather than in lockstep
-					if (tc->widenHalf == 0)
-						tc->widenTimer = mrand(&widenRng, 8);
-				}
-			}
-		}
+	struct textFrontend tf = {.plain = 0};
+	memcpy(tf.palette, job->palette, sizeof(tf.palette));
+	struct textBuf key = {0};
+	renderCacheKey(&conf, tf.palette, &key);
+	unsigned long long hash = renderKeyHash(&key);
+
+	pthread_mutex_lock(&s->lock);
+	int miss = serveLookup(s, hash, &key, &tf.out);
+	pthread_mutex_unlock(&s->lock);
+	if (miss) {
+		struct counters myCounters = {0};
+		const struct frontend text = {
+			.ctx = &tf,
+			.begin = textBegin,
+			.step = textStep,
+			.finish = textFinish
+		};
+		growTree(&conf, &text, &myCounters);
+		pthread_mutex_lock(&s->lock);
+		serveInsert(s, hash, &key, &tf.out);
+		pthread_mutex_unlock(&s->lock);
+	}
+
+	char header[32];
+	int n = snprintf(header, sizeof(header), "ok %zu\n", tf.out.len);
+	if (!sendAll(job->fd, header, (size_t)n))
+		sendAll(job->fd, tf.out.data, tf.out.len);
+	free(tf.out.data);
+	free(key.data);
+}
 
-		// advance the trunk-widening animation one tick
-		advanceTrunkWiden(trunkPlane, trunk_y, &widenRng);
-
-		// keep the pot rim hugging the widened trunk base (which thickens over
-		// time), not just the thin centerline
-		{
-			int ly = trunk_y - trunkPlane->anchor_y;
-			if (ly >= 0 && ly < trunkPlane->height) {
-				int lo = trunk_x, hi = trunk_x;
-				for (int gx = 0; gx < trunkPlane->width; gx++) {
-					struct GridCell *c = &trunkPlane->cells[ly * trunkPlane->width + gx];
-					if (!c->occupied) continue;
-					int cx = trunkPlane->anchor_x + gx;
-					if (cx - c->widenHalf < lo) lo = cx - c->widenHalf;
-					if (cx + c->widenHalf > hi) hi = cx + c->widenHalf;
-				}
-				if (lo != rimLo || hi != rimHi) {
-					rimLo = lo; rimHi = hi;
-					drawPotRim(skeleton, conf->baseType, trunk_x, trunk_y, rimLo, rimHi);
-				}
-			}
+static void *serveWorker(void *arg) {
+	struct server *s = arg;
+	for (;;) {
+		pthread_mutex_lock(&s->lock);
+		while (!s->queued && !s->stopping)
+			pthread_cond_wait(&s->work, &s->lock);
+		if (!s->queued) {
+			pthread_mutex_unlock(&s->lock);
+			return NULL;
 		}
+		struct serveJob job = s->queue[s->head];
+		s->head = (s->head + 1) % SERVE_QUEUE;
+		s->queued--;
+		pthread_mutex_unlock(&s->lock);
 
-		if (conf->live && conf->proceduralMode) {
-			for (int i = 0; i < branchList.count; i++) {
-				struct Branch* b = &branchList.branches[i];
+		serveAnswer(s, &job);
+		close(job.fd);
+	}
+}
 
-				if (b->type != trunk && b->type != shootLeft && b->type != shootRight)
-					continue;
-				if (b->deadwood)   // bare limb: no live foliage
-					continue;
-				if (b->totalLife <= 0)
-					continue;
+static volatile sig_atomic_t serveStop = 0;
 
-				int avg_x, avg_y;
-				get_average_position(b, &avg_x, &avg_y);
+// self-pipe: the stop handler writes a byte, so the accept loop's poll
+// wakes even when the signal lands just before it
+static int serveWake[2] = {-1, -1};
 
-				int log_factor = 0, dummy = b->age;
-				while(dummy > 0) {
-					log_factor++;
-					dummy >>= 1;
-				}
-
-				double lifeRatio = ((double)b->age) / b->totalLife;
-				int targetLeafLife = log_factor + lifeRatio * ((b->type == trunk) ? 4 : 3);
-
-				if (!b->walkers) {
-					b->walker_capacity = 16;
-					b->walker_count = 1;
-					b->walkers = malloc(sizeof(struct LeafWalker) * (size_t)b->walker_capacity);
-					int leafOutward = (avg_x < trunk_x) ? -1 : (avg_x > trunk_x) ? 1 : 0;
-					b->walkers[0] = (struct LeafWalker){.x = avg_x, .y = avg_y, .seed = 0,
-														.outward = leafOutward};
-					b->walkers[0].rng = b->leaf_rng;
-					b->leaf_steps_drawn = 0;
-					b->leaf_cur_x = avg_x;
-					b->leaf_cur_y = avg_y;
-					b->leafGrid = grid_create(40, 40, avg_x - 20, avg_y - 20);
-				}
+static void onServeStop(int sig) {
+	(void)sig;
+	serveStop = 1;
+	int saved = errno;
+	ssize_t n = write(serveWake[1], "", 1);
+	(void)n;
+	errno = saved;
+}
 
-				if (avg_x != b->leaf_cur_x || avg_y != b->leaf_cur_y) {
-					int delta_x = avg_x - b->leaf_cur_x;
-					int delta_y = avg_y - b->leaf_cur_y;
-					for (int w = 0; w < b->walker_count; w++) {
-						b->walkers[w].x += delta_x;
-						b->walkers[w].y += delta_y;
-					}
-					b->leafGrid->anchor_x += delta_x;
-					b->leafGrid->anchor_y += delta_y;
-					b->leaf_cur_x = avg_x;
-					b->leaf_cur_y = avg_y;
-				}
+// Hand an accepted connection to the workers, or turn it away if the
+// queue is full or the peer is another user
+static void serveEnqueue(struct server *s, int conn) {
+	// the listening socket is non-blocking; BSDs pass that on
+	fcntl(conn, F_SETFL, fcntl(conn, F_GETFL) & ~O_NONBLOCK);
+	uid_t uid;
+	if (peerUid(conn, &uid) == 0 && uid != getuid()) {
+		close(conn);
+		return;
+	}
+	struct timeval tv = {.tv_sec = 5, .tv_usec = 0};	// a stalled client must not hold a worker
+	setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	struct serveJob job = {.fd = conn};
+	seasonPalette(job.palette);	// localtime: not from the workers
 
-				if (b->leaf_steps_drawn < targetLeafLife) {
-					enum branchType leafType = (b->type == trunk) ? dead : dying;
-					leafStep_v2(conf, b->leafGrid, leafType, trunk_y + 1,
-								&b->walkers, &b->walker_count, &b->walker_capacity);
-					b->leaf_steps_drawn++;
-				}
-			}
-		}
+	pthread_mutex_lock(&s->lock);
+	if (s->queued == SERVE_QUEUE) {
+		pthread_mutex_unlock(&s->lock);
+		sendAll(conn, "error busy\n", 11);	// the client grows it itself
+		close(conn);
+		return;
+	}
+	s->queue[(s->head + s->queued) % SERVE_QUEUE] = job;
+	s->queued++;
+	pthread_cond_signal(&s->work);
+	pthread_mutex_unlock(&s->lock);
+}
 
-		turn = (turn + 1) % branchList.count;
+// --serve: answer tree requests on a Unix socket until SIGINT/SIGTERM,
+// growing uncached trees on jobs worker threads. conf supplies everything
+// a request does not (procedural tuning, engine defaults).
+int runServe(const struct config *conf, const char *socketPath, int jobs) {
+	if (!socketPath) {
+		printf("error: /tmp/cbonsai-%u is not a private directory; set XDG_RUNTIME_DIR or give --serve=SOCKET\n",
+			   (unsigned)getuid());
+		return 1;
+	}
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+		printf("error: socket path too long: %s\n", socketPath);
+		return 1;
+	}
+	strcpy(addr.sun_path, socketPath);
 
-		if (conf->live && !(conf->load && myCounters->globalTime < conf->targetGlobalTime)) {
-			if (liveStepDisplay(conf, objects, skeleton, renderPlane, &branchList, myCounters,
-								trunk_x, trunk_y, baseHeight, &off_x, &off_y,
-								maxX, maxY, turn)) {
-				freeBranchList(&branchList);
-				grid_destroy(skeleton);
-				grid_destroy(trunkPlane);
-				quit(conf, objects, 0);
-			}
-		}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		printf("error: could not create socket\n");
+		return 1;
 	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+		printf("error: a server is already listening on %s\n", socketPath);
+		close(fd);
+		return 1;
+	}
+	close(fd);
+	unlink(socketPath);	// left behind by a server that did not exit cleanly
 
-	if (!conf->no_disp) {
-		blitTree(skeleton, renderPlane, trunk_y, &branchList, objects, off_x, off_y);
-		update_panels();
-		doupdate();
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	mode_t oldMask = umask(077);	// this user's trees only
+	int bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(oldMask);
+	if (bound != 0 || listen(fd, SERVE_QUEUE) != 0 || pipe(serveWake) != 0) {
+		printf("error: could not listen on %s\n", socketPath);
+		close(fd);
+		return 1;
 	}
+	// never block in accept: a client that gave up between poll and
+	// accept, or the drain after a stop, must not hang the loop
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(serveWake[1], F_SETFL, fcntl(serveWake[1], F_GETFL) | O_NONBLOCK);
+
+	// no SA_RESTART: a stop signal must interrupt poll()
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onServeStop;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+
+	struct server *s = calloc(1, sizeof(struct server));
+	s->conf = conf;
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_cond_init(&s->work, NULL);
+	pthread_t *workers = malloc(sizeof(pthread_t) * (size_t)jobs);
+	int started = 0;
+	for (; started < jobs; started++) {
+		if (pthread_create(&workers[started], NULL, serveWorker, s) != 0) break;
+	}
+	if (started == 0) {
+		printf("error: could not start server threads\n");
+		serveStop = 1;
+	} else {
+		printf("cbonsai: serving on %s with %d workers\n", socketPath, started);
+		fflush(stdout);
+	}
+
+	struct pollfd pfd[2] = {{.fd = fd, .events = POLLIN}, {.fd = serveWake[0], .events = POLLIN}};
+	while (!serveStop) {
+		if (poll(pfd, 2, -1) < 0 || !(pfd[0].revents & POLLIN)) continue;	// EINTR, or the stop byte
+		int conn = accept(fd, NULL, NULL);
+		if (conn >= 0) serveEnqueue(s, conn);
+	}
+
+	// stop: unlink first so no new client finds the socket, then answer
+	// every connection already made instead of resetting it with close
+	unlink(socketPath);
+	int conn;
+	while (started && (conn = accept(fd, NULL, NULL)) >= 0)
+		serveEnqueue(s, conn);
+	close(fd);
+	close(serveWake[0]);
+	close(serveWake[1]);
+	serveWake[0] = serveWake[1] = -1;
+	pthread_mutex_lock(&s->lock);
+	s->stopping = 1;
+	pthread_cond_broadcast(&s->work);
+	pthread_mutex_unlock(&s->lock);
+	for (int i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+
+	for (int i = 0; i < s->lruCount; i++) {
+		free(s->lru[i].key.data);
+		free(s->lru[i].render.data);
+	}
+	pthread_cond_destroy(&s->work);
+	pthread_mutex_destroy(&s->lock);
+	free(workers);
+	free(s);
+	return started ? 0 : 1;
+}
 
-	finalHold(conf, objects, skeleton, renderPlane, &branchList, trunk_x, trunk_y, baseHeight, &off_x, &off_y);
+// --client with -p: have the server render the tree. Returns 0 once it is
+// printed; anything else (no server, busy, error) returns 1 having printed
+// nothing, and the caller grows the tree itself.
+int clientPrint(struct config *conf, const char *socketPath) {
+	termSize(&conf->cols, &conf->rows);
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (!socketPath || strlen(socketPath) >= sizeof(addr.sun_path) || !socketIsOurs(socketPath)) return 1;
+	strcpy(addr.sun_path, socketPath);
+
+	char line[4096];
+	int len = serveRequestLine(conf, line, sizeof(line));
+	if (len < 0) return 1;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) return 1;
+	struct timeval tv = {.tv_sec = 30, .tv_usec = 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	size_t size;
+	uid_t uid;
+	// the reply goes straight to the terminal: only trust our own server
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+		(peerUid(fd, &uid) == 0 && uid != getuid()) ||
+		sendAll(fd, line, (size_t)len) ||
+		recvLine(fd, line, sizeof(line)) ||
+		sscanf(line, "ok %zu", &size) != 1) {
+		close(fd);
+		return 1;
+	}
 
-	freeBranchList(&branchList);
+	struct textBuf out = {0};
+	out.data = malloc(size + 1);
+	out.cap = size + 1;
+	while (out.len < size) {
+		ssize_t n = recv(fd, out.data + out.len, size - out.len, 0);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		out.len += (size_t)n;
+	}
+	close(fd);
+	if (out.len != size) {
+		free(out.data);
+		return 1;
+	}
 
-	grid_destroy(skeleton);
-	grid_destroy(trunkPlane);
+	if (conf->message) {
+		textAppend(&out, conf->message, strlen(conf->message));
+		textAppend(&out, "\n", 1);
+	}
+	writeAll(STDOUT_FILENO, out.data, out.len);
+	free(out.data);
+	return 0;
 }
 
 
@@ -3165,64 +2674,70 @@ void growTree_v2(struct config *conf, struct ncursesObjects *objects, struct cou
 
 #define OPT_BARE 1001
 
-struct TreeEngine get_engine(int version) {
-	struct TreeEngine engine;
-	switch (version) {
-	case 1:
-		engine.growTree = growTree_v1;
-		break;
-	case 2:
-	default:
-		engine.growTree = growTree_v2;
-		break;
-	}
-	return engine;
-}
+#define OPT_BENCH 1002
 
-// print stdscr to terminal window
-void printstdscr(void) {
-	int maxY, maxX;
-	getmaxyx(stdscr, maxY, maxX);
+#define OPT_PROFILE 1003
 
-	// loop through each character on stdscr
-	for (int y = 0; y < maxY; y++) {
-		for (int x = 0; x < maxX; x++) {
-			// grab cchar_t from stdscr
-			cchar_t c;
-			mvwin_wch(stdscr, y, x, &c);
-
-			// grab wchar_t from cchar_t
-			wchar_t wch[128] = {0};
-			attr_t attrs;
-			short color_pair;
-			getcchar(&c, wch, &attrs, &color_pair, 0);
-
-			short fg;
-			short bg;
-			pair_content(color_pair, &fg, &bg);
-
-			// enable bold if needed
-			if(attrs & A_BOLD) printf("\033[1m");
-			else printf("\033[0m");
-
-			// enable correct color
-			if (fg == 0) printf("\033[0m");
-			else if (fg <= 7) printf("\033[3%him", fg);
-			else if (fg >= 8) printf("\033[9%him", fg - 8);
-
-			printf("%ls", wch);
-
-			short clen = wcslen(wch);
-			short cwidth = 0;
-			for (int i = 0; i < clen; ++i)
-				cwidth += wcwidth(wch[i]);
-
-			if (cwidth > 1)
-				x += cwidth - 1;
-		}
+#define OPT_CHECK 1004
+
+#define OPT_GOLDEN 1005
+
+#define OPT_STATE_TRACE 1006
+
+#define OPT_STATE_DIFF 1007
+
+#define OPT_HEADLESS 1008
+
+#define OPT_ALLOC_STATS 1009
+
+#define OPT_TRACE 1010
+
+#define OPT_STATS_FILE 1011
+
+#define OPT_METRICS 1012
+
+#define OPT_METRICS_INTERVAL 1013
+
+#define OPT_BATCH 1014
+
+#define OPT_BATCH_OUT 1015
+
+#define OPT_JOBS 1016
+
+#define OPT_PLAIN 1017
+
+#define OPT_NO_CACHE 1018
+
+#define OPT_SERVE 1019
+
+#define OPT_CLIENT 1020
+
+#define OPT_KEYFRAME_INTERVAL 1021
+
+#define OPT_KEYFRAME_COUNT 1022
+
+#define OPT_KEYFRAME_BUDGET 1023
+
+// delimit a comma-separated leaf list in place (strtok) and point
+// conf->leaves[] at each token. Returns the number of leaves kept.
+int parseLeaves(struct config *conf, char *list) {
+	int maxLeaves = (int)(sizeof(conf->leaves) / sizeof(conf->leaves[0]));
+	conf->leavesSize = 0;
+	char *token = strtok(list, ",");
+	while (token != NULL) {
+		if (conf->leavesSize < maxLeaves) conf->leaves[conf->leavesSize++] = token;
+		token = strtok(NULL, ",");
 	}
+	return conf->leavesSize;
+}
 
-	printf("\033[0m\n");
+// COLSxROWS -> cols, rows. Returns 0 on success.
+int parseSize(const char *arg, int *cols, int *rows) {
+	int c, r;
+	if (sscanf(arg, "%dx%d", &c, &r) != 2 || c < 1 || r < 1) return 1;
+	*cols = c;
+	*rows = r;
+	return 0;
 }
 
 char* createDefaultCachePath(void) {
@@ -3291,8 +2806,12 @@ int main(int argc, char* argv[]) {
 		.leaves = {0},
 		.saveFile = createDefaultCachePath(),
 		.loadFile = createDefaultCachePath(),
-		.no_disp = 0,
 		.hideLeaves = 0,
+		.cols = 80,
+		.rows = 24,
+		.keyframeInterval = 200,
+		.keyframeCount = 4,
+		.keyframeBudget = 1024L * 1024,
 	};
 
 	struct option long_options[] = {
@@ -3317,6 +2836,28 @@ int main(int argc, char* argv[]) {
 		{"name", required_argument, NULL, 'N'},
 		{"engine", required_argument, NULL, OPT_ENGINE},
 		{"bare", no_argument, NULL, OPT_BARE},
+		{"bench", optional_argument, NULL, OPT_BENCH},
+		{"profile", no_argument, NULL, OPT_PROFILE},
+		{"check", required_argument, NULL, OPT_CHECK},
+		{"golden", required_argument, NULL, OPT_GOLDEN},
+		{"state-trace", required_argument, NULL, OPT_STATE_TRACE},
+		{"state-diff", no_argument, NULL, OPT_STATE_DIFF},
+		{"headless", optional_argument, NULL, OPT_HEADLESS},
+		{"alloc-stats", no_argument, NULL, OPT_ALLOC_STATS},
+		{"trace", required_argument, NULL, OPT_TRACE},
+		{"stats-file", required_argument, NULL, OPT_STATS_FILE},
+		{"metrics", required_argument, NULL, OPT_METRICS},
+		{"metrics-interval", required_argument, NULL, OPT_METRICS_INTERVAL},
+		{"batch", required_argument, NULL, OPT_BATCH},
+		{"batch-out", required_argument, NULL, OPT_BATCH_OUT},
+		{"jobs", required_argument, NULL, OPT_JOBS},
+		{"plain", no_argument, NULL, OPT_PLAIN},
+		{"no-cache", no_argument, NULL, OPT_NO_CACHE},
+		{"serve", optional_argument, NULL, OPT_SERVE},
+		{"client", optional_argument, NULL, OPT_CLIENT},
+		{"keyframe-interval", required_argument, NULL, OPT_KEYFRAME_INTERVAL},
+		{"keyframe-count", required_argument, NULL, OPT_KEYFRAME_COUNT},
+		{"keyframe-budget", required_argument, NULL, OPT_KEYFRAME_BUDGET},
 		{0, 0, 0, 0}
 	};
 
@@ -3328,6 +2869,21 @@ int main(int argc, char* argv[]) {
 	int option_index = 0;
 	int c;
 	int real_save = 0;
+	int benchSeeds = 0;
+	char *checkFile = NULL;
+	int checkUpdate = 0;
+	int stateDiff = 0;
+	int headless = 0;
+	char *metricsFile = NULL;
+	int metricsInterval = 15;
+	char *batchSeeds = NULL;
+	char *batchOut = NULL;
+	int jobs = 0;
+	int plain = 0;
+	int noCache = 0;
+	int serve = 0;
+	int client = 0;
+	char *socketPath = NULL;
 	while ((c = getopt_long(argc, argv, ":lt:iw:Sm:b:c:M:L:ps:C:W:vhPN:T:", long_options, &option_index)) != -1) {
 		switch (c) {
 		case 'l':
@@ -3498,6 +3054,134 @@ int main(int argc, char* argv[]) {
 			conf.hideLeaves = 1;
 			break;
 
+		case OPT_BENCH:
+			benchSeeds = optarg ? atoi(optarg) : 3;
+			if (benchSeeds < 1) {
+				printf("error: invalid bench seed count: '%s'\n", optarg);
+				quit(&conf, &objects, 1);
+			}
+			break;
+
+		case OPT_CHECK:
+		case OPT_GOLDEN:
+			checkFile = optarg;
+			checkUpdate = (c == OPT_GOLDEN);
+			break;
+
+		case OPT_STATE_TRACE:
+			if (stateTrace) fclose(stateTrace);
+			stateTrace = fopen(optarg, "w");
+			if (!stateTrace) {
+				printf("error: could not open state trace: %s\n", optarg);
+				quit(&conf, &objects, 1);
+			}
+			break;
+
+		case OPT_TRACE:
+			if (traceOpen(optarg)) {
+				printf("error: could not open trace: %s\n", optarg);
+				quit(&conf, &objects, 1);
+			}
+			break;
+
+		case OPT_STATS_FILE:
+			if (statsInstall(optarg)) {
+				printf("error: could not install SIGUSR1 handler\n");
+				quit(&conf, &objects, 1);
+			}
+			break;
+
+		case OPT_METRICS:
+			metricsFile = optarg;
+			break;
+
+		case OPT_METRICS_INTERVAL:
+			metricsInterval = atoi(optarg);
+			if (metricsInterval < 1) {
+				printf("error: invalid metrics interval: '%s'\n", optarg);
+				quit(&conf, &objects, 1);
+			}
+			break;
+
+		case OPT_STATE_DIFF:
+			stateDiff = 1;
+			break;
+
+		case OPT_BATCH:
+			batchSeeds = optarg;
+			break;
+
+		case OPT_BATCH_OUT:
+			batchOut = optarg;
+			break;
+
+		case OPT_JOBS:
+			jobs = atoi(optarg);
+			if (jobs < 1) {
+				printf("error: invalid job count: '%s'\n", optarg);
+				quit(&conf, &objects, 1);
+			}
+			break;
+
+		case OPT_PLAIN:
+			plain = 1;
+			break;
+
+		case OPT_NO_CACHE:
+			noCache = 1;
+			break;
+
+		case OPT_KEYFRAME_INTERVAL:
+			conf.keyframeInterval = atoi(optarg);
+			if (conf.keyframeInterval < 0 || (conf.keyframeInterval == 0 && strcmp(optarg, "0"))) {
+				printf("error: invalid keyframe interval: '%s'\n", optarg);
+				quit(&conf, &objects, 1);
+			}
+			break;
+
+		case OPT_KEYFRAME_COUNT:
+			conf.keyframeCount = atoi(optarg);
+			if (conf.keyframeCount < 1 || conf.keyframeCount > 64) {
+				printf("error: invalid keyframe count (1-64): '%s'\n", optarg);
+				quit(&conf, &objects, 1);
+			}
+			break;
+
+		case OPT_KEYFRAME_BUDGET:
+			conf.keyframeBudget = atol(optarg) * 1024;
+			if (conf.keyframeBudget < 1) {
+				printf("error: invalid keyframe budget: '%s'\n", optarg);
+				quit(&conf, &objects, 1);
+			}
+			break;
+
+		case OPT_SERVE:
+		case OPT_CLIENT:
+			if (c == OPT_SERVE) serve = 1;
+			else client = 1;
+			if (optarg) {
+				free(socketPath);
+				socketPath = malloc(strlen(optarg) + 1);
+				strcpy(socketPath, optarg);
+			}
+			break;
+
+		case OPT_HEADLESS:
+			headless = 1;
+			if (optarg && parseSize(optarg, &conf.cols, &conf.rows)) {
+				printf("error: invalid headless size (want COLSxROWS): '%s'\n", optarg);
+				quit(&conf, &objects, 1);
+			}
+			break;
+
+		case OPT_ALLOC_STATS:
+			if (!allocStats) allocStats = calloc(1, sizeof(struct allocStats));
+			break;
+
+		case OPT_PROFILE:
+			if (!profiler) profiler = calloc(1, sizeof(struct profiler));
+			break;
+
 		// option has required argument, but it was not given
 		case ':':
 			switch (optopt) {
@@ -3530,46 +3214,140 @@ int main(int argc, char* argv[]) {
 	}
 
 	// delimit leaves on "," and add each token to the leaves[] list
-	char *token = strtok(leavesInput, ",");
-	while (token != NULL) {
-		if (conf.leavesSize < 100) conf.leaves[conf.leavesSize] = token;
-		token = strtok(NULL, ",");
-		conf.leavesSize++;
+	parseLeaves(&conf, leavesInput);
+
+	// headless tools: no save/load, no curses
+	if (stateDiff) {
+		if (argc - optind != 2) {
+			printf("error: --state-diff needs two trace files\n");
+			quit(&conf, &objects, 1);
+		}
+		quit(&conf, &objects, runStateDiff(argv[optind], argv[optind + 1]));
+	}
+	if (checkFile) {
+		int ret = runCheck(&conf, checkFile, checkUpdate);
+		quit(&conf, &objects, ret);
+	}
+	if (benchSeeds) {
+		int ret = runBench(&conf, benchSeeds);
+		quit(&conf, &objects, ret);
+	}
+	if (!socketPath && (serve || client))
+		socketPath = defaultSocketPath();
+	if (batchSeeds || serve) {
+		// the instrumentation globals are per process, not per tree
+		if (profiler || allocStats || stateTrace || eventTrace || runtimeStats || metricsFile) {
+			printf("error: --batch and --serve do not combine with --profile, --alloc-stats,\n"
+				   "       --trace, --state-trace, --stats-file or --metrics\n");
+			quit(&conf, &objects, 1);
+		}
+		if (jobs == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+			jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+			if (jobs < 1) jobs = 1;
+		}
+		conf.live = 0;	// nothing to watch
+		conf.load = 0;
+		conf.save = 0;
+		int ret = batchSeeds ? runBatch(&conf, batchSeeds, batchOut, jobs, plain)
+							 : runServe(&conf, socketPath, jobs);
+		free(socketPath);
+		quit(&conf, &objects, ret);
 	}
 
 	if (conf.load)
 		loadFromFile(&conf);
 
-	// seed random number generator
+	// a -p render is only worth caching when it can come up again: an
+	// explicit seed, no save file, and nothing observing the run
+	int useCache = !noCache && conf.seed != 0 && !conf.load && !conf.save &&
+		!profiler && !allocStats && !stateTrace && !eventTrace && !runtimeStats && !metricsFile;
+
+	// pick a seed; each engine seeds its own streams from it per tree
 	if (conf.seed == 0) conf.seed = time(NULL);
-	srand(conf.seed);
 
 	struct counters myCounters;
 
+	if (stateTrace)
+		fprintf(stateTrace, "# cbonsai state trace: v%d seed %d -M %d -L %d -b %d procedural %d live %d\n",
+				conf.version, conf.seed, conf.multiplier, conf.lifeStart, conf.baseType,
+				conf.proceduralMode, conf.live);
+	traceEvent('M', "process_name", "", 0, 0, "\"name\":\"cbonsai v%d seed %d -M %d -L %d\"",
+			   conf.version, conf.seed, conf.multiplier, conf.lifeStart);
+
+	// grow this one tree with no terminal: print its tick count and hash
+	if (conf.verbosity > 0)
+		hud = hudCreate();
+	if (metricsFile && metricsInstall(metricsFile, metricsInterval)) {
+		printf("error: could not start the metrics timer\n");
+		quit(&conf, &objects, 1);
+	}
+
+	if (headless) {
+		growHeadless(&conf, &myCounters);
+		printf("v%d seed %d: %llu ticks, %d peak branches, hash %016llx\n", conf.version,
+			   conf.seed, myCounters.globalTime, myCounters.peakBranches, myCounters.gridHash);
+		quit(&conf, &objects, 0);
+	}
+
 	if (conf.namedTree) {
 		if (!real_save) {
 			printf("error: named trees require specifying a save file with -W\n");
 			quit(&conf, &objects, 1);
 		}
 
-		// simulate actual time taken
+		// the tree's lifetime in ticks, on the real window's area, spread
+		// over the requested time
 		double targetSec = conf.secondsPerTick;
 
 		init(&conf, &objects);
-		conf.timeStep = 0;
-		conf.no_disp = 1;
-		get_engine(conf.version).growTree(&conf, &objects, &myCounters);
-		conf.no_disp = 0;
-
-		conf.secondsPerTick = targetSec / myCounters.globalTime;
+		getmaxyx(objects.treeWin, conf.rows, conf.cols);
+		FILE *trace = stateTrace, *events = eventTrace;	// only the real pass is traced
+		stateTrace = NULL;
+		eventTrace = NULL;
+		unsigned long long lifetime = treeLifetime(&conf, &myCounters);
+		stateTrace = trace;
+		eventTrace = events;
+
+		conf.secondsPerTick = targetSec / lifetime;
 		conf.timeStep = conf.secondsPerTick;
 		conf.creationTime = time(NULL);
-		srand(conf.seed);
+
+		// saved up front: a load derives the tree's progress from the
+		// clock, so with its keyframes the tree survives a crash
+		saveToFile(&conf, 0);
+	}
+
+	// -p: print the finished tree instead of holding it on screen, from
+	// the --serve daemon when there is one
+	if (conf.printTree && !conf.live && !conf.infinite) {
+		int ret = (client && !clientPrint(&conf, socketPath)) ? 0
+			: printTreeText(&conf, &myCounters, useCache);
+		free(socketPath);
+		quit(&conf, &objects, ret);
 	}
+	free(socketPath);
+	struct textBuf printed = {0};
+
+	struct cursesFrontend cursesState = {
+		.objects = &objects,
+		.printOut = (conf.printTree && !conf.infinite) ? &printed : NULL
+	};
+	const struct frontend curses = {
+		.ctx = &cursesState,
+		.begin = cursesBegin,
+		.step = cursesStep,
+		.finish = cursesFinish
+	};
 
 	do {
 		init(&conf, &objects);
-		get_engine(conf.version).growTree(&conf, &objects, &myCounters);
+		if (hud) hud->frameEndNs = 0;	// don't count the wait between trees as a tick
+		unsigned long long treeStart = statsStart();
+		if (growTree(&conf, &curses, &myCounters))
+			quit(&conf, &objects, 0);	// user quit mid-tree
+		statsTreeDone(&myCounters, treeStart);
 		if (conf.load) conf.targetGlobalTime = 0;
 		if (conf.infinite) {
 			timeout(conf.timeWait * 1000);
@@ -3579,11 +3357,13 @@ int main(int argc, char* argv[]) {
 			// key == 2 (resize): next iteration calls init() which rebuilds windows
 
 			conf.seed = time(NULL);
-			srand(conf.seed);
 		}
 	} while (conf.infinite);
 
 	finish(&conf, &myCounters);
+	if (printed.len)
+		writeAll(STDOUT_FILENO, printed.data, printed.len);
+	free(printed.data);
 
 	quit(&conf, &objects, 0);
-}
\ No newline at end of file
+}
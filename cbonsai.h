@@ -0,0 +1,617 @@
+// cbonsai.h: the headless tree engine (libcbonsai). No curses: engines grow
+// into VirtualGrid layers and reach a screen only through a struct frontend;
+// with no frontend they run headless on conf->cols x conf->rows.
+#ifndef CBONSAI_H
+#define CBONSAI_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "msaw.h"
+
+
+// ==========================================================================
+// CONSTANTS
+// ==========================================================================
+
+#define BRANCH_HISTORY 3 // moving average for proceedural leaves
+
+// engine-own cell attribute bits (VirtualGrid.attrs); a frontend maps them
+// to its own (the curses client: CB_BOLD -> A_BOLD)
+#define CB_BOLD 0x1
+
+// grid_create flags
+#define GRID_TRUNK 0x1   // keep v2 trunk-widening state per cell (the trunk plane)
+
+// grids are allocated in tiles of GRID_TILE_W x GRID_TILE_H cells
+#define GRID_TILE_XBITS 5
+
+#define GRID_TILE_YBITS 3
+
+#define GRID_TILE_W (1 << GRID_TILE_XBITS)
+
+#define GRID_TILE_H (1 << GRID_TILE_YBITS)
+
+// rectangles a tree's damage list holds before it starts merging them
+#define DAMAGE_RECTS 32
+
+
+// ==========================================================================
+// TYPES
+// ==========================================================================
+
+enum branchType {trunk, shootLeft, shootRight, dying, dead};
+
+struct config {
+	unsigned long long targetGlobalTime;
+	int live;
+	int infinite;
+	int screensaver;
+	int printTree;
+	int verbosity;
+	int lifeStart;
+	int multiplier;
+	int baseType;
+	int seed;
+	int leavesSize;
+	int version;
+	int save;
+	int load;
+
+	int proceduralMode;
+	int namedTree;           // Whether this is a named tree
+    time_t creationTime;     // When the tree was first created
+    double secondsPerTick;   // How many real seconds per simulation tick (-1 if not named)
+
+	int messageTimeout;  // seconds before message disappears
+	time_t messageStartTime;  // when the message was first displayed
+
+	double timeWait;
+	double timeStep;
+
+	char* message;
+	char* leaves[64];
+	char* saveFile;
+	char* loadFile;
+	int hideLeaves;          // --bare: suppress foliage rendering (v2 only)
+	int cols, rows;          // headless: virtual screen size when there is no tree window
+
+	int keyframeInterval;    // named trees: snapshot every this many ticks (0: never)
+	int keyframeCount;       // keyframe slots kept (FILE.kf0 ..)
+	long keyframeBudget;     // bytes all keyframes may use together
+};
+
+// Every distinct glyph a tree's grids hold, stored once; cells keep a 16-bit
+// id into it. One per tree, shared by all of its grids. Id 0 is "".
+struct glyphTable {
+	char (*glyph)[8];         // id -> NUL-terminated glyph (at most 7 bytes)
+	int count, capacity;
+	uint16_t *slot;           // open-addressed index of the ids, 2 * capacity
+};
+
+// v2 trunk widening state of one trunk-plane cell
+struct trunkCell {
+	uint8_t widenHalf;        // current rendered half-width
+	uint8_t widenTimer;       // ticks until the next widen step
+	uint8_t splitDepth;       // how many splits deep (forks thin out), capped at 255
+};
+
+// GRID_TILE_W x GRID_TILE_H cells as parallel arrays indexed
+// y * GRID_TILE_W + x: a glyph id, CB_* attrs and a colour pair per cell,
+// an occupancy word per row and, on a GRID_TRUNK grid only, widening state.
+struct gridTile {
+	uint32_t occupied[GRID_TILE_H];
+	uint16_t glyph[GRID_TILE_W * GRID_TILE_H];
+	uint8_t attrs[GRID_TILE_W * GRID_TILE_H];
+	uint8_t color[GRID_TILE_W * GRID_TILE_H];
+	struct trunkCell trunk[];
+};
+
+// occupied columns [lo, hi) of one grid row, grid-local; lo == hi: none
+struct gridRow {
+	int lo, hi;
+};
+
+// what a frontend must repaint: [x0, x1) x [y0, y1), tree coordinates
+struct damageRect {
+	int x0, y0, x1, y1;
+};
+
+// Where a tree's drawing changed since the frontend last took the damage
+// (damageReset), as a short list of rectangles; all: everything did. One
+// per tree, shared by the grids that report into it. A full list merges
+// the new rectangle into whichever existing one grows least.
+struct damage {
+	int all;
+	int count;
+	struct damageRect rect[DAMAGE_RECTS];
+};
+
+// One layer of cells, sparse: a tile is only allocated once something is
+// put in it, and tiles never move. Cells are addressed grid-locally,
+// (x - anchor_x, y - anchor_y); moving the anchor moves the whole layer.
+// The bounds (x0, y0, width, height, grid-local) only ever grow, by the
+// same steps the grid always grew by, and are what callers see as the
+// grid's extent (the ground line sits at its bottom); the tile directory
+// covers them. Alongside the occupancy bits each grid keeps the span of
+// occupied columns per row and the box around everything occupied, so
+// scans start and stop where the cells are (after grid_erase they may
+// over-cover; scans still check the bits).
+struct VirtualGrid {
+	struct glyphTable *glyphs;
+	struct gridTile **tiles;  // directory, row-major; NULL: nothing there yet
+	int tileX, tileY;         // tile coordinates of tiles[0]
+	int tilesW, tilesH;
+	struct gridRow *rows;     // one per directory row, tilesH * GRID_TILE_H
+	int occTop, occBottom;    // occupied rows [occTop, occBottom), grid-local
+	int occLeft, occRight;    // occupied columns; all four equal while empty
+	int flags;                // GRID_*
+	struct damage *damage;    // told about every change, or NULL
+	int x0, y0, width, height;
+	int anchor_x, anchor_y;
+	size_t bytesAllocated;   // bytes allocated over the grid's lifetime (directories + tiles)
+};
+
+// One leaf cell of one branch's live cluster in the canopy's pool. Index
+// 0 is never used, so 0 means "none" in every link.
+struct canopyEntry {
+	int x, y;                 // tree coordinates
+	uint32_t order;           // the owner's Branch.order
+	uint32_t below;           // next entry down the same cell's stack
+	uint32_t next;            // owner's next entry (free list: next free one)
+	uint16_t glyph;           // glyphTable id
+	uint8_t attrs, color;
+};
+
+// a cell leaves have been put on; top is 0 once it is bare again
+struct canopySlot {
+	int x, y;
+	uint32_t top;
+};
+
+// The live procedural leaves of every branch as one layer. Each cell keeps
+// a stack of the entries branches put there, highest Branch.order first,
+// and grid shows the top of every stack: what blitting one grid per branch
+// in list order used to show. Moving or dropping a branch's cluster only
+// restacks its own entries, uncovering whatever lay beneath.
+struct canopy {
+	struct VirtualGrid *grid;
+	struct canopyEntry *entry;        // pool
+	uint32_t entries, entryCapacity;  // entries: pool high-water mark
+	uint32_t freeList;                // chained through next
+	struct canopySlot *slot;          // open-addressed by (x, y); x == INT_MIN: unused
+	uint32_t slots, slotCapacity;
+};
+
+// cellEmitter context for one branch's live leaf walkers (canopyEmit)
+struct canopyOwner {
+	struct canopy *canopy;
+	struct Branch *branch;
+};
+
+// Row-major walk over a grid's occupied cells: only the occupied rows,
+// only the tiles within each row's span, a word of cells at a time:
+//     struct gridIter it;
+//     for (gridIterBegin(&it, g); gridIterNext(&it); )
+//         ... it.lx, it.ly (grid-local), it.tile->glyph[it.i] ...
+struct gridIter {
+	const struct VirtualGrid *g;
+	int tx, txEnd;            // tile column (tile coordinates) in this row's span
+	uint32_t bits;            // cells of this tile row not yet visited
+	struct gridTile *tile;
+	int lx, ly, i;            // the current cell
+};
+
+struct ColorResult {
+	unsigned int attrs;
+	short color_pair;
+};
+
+struct counters {
+	int trunks;
+	int branches;
+	int shoots;
+	int shootCounter;
+	int trunkSplitCooldown;
+	int shootSide;          // v2: current committed shoot flank (shootLeft/shootRight)
+	int shootRunRemaining;  // v2: shoots left on this flank before it flips
+	unsigned long long globalTime;
+
+	// instrumentation only (never read by growth): high-water marks for the
+	// bench harness
+	int peakBranches;       // largest branchList.count seen
+	int peakWalkers;        // most leaf walkers alive at once (live + burst)
+	size_t gridBytes;       // cell bytes allocated by every grid of this tree
+	unsigned long long gridHash;  // final skeleton + trunk plane (see grid_hash)
+};
+
+struct LeafWalker {
+	int x, y;
+	unsigned int seed;	// v1: rand_r stream
+	struct msaw rng;	// v2: per-walker msaw stream
+	int outward;		// v2: canopy-pad bias sign (-1 left, +1 right, 0 none)
+};
+
+struct Branch {
+	int x, y;                   // Current position
+	int dx, dy;                 // Current direction
+	int life;                   // Remaining life
+	int age;                    // Current age
+	enum branchType type;       // Branch type (trunk, shootLeft, etc)
+	int shootCooldown;          // Current shoot cooldown
+	int dripLeafCooldown;       // Current drip leaf cooldown
+	int totalLife;              // Initial life value
+	int multiplier;             // Stored multiplier
+	int lean;                   // v2: signed horizontal growth bias (committed side)
+	int splitDepth;             // v2: how many trunk splits deep this branch is
+	int shootGrace;             // v2: ticks after a split before this trunk shoots again
+	int deadwood;               // v2: jin/shari — currently bare bleached dead wood
+	int diebackLife;            // v2: life at/below which a destined fork dies back (0 = never)
+	unsigned int leaf_seed;		// for proceedural consistency (v1)
+	struct msaw leaf_rng;		// for proceedural consistency (v2)
+	int x_history[BRANCH_HISTORY];          // Circular buffer for last BRANCH_HISTORY x positions
+	int y_history[BRANCH_HISTORY];          // Circular buffer for last BRANCH_HISTORY y positions
+	int history_count;         // How many positions we've stored (max BRANCH_HISTORY)
+	int history_index;         // Current index in circular buffer
+
+	uint32_t order;             // creation order: a later branch's leaves draw on top
+	uint32_t leafCells;         // its live leaf cells in the tree's canopy, chained; 0: none
+	int leaf_steps_drawn;
+	int leaf_cur_x, leaf_cur_y;
+
+	struct LeafWalker *walkers;
+	int walker_count;
+	int walker_capacity;
+};
+
+// v1's random stream: glibc's random_r TYPE_3 (additive feedback, x^31 + x^3
+// + 1), reproduced so a v1 tree owns its rand() sequence instead of sharing
+// the process-global one. Plain data: copyable, no pointers into itself.
+struct v1rand {
+	int32_t state[31];
+	int f, r;                 // front/rear taps, 3 apart
+};
+
+struct BranchList {
+	struct Branch* branches;    // Dynamic array of branches
+	int count;                  // Current number of branches
+	int capacity;              // Current capacity of array
+	uint32_t nextOrder;        // Branch.order of the next branch added
+};
+
+// --profile: tick-loop phases timed separately, so a stutter can be pinned
+// on simulation (update .. leaves) or rendering (blit, present)
+enum profPhase {
+	PROF_UPDATE,      // updateBranch_v1/_v2
+	PROF_TRUNKPLANE,  // trunk plane record + pot rim span
+	PROF_WIDEN,       // advanceTrunkWiden (v2)
+	PROF_LEAVES,      // live procedural leaf walkers
+	PROF_BLIT,        // blitTree (incl. widenedTrunkCells)
+	PROF_PRESENT,     // update_panels + doupdate
+	PROF_PHASES
+};
+
+// log-linear latency histogram: four buckets per power of two of
+// nanoseconds (values below 4 ns get one bucket each), so percentiles are
+// within ~12% and recording is a few shifts
+#define PROF_BUCKETS 256
+
+struct phaseHist {
+	unsigned long long count;
+	unsigned long long totalNs;
+	unsigned long long maxNs;
+	unsigned long long buckets[PROF_BUCKETS];
+};
+
+struct profiler {
+	struct phaseHist phase[PROF_PHASES];
+};
+
+// --alloc-stats: heap traffic of the growth hot path, by the structure that
+// owns it
+enum allocSubsystem {
+	ALLOC_GRID,       // VirtualGrid headers + cell arrays (grid_create/grid_grow), canopy pool
+	ALLOC_BRANCHES,   // BranchList array (initBranchList/addBranch)
+	ALLOC_WALKERS,    // leaf walker arrays (live + burst)
+	ALLOC_STRINGS,    // per-step glyph buffers (chooseString/_v2)
+	ALLOC_SUBSYSTEMS
+};
+
+struct allocCounter {
+	unsigned long long allocs;      // malloc/calloc/realloc calls
+	unsigned long long frees;
+	unsigned long long totalBytes;  // bytes ever allocated
+	long long liveBytes;
+	long long peakBytes;
+};
+
+struct allocStats {
+	struct allocCounter sub[ALLOC_SUBSYSTEMS];
+	long long liveBytes, peakBytes;     // all subsystems together
+	unsigned long long ticks;
+	unsigned long long tickAllocs;      // allocations in the current tick
+	unsigned long long maxTickAllocs;
+};
+
+// --stats-file / --metrics: process-lifetime stats for screensaver and
+// named-tree instances that run for days. --stats-file appends a snapshot
+// on SIGUSR1; --metrics rewrites a Prometheus textfile on a SIGALRM timer.
+struct runtimeStats {
+	const char *path;               // --stats-file, or NULL
+	const char *metricsPath;        // --metrics, or NULL
+	int metricsInterval;            // seconds between metrics writes
+	time_t startTime;
+	unsigned long long startNs;
+	unsigned long long trees;       // trees finished
+	unsigned long long ticks;       // ticks of the finished trees
+	int peakBranches;               // largest branch list of any tree
+	struct phaseHist frame;         // blit + present of every live frame
+	struct phaseHist tree;          // wall time of every finished tree
+};
+
+// What a frontend sees of a growing tree: the layers to draw (tree
+// coordinates) and where the trunk stands. Only valid during a callback.
+struct treeView {
+	struct config *conf;
+	struct counters *counters;
+	struct VirtualGrid *skeleton;
+	struct VirtualGrid *trunkPlane;    // widened trunk layer, or NULL (v1)
+	struct BranchList *branchList;     // growing branches
+	const struct canopy *canopy;       // live procedural leaves: draw canopy->grid
+	struct damage *damage;             // changes since the frontend's last damageReset
+	int trunk_x, trunk_y, baseHeight;
+	int maxX, maxY;
+	int turn;                          // branch the engine steps next
+};
+
+// The engines' only way to reach a screen. growTree(conf, NULL, ...) grows
+// headless on a conf->cols x conf->rows area with no display at all.
+struct frontend {
+	void *ctx;
+	// a tree is starting: report the area it grows into
+	void (*begin)(void *ctx, struct config *conf, int *maxY, int *maxX);
+	// live mode, after each displayed tick; nonzero aborts the tree
+	int (*step)(void *ctx, const struct treeView *view);
+	// the tree is finished
+	void (*finish)(void *ctx, const struct treeView *view);
+};
+
+// receives one drawn cell (tree coordinates, CB_* attrs, colour pair)
+typedef void (*cellEmitter)(void *ctx, int x, int y, const char *ch, unsigned int attrs, short pair);
+
+/*
+ * Versioned tree generation. The version tag pins the growth algorithm:
+ * a saved tree must replay bit-identically under the engine it was created
+ * with, so each engine owns its full RNG-consuming call chain (growth
+ * deltas, branching decisions, colors, leaf glyphs, leaf walkers). Only
+ * RNG-free plumbing (grids, blitting, resize/input handling, the pot) is
+ * shared between engines.
+ *
+ * v1 is frozen: it draws the glibc rand() sequence seeded by conf->seed,
+ * from its own struct v1rand rather than the global srand()/rand() state
+ * and must never be modified. v2+ engines draw from explicit msaw streams.
+ */
+struct treeContext;
+
+struct TreeEngine {
+	void (*init)(struct treeContext *t);    // counters, streams, first trunk
+	int (*tick)(struct treeContext *t);     // one tick; 1 if a branch grew
+};
+
+// One growing tree, stepped from outside: treeCreate, treeStep(n) as often
+// as the host likes, treeRender to draw, treeDestroy. growTree is just the
+// loop over these; stepping by hand yields the same tick sequence.
+struct treeContext {
+	struct config *conf;
+	struct counters *counters;
+	struct TreeEngine engine;
+	struct v1rand v1rng;                              // v1 stream
+	struct msaw growth, cosmetic, widenRng, deadRng;  // v2 streams
+	struct glyphTable glyphs;          // shared by every grid below
+	struct damage damage;              // reported to by every grid below
+	struct VirtualGrid *skeleton;
+	struct VirtualGrid *trunkPlane;
+	struct canopy canopy;
+	struct BranchList branchList;
+	struct treeView view;              // trunk geometry + render layers
+	int rimLo, rimHi;                  // pot rim span hugging the trunk
+	int turn;                          // branch the next tick steps
+	int grew;                          // last tick advanced a branch
+	int done;                          // finished; gridHash is final
+};
+
+
+// ==========================================================================
+// ENGINE API
+// ==========================================================================
+
+// grid layers
+struct VirtualGrid* grid_create(struct glyphTable *glyphs, int w, int h, int ax, int ay, int flags);
+void grid_destroy(struct VirtualGrid *g);
+size_t grid_bytes(const struct VirtualGrid *g);
+int grid_bottom(const struct VirtualGrid *g);
+void grid_clear(struct VirtualGrid *g);
+void grid_grow(struct VirtualGrid *g, int lx, int ly);
+void grid_put(struct VirtualGrid *g, int tx, int ty, const char *str, unsigned int attrs, short cpair);
+void grid_erase(struct VirtualGrid *g, int tx, int ty);
+unsigned long long grid_hash(const struct VirtualGrid *g, unsigned long long h);
+void glyphTableFree(struct glyphTable *gt);
+void damageAdd(struct damage *d, int x0, int y0, int x1, int y1);
+void damageReset(struct damage *d);
+
+// canopy (live procedural leaves)
+void canopyPut(struct canopy *c, struct Branch *b, int x, int y, const char *str, unsigned int attrs, short cpair);
+void canopyMove(struct canopy *c, struct Branch *b, int dx, int dy);
+void canopyRemove(struct canopy *c, struct Branch *b);
+size_t canopyBytes(const struct canopy *c);
+void canopyFree(struct canopy *c);
+
+// base, pot and branch list
+int getBaseHeight(int baseType);
+void drawBaseToGrid(struct VirtualGrid *grid, int baseType, int trunk_x, int trunk_y);
+void drawPotRim(struct VirtualGrid *grid, int baseType, int trunk_x, int trunk_y,
+				int span_lo, int span_hi);
+void initBranchList(struct BranchList* list);
+void addBranch(struct BranchList* list, struct Branch branch, struct counters *myCounters);
+void removeBranch(struct BranchList* list, int index);
+void freeBranchList(struct BranchList* list);
+
+// engines
+void frontendBegin(const struct frontend *fe, struct config *conf, int *maxY, int *maxX);
+struct TreeEngine get_engine(int version);
+void growHeadless(struct config *conf, struct counters *myCounters);
+int growTree(struct config *conf, const struct frontend *fe, struct counters *myCounters);
+struct treeContext *treeCreate(struct config *conf, struct counters *myCounters, int maxX, int maxY);
+int treeStep(struct treeContext *t, int ticks);
+const struct treeView *treeRender(struct treeContext *t);
+int treeDone(const struct treeContext *t);
+unsigned long long treeLifetime(struct config *conf, struct counters *myCounters);
+void treeDestroy(struct treeContext *t);
+void widenedTrunkCells(const struct VirtualGrid *tp, cellEmitter emit, void *ctx);
+
+// engine snapshots
+int treeSnapshotWrite(const struct treeContext *t, FILE *fp);
+int treeSnapshotRead(struct treeContext *t, FILE *fp);
+
+// v1 / v2 building blocks
+void v1rand_seed(struct v1rand *st, unsigned int seed);
+int v1rand(struct v1rand *st);
+struct ColorResult chooseColorResult(enum branchType type, struct v1rand *rng);
+void setDeltas(enum branchType type, int life, int totalLife, int age, int multiplier, int *returnDx, int *returnDy,
+			   struct v1rand *rng);
+char* chooseString(const struct config *conf, enum branchType type, int life, int dx, int dy,
+				   struct v1rand *rng);
+void updateBranch_v1(struct config *conf, struct VirtualGrid *skeleton,
+				struct counters *myCounters, int branchIdx,
+				struct BranchList* list, struct v1rand *rng);
+int generateLeaves_v1(struct config *conf, struct VirtualGrid *grid, enum branchType type, int x, int y, int life, unsigned int leaf_seed, int groundY);
+struct ColorResult chooseColorResult_v2(enum branchType type, struct msaw *cosmetic);
+void setDeltas_v2(enum branchType type, int life, int totalLife, int age,
+				  int multiplier, int *returnDx, int *returnDy,
+				  int lean, struct msaw *growth);
+char* chooseString_v2(const struct config *conf, enum branchType type, int life,
+					  int dx, int dy, struct msaw *cosmetic);
+void updateBranch_v2(struct config *conf, struct VirtualGrid *skeleton,
+				struct counters *myCounters, int branchIdx,
+				struct BranchList* list,
+				struct msaw *growth, struct msaw *cosmetic, struct msaw *deadRng);
+int generateLeaves_v2(struct config *conf, struct VirtualGrid *grid, enum branchType type,
+					   int x, int y, int life, const struct msaw *leafRng, int groundY,
+					   int outward);
+
+
+// ==========================================================================
+// INSTRUMENTATION  (opt-in globals: NULL unless a frontend enables them)
+// ==========================================================================
+
+extern struct profiler *profiler;
+extern FILE *stateTrace;
+extern struct allocStats *allocStats;
+extern FILE *eventTrace;
+extern struct runtimeStats *runtimeStats;
+
+void profRecord(enum profPhase phase, unsigned long long ns);
+void hist_record(struct phaseHist *h, unsigned long long ns);
+unsigned long long hist_percentile(const struct phaseHist *h, double pct);
+void printProfile(FILE *out);
+void allocRecord(enum allocSubsystem sub, size_t oldBytes, size_t newBytes);
+void printAllocStats(FILE *out);
+void traceEvent(char ph, const char *name, const char *cat,
+				unsigned long long startNs, unsigned long long endNs, const char *argsFmt, ...);
+void traceTick(const struct counters *myCounters, const struct BranchList *list,
+			   unsigned long long tickStart);
+int traceOpen(const char *path);
+void traceClose(void);
+int statsInstall(const char *path);
+int metricsInstall(const char *path, int interval);
+void statsFrame(unsigned long long start);
+void statsTreeDone(const struct counters *myCounters, unsigned long long start);
+void metricsWrite(const struct counters *myCounters, const struct BranchList *list);
+void statsDump(const struct counters *myCounters, const struct BranchList *list);
+unsigned long long branch_hash(const struct Branch *b, const struct canopy *canopy);
+void traceState(const struct counters *myCounters, const struct BranchList *list,
+				const struct canopy *canopy, int turn,
+				const struct msaw *streams, int nstreams,
+				const struct VirtualGrid *skeleton, const struct VirtualGrid *trunkPlane);
+
+// the tile holding grid-local (lx, ly), or NULL if nothing was put there
+static inline struct gridTile *grid_tile(const struct VirtualGrid *g, int lx, int ly) {
+	int tx = (lx >> GRID_TILE_XBITS) - g->tileX, ty = (ly >> GRID_TILE_YBITS) - g->tileY;
+	if (tx < 0 || tx >= g->tilesW || ty < 0 || ty >= g->tilesH) return NULL;
+	return g->tiles[ty * g->tilesW + tx];
+}
+
+// the occupied span of grid-local row ly (empty outside the directory)
+static inline struct gridRow grid_row(const struct VirtualGrid *g, int ly) {
+	int r = ly - g->tileY * GRID_TILE_H;
+	if (r < 0 || r >= g->tilesH * GRID_TILE_H) return (struct gridRow){0, 0};
+	return g->rows[r];
+}
+
+// whether grid-local cell (lx, ly) holds anything (anywhere: outside the
+// bounds nothing does)
+static inline int grid_occupied(const struct VirtualGrid *g, int lx, int ly) {
+	const struct gridTile *t = grid_tile(g, lx, ly);
+	return t && ((t->occupied[ly & (GRID_TILE_H - 1)] >> (lx & (GRID_TILE_W - 1))) & 1);
+}
+
+// the glyph of cell i of one of g's tiles
+static inline const char *grid_glyph(const struct VirtualGrid *g, const struct gridTile *t, int i) {
+	return g->glyphs->glyph[t->glyph[i]];
+}
+
+static inline void gridIterBegin(struct gridIter *it, const struct VirtualGrid *g) {
+	*it = (struct gridIter){.g = g, .ly = g->occTop - 1};
+}
+
+// step to the next occupied cell; 0 when there are no more
+static inline int gridIterNext(struct gridIter *it) {
+	const struct VirtualGrid *g = it->g;
+	while (!it->bits) {
+		if (++it->tx >= it->txEnd) {
+			struct gridRow span;
+			do {
+				if (++it->ly >= g->occBottom) return 0;
+				span = grid_row(g, it->ly);
+			} while (span.lo == span.hi);
+			it->tx = span.lo >> GRID_TILE_XBITS;
+			it->txEnd = ((span.hi - 1) >> GRID_TILE_XBITS) + 1;
+		}
+		it->tile = g->tiles[((it->ly >> GRID_TILE_YBITS) - g->tileY) * g->tilesW + (it->tx - g->tileX)];
+		it->bits = it->tile ? it->tile->occupied[it->ly & (GRID_TILE_H - 1)] : 0;
+	}
+	int x = __builtin_ctz(it->bits);
+	it->bits &= it->bits - 1;
+	it->i = (it->ly & (GRID_TILE_H - 1)) * GRID_TILE_W + x;
+	it->lx = it->tx * GRID_TILE_W + x;
+	return 1;
+}
+
+static inline unsigned long long monotonicNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+// start a phase timing; 0 (and no clock read) when profiling is off
+static inline unsigned long long profStart(void) {
+	return profiler ? monotonicNs() : 0;
+}
+
+static inline unsigned long long profElapsed(unsigned long long start) {
+	return profiler ? monotonicNs() - start : 0;
+}
+
+// start time of a traced span, or 0 when --trace is off
+static inline unsigned long long traceStart(void) {
+	return eventTrace ? monotonicNs() : 0;
+}
+
+// start of a timed live frame, or 0 without --stats-file / --metrics
+static inline unsigned long long statsStart(void) {
+	return runtimeStats ? monotonicNs() : 0;
+}
+
+#endif
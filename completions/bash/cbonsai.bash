@@ -37,6 +37,29 @@ _cbonsai()
     '-s'
     '--seed'
     '--engine'
+    '--bare'
+    '--bench'
+    '--batch'
+    '--batch-out'
+    '--jobs'
+    '--plain'
+    '--no-cache'
+    '--serve'
+    '--client'
+    '--keyframe-interval'
+    '--keyframe-count'
+    '--keyframe-budget'
+    '--profile'
+    '--alloc-stats'
+    '--trace'
+    '--stats-file'
+    '--metrics'
+    '--metrics-interval'
+    '--check'
+    '--golden'
+    '--state-trace'
+    '--state-diff'
+    '--headless'
     '-W'
     '--save'
     '-C'
@@ -48,7 +71,7 @@ _cbonsai()
   )
 
   case "$prev" in
-    -[WC]|--save|--load)
+    -[WC]|--save|--load|--check|--golden|--state-trace|--state-diff|--trace|--stats-file|--metrics|--batch|--batch-out)
       COMPREPLY=($(compgen -f -- "$cur"))
       return
       ;;
@@ -0,0 +1,4042 @@
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+#include <limits.h>
+#include <wchar.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+
+#include "cbonsai.h"
+
+
+
+// ==========================================================================
+// TUNABLE PARAMETERS  (aesthetic / behaviour knobs — safe to retune)
+// ==========================================================================
+
+// 1-in-N chance that a trunk split spawns a bare deadwood fork
+#define DEADWOOD_CHANCE 8
+
+// v2 canopy pads: leaf walkers carry an outward sign and lean their drift away
+// from the trunk so foliage pools into clouds instead of a symmetric mush.
+// Neutral steps drift outward by BIAS; inward drift is capped at INWARD.
+#define LEAF_PAD_BIAS   1
+
+#define LEAF_PAD_INWARD 1
+
+// v2 lean: trunks and shoots carry a signed bias that pulls their wander
+// toward a committed side, so high multiplier produces bold structure (sweeps
+// and clean forks) instead of a symmetric radial explosion. Magnitude is
+// clamped to MAX so the pull (probability |lean|/LEAN_DENOM per step) stays
+// organic rather than a rigid diagonal.
+#define LEAN_MAX   4
+
+#define LEAN_DENOM 4
+
+// v2 crowding gate: a trunk won't split / a shoot won't sprout if another live
+// structural branch head is closer than this (Manhattan). Self-limiting — only
+// bites where heads are packed (high multiplier), so sparse low-M trees are
+// untouched. Trunks want more breathing room than shoots.
+#define SPLIT_MIN_DIST 10
+
+#define SHOOT_MIN_DIST 10
+
+// v2 shoot side-runs: shoots stay on one flank for a short run, then flip, so
+// foliage groups into alternating pads instead of a strict left/right comb.
+// Higher multiplier -> longer one-sided runs (bolder clusters).
+#define SHOOT_RUN_MDIV 6
+
+// v2: ceiling on shoot life, hence how far a shoot can run sideways. Shoot life
+// is derived from the trunk's remaining life, but a trunk's life is a HEIGHT
+// budget (see TRUNK_RISE_COST), so off a fresh high-life base the raw value is
+// huge and the shoot crawls clear across the screen. Cap it to the trunk's
+// height budget (totalLife / this) plus a little multiplier slack, so a shoot
+// never reaches much farther than the tree is tall. Lower -> shorter shoots.
+#define SHOOT_LIFE_CAP_DIV 3
+
+// v2: ticks after a trunk split during which no new shoots sprout, so a fork
+// gets a clean stretch before branching resumes
+#define SPLIT_SHOOT_GRACE 6
+
+// v2 trunk widening: thicken the centerline into a tapering body, widest at the
+// base. The per-cell taper uses distance ABOVE the base (which never moves), so
+// the shape is stable. Overall thickness is gated and grows with the tree:
+// nothing widens until the trunk is TRUNK_MIN_HEIGHT tall (small trees stay
+// slim), then the base half-width ramps up one step per TRUNK_GROW_DIV rows of
+// extra height, capped at TRUNK_MAX_HALF — so the trunk fattens as it matures.
+// The taper then drops the half-width by one every TRUNK_TAPER_DIV rows up.
+#define TRUNK_MAX_HALF    3
+
+// Columns either side of a trunk-plane cell whose widened body a change to
+// it can reach: a neighbour up to TRUNK_MAX_HALF + 1 away stops its flank
+// (anti-weld), and that neighbour's body spans TRUNK_MAX_HALF more; the rows
+// above and below follow it within 2 columns. One row either side.
+#define TRUNK_DAMAGE_HALO (2 * TRUNK_MAX_HALF + 2)
+
+#define TRUNK_TAPER_DIV   6
+
+#define TRUNK_MIN_HEIGHT  14
+
+#define TRUNK_GROW_DIV    12
+
+// v2: a trunk pays this much life per row it climbs (instead of per tick), so
+// its total height is ~ L / TRUNK_RISE_COST regardless of the multiplier — a
+// high-M trunk just spends more time wandering sideways between rises. Raise
+// it for shorter trees, lower for taller.
+#define TRUNK_RISE_COST   4
+
+
+// ==========================================================================
+// INTERNAL CONSTANTS  (not aesthetic knobs — changing these alters output / determinism)
+// ==========================================================================
+
+// v2+ engines draw growth and cosmetics from separate msaw streams so
+// cosmetic tweaks can never change a saved tree's structure; the cosmetic
+// stream is decorrelated from the growth stream by this salt
+#define MSAW_COSMETIC_SALT 0x9E3779B97F4A7C15ULL
+
+// salt for the trunk-widening animation stream (presentation only — never
+// touches growth/cosmetic, so widen timing can't change a saved tree)
+#define MSAW_WIDEN_SALT 0xD1B54A32D192ED03ULL
+
+// salt for the deadwood (jin/shari) decision stream. Kept off the growth
+// stream so trees that grow no dead limb stay byte-identical; a tree only
+// diverges where a dead fork actually appears.
+#define MSAW_DEADWOOD_SALT 0xBF58476D1CE4E5B9ULL
+
+// FNV-1a parameters for grid_hash and the state trace
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+
+#define FNV_PRIME  0x100000001b3ULL
+
+// glyph tables start with this many ids and double; ids are 16 bits, so a
+// table tops out at GLYPH_IDS - 1 glyphs (a tree uses a few dozen)
+#define GLYPH_TABLE_MIN 64
+
+#define GLYPH_IDS 65536
+
+// Fibonacci hashing multiplier for the glyph index
+#define GLYPH_HASH_MULT 0x9E3779B97F4A7C15ULL
+
+// canopy entry pools and slot tables start at this size and double
+#define CANOPY_POOL_MIN 256
+
+#define CANOPY_SLOTS_MIN 256
+
+// engine snapshot file format (treeSnapshotWrite): bump on any change to
+// the layout or to the state it must capture
+#define SNAPSHOT_MAGIC "CBSNAP\0\0"
+
+#define SNAPSHOT_VERSION 4
+
+// snapshotPath slots besides the keyframes (0 ..): FILE.snap, the state
+// at the last save, and FILE.end, the finished tree from calibration
+#define SNAPSHOT_SAVE -1
+
+#define SNAPSHOT_END -2
+
+// Prometheus histogram buckets are the powers of two of nanoseconds in
+// [2^LO, 2^HI], which fall exactly on phaseHist bucket edges
+#define METRICS_FRAME_LO 14   // ~16 us
+
+#define METRICS_FRAME_HI 30   // ~1.1 s
+
+#define METRICS_TREE_LO  24   // ~17 ms
+
+#define METRICS_TREE_HI  40   // ~18 min
+
+
+// ==========================================================================
+// FORWARD DECLARATIONS  (file-local helpers)
+// ==========================================================================
+
+// grid, base and branch list
+static size_t gridTileSize(int flags);
+static void gridCoverBounds(struct VirtualGrid *g);
+static struct gridTile *gridTileAt(struct VirtualGrid *g, int lx, int ly);
+static inline int gridCellIndex(int lx, int ly);
+static void gridMark(struct VirtualGrid *g, struct gridTile *t, int lx, int ly);
+static int grid_next(const struct VirtualGrid *g, int lx, int ly);
+static size_t glyphTableBytes(int capacity);
+static uint16_t *glyphSlot(struct glyphTable *gt, const char key[8]);
+static void glyphTableGrow(struct glyphTable *gt);
+static uint16_t glyph_intern(struct glyphTable *gt, const char *str);
+static struct trunkCell *grid_trunk(const struct VirtualGrid *g, int lx, int ly);
+static void gridDamage(const struct VirtualGrid *g, int lx0, int ly0, int lx1, int ly1);
+static void gridPutId(struct VirtualGrid *g, int tx, int ty, uint16_t glyph, unsigned int attrs, short cpair);
+static long long damageArea(const struct damageRect *r);
+static struct damageRect damageUnion(const struct damageRect *a, const struct damageRect *b);
+static void canopyRehash(struct canopy *c);
+static struct canopySlot *canopySlot(struct canopy *c, int x, int y);
+static uint32_t canopyAlloc(struct canopy *c);
+static void canopyShow(struct canopy *c, const struct canopySlot *slot);
+static void canopyLink(struct canopy *c, uint32_t e);
+static void canopyUnlink(struct canopy *c, uint32_t e);
+static void gridEmit(void *ctx, int x, int y, const char *ch, unsigned int attrs, short pair);
+static void canopyEmit(void *ctx, int x, int y, const char *ch, unsigned int attrs, short pair);
+static inline unsigned long long fnv_byte(unsigned long long h, unsigned char b);
+static inline unsigned long long fnv_u32(unsigned long long h, unsigned int v);
+static inline unsigned long long fnv_u64(unsigned long long h, unsigned long long v);
+static void grid_put_str(struct VirtualGrid *g, int tx, int ty, const char *str, unsigned int attrs, short cpair);
+static inline int mrand(struct msaw *st, int mod);
+static inline void update_position_history(struct Branch* branch);
+static inline void get_average_position(struct Branch* branch, int* avg_x, int* avg_y);
+static inline int isEarlyTrunk(int age, int totalLife);
+static inline int isYoungTrunk(int age, int totalLife);
+static inline int getBranchRollThreshold(int age, int totalLife, int multiplier);
+
+// instrumentation
+static inline void allocNote(enum allocSubsystem sub, size_t oldBytes, size_t newBytes);
+static inline void allocTick(void);
+static inline void traceSpawn(const char *kind, const struct Branch *b, const struct BranchList *list);
+static void onStatsSignal(int sig);
+static void onMetricsTimer(int sig);
+static struct runtimeStats *statsCreate(void);
+static void metricsHistogram(FILE *out, const char *name, const char *help,
+							 const struct phaseHist *h, int lo, int hi);
+static inline void statsPoll(const struct counters *myCounters, const struct BranchList *list);
+
+// v1 engine (frozen)
+static inline void roll(int *dice, int mod, struct v1rand *rng);
+static void leafStepWalkers(struct config *conf, cellEmitter emit, void *ctx,
+							enum branchType type, int groundY,
+							struct LeafWalker **walkers, int *count, int *capacity);
+static void treeInit_v1(struct treeContext *t);
+static int treeTick_v1(struct treeContext *t);
+
+// v2 engine
+static int applyLean(struct msaw *growth, int dx, int lean, int lo, int hi);
+static int structuralCrowded(const struct BranchList *list, int x, int y,
+							 int exceptIdx, int minDist);
+static void leafStep_v2(struct config *conf, cellEmitter emit, void *ctx,
+						enum branchType type, int groundY,
+						struct LeafWalker **walkers, int *count, int *capacity);
+static void advanceTrunkWiden(struct VirtualGrid *tp, int trunk_y, struct msaw *rng);
+static void treeInit_v2(struct treeContext *t);
+static int treeTick_v2(struct treeContext *t);
+
+// engine snapshots
+static void snapPut(FILE *fp, unsigned long long *sum, uint64_t v, int bytes);
+static uint64_t snapGet(FILE *fp, unsigned long long *sum, int bytes);
+static void snapPutMsaw(FILE *fp, unsigned long long *sum, const struct msaw *st);
+static void snapGetMsaw(FILE *fp, unsigned long long *sum, struct msaw *st);
+static void snapPutGrid(FILE *fp, unsigned long long *sum, const struct VirtualGrid *g);
+static struct VirtualGrid *snapGetGrid(FILE *fp, unsigned long long *sum, struct glyphTable *glyphs);
+static void snapPutLeaves(FILE *fp, unsigned long long *sum, const struct canopy *c, const struct Branch *b);
+static int snapGetLeaves(FILE *fp, unsigned long long *sum, struct canopy *c, struct Branch *b);
+static unsigned long long snapLeavesHash(const struct config *conf);
+static char *snapshotPath(const char *file, int slot);
+static int snapshotWriteFile(const struct treeContext *t, const char *path);
+static void snapshotSave(const struct treeContext *t);
+static void keyframeSave(const struct treeContext *t);
+static struct treeContext *snapshotResume(struct treeContext *t);
+
+
+// ==========================================================================
+// COMMON / SHARED  (grid, base & pot, branch list)
+// ==========================================================================
+
+// Bytes of one tile of a grid created with flags
+static size_t gridTileSize(int flags) {
+	return sizeof(struct gridTile) +
+		   ((flags & GRID_TRUNK) ? sizeof(struct trunkCell) * GRID_TILE_W * GRID_TILE_H : 0);
+}
+
+// Resize the tile directory to cover the (grown) bounds. Only the tile
+// pointers are carried over: no cell moves. The bounds must still hold
+// every allocated tile.
+static void gridCoverBounds(struct VirtualGrid *g) {
+	int tx0 = g->x0 >> GRID_TILE_XBITS, tx1 = (g->x0 + g->width - 1) >> GRID_TILE_XBITS;
+	int ty0 = g->y0 >> GRID_TILE_YBITS, ty1 = (g->y0 + g->height - 1) >> GRID_TILE_YBITS;
+	int w = tx1 - tx0 + 1, h = ty1 - ty0 + 1;
+	if (g->tiles && tx0 == g->tileX && ty0 == g->tileY && w == g->tilesW && h == g->tilesH)
+		return;
+
+	struct gridTile **tiles = calloc((size_t)w * (size_t)h, sizeof(*tiles));
+	struct gridRow *rows = calloc((size_t)h * GRID_TILE_H, sizeof(*rows));
+	for (int ty = 0; ty < g->tilesH; ty++)
+		for (int tx = 0; tx < g->tilesW; tx++)
+			if (g->tiles[ty * g->tilesW + tx])
+				tiles[(ty + g->tileY - ty0) * w + (tx + g->tileX - tx0)] = g->tiles[ty * g->tilesW + tx];
+	for (int r = 0; r < g->tilesH * GRID_TILE_H; r++)
+		if (g->rows[r].lo != g->rows[r].hi)
+			rows[r + (g->tileY - ty0) * GRID_TILE_H] = g->rows[r];
+	size_t oldBytes = (sizeof(*tiles) + sizeof(*rows) * GRID_TILE_H) * (size_t)g->tilesW * (size_t)g->tilesH;
+	size_t newBytes = sizeof(*tiles) * (size_t)w * (size_t)h + sizeof(*rows) * GRID_TILE_H * (size_t)h;
+	allocNote(ALLOC_GRID, oldBytes, newBytes);
+	g->bytesAllocated += newBytes;
+	free(g->tiles);
+	free(g->rows);
+	g->tiles = tiles;
+	g->rows = rows;
+	g->tileX = tx0;
+	g->tileY = ty0;
+	g->tilesW = w;
+	g->tilesH = h;
+}
+
+// The tile holding grid-local (lx, ly), which must be within the bounds;
+// allocated on first use
+static struct gridTile *gridTileAt(struct VirtualGrid *g, int lx, int ly) {
+	struct gridTile **slot = &g->tiles[((ly >> GRID_TILE_YBITS) - g->tileY) * g->tilesW +
+									   ((lx >> GRID_TILE_XBITS) - g->tileX)];
+	if (!*slot) {
+		size_t bytes = gridTileSize(g->flags);
+		*slot = calloc(1, bytes);
+		allocNote(ALLOC_GRID, 0, bytes);
+		g->bytesAllocated += bytes;
+	}
+	return *slot;
+}
+
+// Index of grid-local (lx, ly) within its tile
+static inline int gridCellIndex(int lx, int ly) {
+	return (ly & (GRID_TILE_H - 1)) * GRID_TILE_W + (lx & (GRID_TILE_W - 1));
+}
+
+// Mark (lx, ly), in tile t, occupied: its bit, its row's span and the box
+static void gridMark(struct VirtualGrid *g, struct gridTile *t, int lx, int ly) {
+	t->occupied[ly & (GRID_TILE_H - 1)] |= 1U << (lx & (GRID_TILE_W - 1));
+	struct gridRow *row = &g->rows[ly - g->tileY * GRID_TILE_H];
+	if (row->lo == row->hi) {
+		row->lo = lx;
+		row->hi = lx + 1;
+	} else {
+		if (lx < row->lo) row->lo = lx;
+		if (lx >= row->hi) row->hi = lx + 1;
+	}
+	if (g->occLeft == g->occRight) {
+		g->occLeft = lx;
+		g->occRight = lx + 1;
+		g->occTop = ly;
+		g->occBottom = ly + 1;
+		return;
+	}
+	if (lx < g->occLeft) g->occLeft = lx;
+	if (lx >= g->occRight) g->occRight = lx + 1;
+	if (ly < g->occTop) g->occTop = ly;
+	if (ly >= g->occBottom) g->occBottom = ly + 1;
+}
+
+// The first occupied grid-local x >= lx in row ly, or the end of the
+// row's occupied span if none: a tile's row at a time, so empty tiles cost
+// one step, and nothing outside the span is looked at.
+static int grid_next(const struct VirtualGrid *g, int lx, int ly) {
+	struct gridRow span = grid_row(g, ly);
+	int end = span.hi;
+	if (lx < span.lo) lx = span.lo;
+	while (lx < end) {
+		const struct gridTile *t = grid_tile(g, lx, ly);
+		if (t) {
+			uint32_t m = t->occupied[ly & (GRID_TILE_H - 1)] & (~0U << (lx & (GRID_TILE_W - 1)));
+			if (m) return (lx & ~(GRID_TILE_W - 1)) + __builtin_ctz(m);
+		}
+		lx = (lx | (GRID_TILE_W - 1)) + 1;
+	}
+	return end;
+}
+
+// Report grid-local [lx0, lx1) x [ly0, ly1) changed; on the trunk plane
+// also every cell whose widened body it may have moved
+static void gridDamage(const struct VirtualGrid *g, int lx0, int ly0, int lx1, int ly1) {
+	if (!g->damage || lx0 >= lx1) return;
+	int hx = 0, hy = 0;
+	if (g->flags & GRID_TRUNK) {
+		hx = TRUNK_DAMAGE_HALO;
+		hy = 1;
+	}
+	damageAdd(g->damage, g->anchor_x + lx0 - hx, g->anchor_y + ly0 - hy,
+			  g->anchor_x + lx1 + hx, g->anchor_y + ly1 + hy);
+}
+
+struct VirtualGrid* grid_create(struct glyphTable *glyphs, int w, int h, int ax, int ay, int flags) {
+	struct VirtualGrid *g = calloc(1, sizeof(struct VirtualGrid));
+	g->glyphs = glyphs;
+	g->flags = flags;
+	g->width = w;
+	g->height = h;
+	g->anchor_x = ax;
+	g->anchor_y = ay;
+	allocNote(ALLOC_GRID, 0, sizeof(struct VirtualGrid));
+	gridCoverBounds(g);
+	return g;
+}
+
+void grid_destroy(struct VirtualGrid *g) {
+	if (!g) return;
+	grid_clear(g);
+	allocNote(ALLOC_GRID, sizeof(struct VirtualGrid) +
+			  (sizeof(*g->tiles) + sizeof(*g->rows) * GRID_TILE_H) * (size_t)g->tilesW * (size_t)g->tilesH, 0);
+	free(g->tiles);
+	free(g->rows);
+	free(g);
+}
+
+// Bytes the grid's directory, row spans and tiles take right now
+size_t grid_bytes(const struct VirtualGrid *g) {
+	size_t bytes = sizeof(*g->tiles) * (size_t)g->tilesW * (size_t)g->tilesH +
+				   sizeof(*g->rows) * GRID_TILE_H * (size_t)g->tilesH;
+	for (int i = 0; i < g->tilesW * g->tilesH; i++)
+		if (g->tiles[i]) bytes += gridTileSize(g->flags);
+	return bytes;
+}
+
+// Absolute y just below the grid's bounds
+int grid_bottom(const struct VirtualGrid *g) {
+	return g->anchor_y + g->y0 + g->height;
+}
+
+// Empty the grid, releasing its tiles; the bounds stay
+void grid_clear(struct VirtualGrid *g) {
+	for (int i = 0; i < g->tilesW * g->tilesH; i++) {
+		if (!g->tiles[i]) continue;
+		allocNote(ALLOC_GRID, gridTileSize(g->flags), 0);
+		free(g->tiles[i]);
+		g->tiles[i] = NULL;
+	}
+	gridDamage(g, g->occLeft, g->occTop, g->occRight, g->occBottom);
+	memset(g->rows, 0, sizeof(*g->rows) * GRID_TILE_H * (size_t)g->tilesH);
+	g->occTop = g->occBottom = g->occLeft = g->occRight = 0;
+}
+
+// Extend the bounds to take grid-local (lx, ly), by half the current
+// extent or as much as needed. Only the tile directory is resized.
+void grid_grow(struct VirtualGrid *g, int lx, int ly) {
+	unsigned long long growStart = traceStart();
+	int bx = lx - g->x0, by = ly - g->y0;
+	int new_w = g->width;
+	int new_h = g->height;
+	int sx = 0, sy = 0;
+
+	if (bx < 0) {
+		int need = -bx;
+		int grow = (int)(g->width * 0.5);
+		if (grow < need) grow = need;
+		new_w += grow;
+		sx = grow;
+	} else if (bx >= g->width) {
+		int need = bx - g->width + 1;
+		int grow = (int)(g->width * 0.5);
+		if (grow < need) grow = need;
+		new_w += grow;
+	}
+
+	if (by < 0) {
+		int need = -by;
+		int grow = (int)(g->height * 0.5);
+		if (grow < need) grow = need;
+		new_h += grow;
+		sy = grow;
+	} else if (by >= g->height) {
+		int need = by - g->height + 1;
+		int grow = (int)(g->height * 0.5);
+		if (grow < need) grow = need;
+		new_h += grow;
+	}
+
+	int old_w = g->width, old_h = g->height;
+	size_t before = g->bytesAllocated;
+	g->x0 -= sx;
+	g->y0 -= sy;
+	g->width = new_w;
+	g->height = new_h;
+	gridCoverBounds(g);
+	traceEvent('X', "grid_grow", "grid", growStart, traceStart(),
+			   "\"from\":\"%dx%d\",\"to\":\"%dx%d\",\"bytes\":%zu",
+			   old_w, old_h, new_w, new_h, g->bytesAllocated - before);
+}
+
+static void gridPutId(struct VirtualGrid *g, int tx, int ty, uint16_t glyph, unsigned int attrs, short cpair) {
+	int lx = tx - g->anchor_x;
+	int ly = ty - g->anchor_y;
+	if (lx < g->x0 || lx >= g->x0 + g->width || ly < g->y0 || ly >= g->y0 + g->height)
+		grid_grow(g, lx, ly);
+	struct gridTile *t = gridTileAt(g, lx, ly);
+	int i = gridCellIndex(lx, ly);
+	t->glyph[i] = glyph;
+	t->attrs[i] = (uint8_t)attrs;
+	t->color[i] = (uint8_t)cpair;
+	gridMark(g, t, lx, ly);
+	gridDamage(g, lx, ly, lx + 1, ly + 1);
+}
+
+void grid_put(struct VirtualGrid *g, int tx, int ty, const char *str, unsigned int attrs, short cpair) {
+	gridPutId(g, tx, ty, glyph_intern(g->glyphs, str), attrs, cpair);
+}
+
+// Empty cell (tx, ty). Its row span and the occupied box stay as they were.
+void grid_erase(struct VirtualGrid *g, int tx, int ty) {
+	int lx = tx - g->anchor_x, ly = ty - g->anchor_y;
+	struct gridTile *t = grid_tile(g, lx, ly);
+	if (!t) return;
+	t->occupied[ly & (GRID_TILE_H - 1)] &= ~(1U << (lx & (GRID_TILE_W - 1)));
+	gridDamage(g, lx, ly, lx + 1, ly + 1);
+}
+
+// The widening state of trunk-plane cell (lx, ly), grid-local, or NULL if
+// nothing was put near it.
+static struct trunkCell *grid_trunk(const struct VirtualGrid *g, int lx, int ly) {
+	struct gridTile *t = grid_tile(g, lx, ly);
+	return t ? &t->trunk[gridCellIndex(lx, ly)] : NULL;
+}
+
+static size_t glyphTableBytes(int capacity) {
+	return (size_t)capacity * (8 + 2 * sizeof(uint16_t));
+}
+
+// The index slot holding key's id, or the free slot where it belongs.
+// The index is at most half full, so the probe always ends.
+static uint16_t *glyphSlot(struct glyphTable *gt, const char key[8]) {
+	uint64_t k;
+	memcpy(&k, key, sizeof(k));
+	unsigned int mask = (unsigned int)gt->capacity * 2 - 1;
+	for (unsigned int s = (unsigned int)((k * GLYPH_HASH_MULT) >> 40) & mask;; s = (s + 1) & mask) {
+		uint16_t *slot = &gt->slot[s];
+		if (!*slot || !memcmp(gt->glyph[*slot], key, 8)) return slot;
+	}
+}
+
+// Double the table (first call: create it with id 0 = ""), reindexing
+static void glyphTableGrow(struct glyphTable *gt) {
+	int capacity = gt->capacity ? gt->capacity * 2 : GLYPH_TABLE_MIN;
+	allocNote(ALLOC_GRID, glyphTableBytes(gt->capacity), glyphTableBytes(capacity));
+	gt->glyph = realloc(gt->glyph, sizeof(*gt->glyph) * (size_t)capacity);
+	free(gt->slot);
+	gt->slot = calloc((size_t)capacity * 2, sizeof(uint16_t));
+	gt->capacity = capacity;
+	if (!gt->count) {
+		memset(gt->glyph[0], 0, sizeof(gt->glyph[0]));
+		gt->count = 1;
+	}
+	for (int id = 1; id < gt->count; id++)
+		*glyphSlot(gt, gt->glyph[id]) = (uint16_t)id;
+}
+
+// The id of str (truncated to 7 bytes, as a cell always stored it), added
+// on first sight
+static uint16_t glyph_intern(struct glyphTable *gt, const char *str) {
+	char key[8] = {0};
+	strncpy(key, str, sizeof(key) - 1);
+	if (!gt->capacity) glyphTableGrow(gt);
+	if (!key[0]) return 0;
+
+	uint16_t *slot = glyphSlot(gt, key);
+	if (*slot) return *slot;
+	if (gt->count == gt->capacity) {
+		if (gt->capacity == GLYPH_IDS) return 0;   // out of ids: draw nothing
+		glyphTableGrow(gt);
+		slot = glyphSlot(gt, key);
+	}
+	memcpy(gt->glyph[gt->count], key, sizeof(key));
+	*slot = (uint16_t)gt->count;
+	return (uint16_t)gt->count++;
+}
+
+void glyphTableFree(struct glyphTable *gt) {
+	allocNote(ALLOC_GRID, glyphTableBytes(gt->capacity), 0);
+	free(gt->glyph);
+	free(gt->slot);
+	*gt = (struct glyphTable){0};
+}
+
+static long long damageArea(const struct damageRect *r) {
+	return (long long)(r->x1 - r->x0) * (r->y1 - r->y0);
+}
+
+static struct damageRect damageUnion(const struct damageRect *a, const struct damageRect *b) {
+	return (struct damageRect){
+		a->x0 < b->x0 ? a->x0 : b->x0, a->y0 < b->y0 ? a->y0 : b->y0,
+		a->x1 > b->x1 ? a->x1 : b->x1, a->y1 > b->y1 ? a->y1 : b->y1
+	};
+}
+
+// Add [x0, x1) x [y0, y1), tree coordinates. A rectangle that overlaps or
+// abuts one already listed without wasting cells (a run of puts along a
+// row) joins it; once the list is full, every new one joins the rectangle
+// it grows least.
+void damageAdd(struct damage *d, int x0, int y0, int x1, int y1) {
+	if (d->all || x0 >= x1 || y0 >= y1) return;
+	struct damageRect r = {x0, y0, x1, y1};
+	int best = -1;
+	long long bestGrowth = 0;
+	for (int i = 0; i < d->count; i++) {
+		struct damageRect u = damageUnion(&d->rect[i], &r);
+		long long growth = damageArea(&u) - damageArea(&d->rect[i]);
+		if (growth <= damageArea(&r)) {
+			d->rect[i] = u;
+			return;
+		}
+		if (best < 0 || growth < bestGrowth) {
+			best = i;
+			bestGrowth = growth;
+		}
+	}
+	if (d->count < DAMAGE_RECTS) d->rect[d->count++] = r;
+	else d->rect[best] = damageUnion(&d->rect[best], &r);
+}
+
+// The frontend has repainted everything it was told about
+void damageReset(struct damage *d) {
+	d->all = 0;
+	d->count = 0;
+}
+
+// Rebuild the slot table, dropping bare cells, with room for twice the rest
+static void canopyRehash(struct canopy *c) {
+	uint32_t live = 0;
+	for (uint32_t s = 0; s < c->slotCapacity; s++)
+		if (c->slot[s].x != INT_MIN && c->slot[s].top) live++;
+	uint32_t capacity = CANOPY_SLOTS_MIN;
+	while (capacity < live * 4) capacity *= 2;
+
+	struct canopySlot *old = c->slot;
+	uint32_t oldCapacity = c->slotCapacity;
+	allocNote(ALLOC_GRID, sizeof(*old) * (size_t)oldCapacity, sizeof(*old) * (size_t)capacity);
+	c->slot = malloc(sizeof(*c->slot) * (size_t)capacity);
+	for (uint32_t s = 0; s < capacity; s++)
+		c->slot[s].x = INT_MIN;
+	c->slotCapacity = capacity;
+	c->slots = 0;
+	for (uint32_t s = 0; s < oldCapacity; s++) {
+		if (old[s].x != INT_MIN && old[s].top)
+			canopySlot(c, old[s].x, old[s].y)->top = old[s].top;
+	}
+	free(old);
+}
+
+// The slot of cell (x, y), added (bare) if leaves were never put there.
+// The table is at most half full, so the probe always ends.
+static struct canopySlot *canopySlot(struct canopy *c, int x, int y) {
+	if (c->slots * 2 >= c->slotCapacity) canopyRehash(c);
+	uint64_t k = ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+	uint32_t mask = c->slotCapacity - 1;
+	for (uint32_t s = (uint32_t)((k * GLYPH_HASH_MULT) >> 40) & mask;; s = (s + 1) & mask) {
+		struct canopySlot *slot = &c->slot[s];
+		if (slot->x == x && slot->y == y) return slot;
+		if (slot->x == INT_MIN) {
+			*slot = (struct canopySlot){.x = x, .y = y, .top = 0};
+			c->slots++;
+			return slot;
+		}
+	}
+}
+
+// A free pool entry: a recycled one, or a new one past the high-water mark
+static uint32_t canopyAlloc(struct canopy *c) {
+	if (c->freeList) {
+		uint32_t e = c->freeList;
+		c->freeList = c->entry[e].next;
+		return e;
+	}
+	if (c->entries + 1 >= c->entryCapacity) {
+		uint32_t capacity = c->entryCapacity ? c->entryCapacity * 2 : CANOPY_POOL_MIN;
+		allocNote(ALLOC_GRID, sizeof(*c->entry) * (size_t)c->entryCapacity, sizeof(*c->entry) * (size_t)capacity);
+		c->entry = realloc(c->entry, sizeof(*c->entry) * (size_t)capacity);
+		c->entryCapacity = capacity;
+	}
+	return ++c->entries;
+}
+
+// Make the grid show slot's top entry, or nothing
+static void canopyShow(struct canopy *c, const struct canopySlot *slot) {
+	if (slot->top) {
+		const struct canopyEntry *en = &c->entry[slot->top];
+		gridPutId(c->grid, slot->x, slot->y, en->glyph, en->attrs, en->color);
+	} else {
+		grid_erase(c->grid, slot->x, slot->y);
+	}
+}
+
+// Stack entry e on its cell, under the entries of every later branch
+static void canopyLink(struct canopy *c, uint32_t e) {
+	struct canopyEntry *en = &c->entry[e];
+	struct canopySlot *slot = canopySlot(c, en->x, en->y);
+	uint32_t *link = &slot->top;
+	while (*link && c->entry[*link].order > en->order) link = &c->entry[*link].below;
+	en->below = *link;
+	*link = e;
+	if (slot->top == e) canopyShow(c, slot);
+}
+
+// Take entry e off its cell's stack, uncovering the one below it
+static void canopyUnlink(struct canopy *c, uint32_t e) {
+	struct canopyEntry *en = &c->entry[e];
+	struct canopySlot *slot = canopySlot(c, en->x, en->y);
+	uint32_t *link = &slot->top;
+	while (*link != e) link = &c->entry[*link].below;
+	*link = en->below;
+	if (link == &slot->top) canopyShow(c, slot);
+}
+
+// Put a leaf of branch b on cell (x, y), replacing b's earlier one there
+void canopyPut(struct canopy *c, struct Branch *b, int x, int y, const char *str, unsigned int attrs, short cpair) {
+	uint16_t glyph = glyph_intern(c->grid->glyphs, str);
+	struct canopySlot *slot = canopySlot(c, x, y);
+	uint32_t e = slot->top;
+	while (e && c->entry[e].order > b->order) e = c->entry[e].below;
+	if (e && c->entry[e].order == b->order) {
+		c->entry[e].glyph = glyph;
+		c->entry[e].attrs = (uint8_t)attrs;
+		c->entry[e].color = (uint8_t)cpair;
+		if (slot->top == e) canopyShow(c, slot);
+		return;
+	}
+	e = canopyAlloc(c);
+	c->entry[e] = (struct canopyEntry){.x = x, .y = y, .order = b->order, .next = b->leafCells,
+									   .glyph = glyph, .attrs = (uint8_t)attrs, .color = (uint8_t)cpair};
+	b->leafCells = e;
+	canopyLink(c, e);
+}
+
+// Shift all of branch b's leaves by (dx, dy): every entry comes off its
+// cell first, so b's own cells never collide on the way
+void canopyMove(struct canopy *c, struct Branch *b, int dx, int dy) {
+	for (uint32_t e = b->leafCells; e; e = c->entry[e].next)
+		canopyUnlink(c, e);
+	for (uint32_t e = b->leafCells; e; e = c->entry[e].next) {
+		c->entry[e].x += dx;
+		c->entry[e].y += dy;
+		canopyLink(c, e);
+	}
+}
+
+// Drop all of branch b's leaves
+void canopyRemove(struct canopy *c, struct Branch *b) {
+	uint32_t e = b->leafCells;
+	while (e) {
+		uint32_t next = c->entry[e].next;
+		canopyUnlink(c, e);
+		c->entry[e].next = c->freeList;
+		c->freeList = e;
+		e = next;
+	}
+	b->leafCells = 0;
+}
+
+// Bytes the canopy's grid, pool and slot table take right now
+size_t canopyBytes(const struct canopy *c) {
+	return grid_bytes(c->grid) + sizeof(*c->entry) * (size_t)c->entryCapacity +
+		   sizeof(*c->slot) * (size_t)c->slotCapacity;
+}
+
+void canopyFree(struct canopy *c) {
+	allocNote(ALLOC_GRID, sizeof(*c->entry) * (size_t)c->entryCapacity + sizeof(*c->slot) * (size_t)c->slotCapacity, 0);
+	grid_destroy(c->grid);
+	free(c->entry);
+	free(c->slot);
+	*c = (struct canopy){0};
+}
+
+// cellEmitter onto the grid ctx
+static void gridEmit(void *ctx, int x, int y, const char *ch, unsigned int attrs, short pair) {
+	grid_put(ctx, x, y, ch, attrs, pair);
+}
+
+// cellEmitter into a branch's live cluster (ctx: struct canopyOwner)
+static void canopyEmit(void *ctx, int x, int y, const char *ch, unsigned int attrs, short pair) {
+	struct canopyOwner *o = ctx;
+	canopyPut(o->canopy, o->branch, x, y, ch, attrs, pair);
+}
+
+// FNV-1a, 64-bit; multi-byte values are fed little-endian so hashes are
+// the same on every host
+static inline unsigned long long fnv_byte(unsigned long long h, unsigned char b) {
+	return (h ^ b) * FNV_PRIME;
+}
+
+static inline unsigned long long fnv_u32(unsigned long long h, unsigned int v) {
+	for (int i = 0; i < 4; i++) h = fnv_byte(h, (unsigned char)(v >> (8 * i)));
+	return h;
+}
+
+static inline unsigned long long fnv_u64(unsigned long long h, unsigned long long v) {
+	for (int i = 0; i < 8; i++) h = fnv_byte(h, (unsigned char)(v >> (8 * i)));
+	return h;
+}
+
+// FNV-1a over every occupied cell in absolute row-major order: position,
+// glyph, bold, colour pair and widen half-width. Independent of the grid's
+// allocation (size, anchor, growth history) and of any frontend's attributes,
+// so it only changes when what the tree looks like changes. Chain grids by
+// passing the previous result as h (start from 0).
+unsigned long long grid_hash(const struct VirtualGrid *g, unsigned long long h) {
+	if (h == 0) h = FNV_OFFSET;
+	struct gridIter it;
+	for (gridIterBegin(&it, g); gridIterNext(&it); ) {
+		const struct gridTile *t = it.tile;
+		h = fnv_u32(h, (unsigned int)(g->anchor_x + it.lx));
+		h = fnv_u32(h, (unsigned int)(g->anchor_y + it.ly));
+		for (const char *p = grid_glyph(g, t, it.i); *p; p++)
+			h = fnv_byte(h, (unsigned char)*p);
+		h = fnv_u32(h, (t->attrs[it.i] & CB_BOLD) ? 1 : 0);
+		h = fnv_u32(h, t->color[it.i]);
+		h = fnv_u32(h, (g->flags & GRID_TRUNK) ? t->trunk[it.i].widenHalf : 0);
+	}
+	return h;
+}
+
+static void grid_put_str(struct VirtualGrid *g, int tx, int ty, const char *str, unsigned int attrs, short cpair) {
+	for (int i = 0; str[i]; i++) {
+		char ch[2] = { str[i], '\0' };
+		grid_put(g, tx + i, ty, ch, attrs, cpair);
+	}
+}
+
+int getBaseHeight(int baseType) {
+	switch(baseType) {
+	case 1: return 4;
+	case 2: return 3;
+	default: return 0;
+	}
+}
+
+// Static part of the plant base (everything below the rim row).
+// The rim row itself is drawn by drawPotRim so it can track the trunk.
+void drawBaseToGrid(struct VirtualGrid *grid, int baseType, int trunk_x, int trunk_y) {
+	if (baseType <= 0) return;
+
+	int by = trunk_y + 1;
+
+	switch(baseType) {
+	case 1: {
+		int bx = trunk_x - 31 / 2;
+		grid_put_str(grid, bx, by + 1, " \\                           / ", CB_BOLD, 8);
+		grid_put_str(grid, bx, by + 2, "  \\_________________________/ ", CB_BOLD, 8);
+		grid_put_str(grid, bx, by + 3, "  (_)                     (_)", CB_BOLD, 8);
+		break;
+	}
+	case 2: {
+		int bx = trunk_x - 15 / 2;
+		grid_put_str(grid, bx, by + 1, " (           ) ", 0, 8);
+		grid_put_str(grid, bx, by + 2, "  (_________)  ", 0, 8);
+		break;
+	}
+	}
+}
+
+// Top row of the pot: grass, then a ./~...~\. flare hugging the trunk's
+// actual span [span_lo, span_hi] on the row above. Redrawn whenever the
+// trunk's footprint at ground level changes. RNG-free.
+void drawPotRim(struct VirtualGrid *grid, int baseType, int trunk_x, int trunk_y,
+				int span_lo, int span_hi) {
+	if (baseType <= 0) return;
+
+	int by = trunk_y + 1;
+
+	switch(baseType) {
+	case 1: {
+		int bx = trunk_x - 31 / 2;
+		// keep the flare (span plus . / \ . on each side) inside the pot mouth
+		int lo = span_lo, hi = span_hi;
+		if (lo < bx + 3) lo = bx + 3;
+		if (hi > bx + 27) hi = bx + 27;
+
+		grid_put(grid, bx, by, ":", CB_BOLD, 8);
+		for (int gx = bx + 1; gx < lo - 2; gx++)
+			grid_put(grid, gx, by, "_", CB_BOLD, 23);
+		grid_put(grid, lo - 2, by, ".", CB_BOLD, 20);
+		grid_put(grid, lo - 1, by, "/", CB_BOLD, 20);
+		for (int gx = lo; gx <= hi; gx++)
+			grid_put(grid, gx, by, "~", CB_BOLD, 20);
+		grid_put(grid, hi + 1, by, "\\", CB_BOLD, 20);
+		grid_put(grid, hi + 2, by, ".", CB_BOLD, 20);
+		for (int gx = hi + 3; gx < bx + 30; gx++)
+			grid_put(grid, gx, by, "_", CB_BOLD, 23);
+		grid_put(grid, bx + 30, by, ":", CB_BOLD, 8);
+		break;
+	}
+	case 2: {
+		int bx = trunk_x - 15 / 2;
+		int lo = span_lo, hi = span_hi;
+		if (lo < bx + 3) lo = bx + 3;
+		if (hi > bx + 11) hi = bx + 11;
+
+		grid_put(grid, bx, by, "(", 0, 8);
+		for (int gx = bx + 1; gx < lo - 2; gx++)
+			grid_put(grid, gx, by, "-", 0, 2);
+		grid_put(grid, lo - 2, by, ".", 0, 11);
+		grid_put(grid, lo - 1, by, "/", 0, 11);
+		for (int gx = lo; gx <= hi; gx++)
+			grid_put(grid, gx, by, "~", 0, 11);
+		grid_put(grid, hi + 1, by, "\\", 0, 11);
+		grid_put(grid, hi + 2, by, ".", 0, 11);
+		for (int gx = hi + 3; gx < bx + 14; gx++)
+			grid_put(grid, gx, by, "-", 0, 2);
+		grid_put(grid, bx + 14, by, ")", 0, 8);
+		break;
+	}
+	}
+}
+
+// v2 counterpart of rand() % mod, drawing from an explicit msaw stream
+static inline int mrand(struct msaw *st, int mod) {
+	if (mod < 1) return 0;
+	return (int)msaw_below(st, (uint32_t)mod);
+}
+
+void initBranchList(struct BranchList* list) {
+	list->capacity = 16;  // Initial capacity
+	list->count = 0;
+	list->nextOrder = 0;
+	list->branches = malloc(sizeof(struct Branch) * list->capacity);
+	allocNote(ALLOC_BRANCHES, 0, sizeof(struct Branch) * list->capacity);
+}
+
+void addBranch(struct BranchList* list, struct Branch branch, struct counters *myCounters) {
+	myCounters->branches++;
+	if (list->count >= list->capacity) {
+		list->capacity *= 2;
+		struct Branch *tmp = realloc(list->branches, sizeof(struct Branch) * list->capacity);
+		if (!tmp) {
+			list->capacity /= 2;
+			return;
+		}
+		allocNote(ALLOC_BRANCHES, sizeof(struct Branch) * (list->capacity / 2),
+				  sizeof(struct Branch) * list->capacity);
+		list->branches = tmp;
+	}
+	branch.order = list->nextOrder++;
+	list->branches[list->count++] = branch;
+	if (list->count > myCounters->peakBranches)
+		myCounters->peakBranches = list->count;
+}
+
+void removeBranch(struct BranchList* list, int index) {
+	if (index >= list->count) return;
+	memmove(&list->branches[index], &list->branches[index + 1], 
+			sizeof(struct Branch) * (list->count - index - 1));
+	list->count--;
+}
+
+void freeBranchList(struct BranchList* list) {
+	for (int i = 0; i < list->count; i++) {
+		allocNote(ALLOC_WALKERS, sizeof(struct LeafWalker) * (size_t)list->branches[i].walker_capacity, 0);
+		free(list->branches[i].walkers);
+	}
+	allocNote(ALLOC_BRANCHES, sizeof(struct Branch) * (size_t)list->capacity, 0);
+	free(list->branches);
+	list->branches = NULL;
+	list->count = 0;
+	list->capacity = 0;
+}
+
+static inline void update_position_history(struct Branch* branch) {
+	// Add new position to history
+	branch->x_history[branch->history_index] = branch->x;
+	branch->y_history[branch->history_index] = branch->y;
+	
+	// Update count and index
+	if (branch->history_count < BRANCH_HISTORY) {
+		branch->history_count++;
+	}
+	branch->history_index = (branch->history_index + 1) % BRANCH_HISTORY;
+}
+
+static inline void get_average_position(struct Branch* branch, int* avg_x, int* avg_y) {
+	if (branch->history_count == 0) {
+
+		*avg_x = branch->x;
+		*avg_y = branch->y;
+		return;
+	}
+	int sum_x = 0, sum_y = 0;
+	for (int i = 0; i < branch->history_count; i++) {
+		sum_x += branch->x_history[i];
+		sum_y += branch->y_history[i];
+	}
+	*avg_x = sum_x / branch->history_count;
+	*avg_y = sum_y / branch->history_count;
+}
+
+// Check if we're in the early trunk phase (first 30% of life)
+static inline int isEarlyTrunk(int age, int totalLife) {
+	return age < (totalLife * 14 / 20);  // 70% of total life
+}
+
+// Check if we're in the young trunk phase (first 15% of life)
+static inline int isYoungTrunk(int age, int totalLife) {
+	return age < (totalLife * 3 / 20);  // 15% of total life
+}
+
+// Calculate branching roll threshold based on age (higher number = less likely to branch)
+static inline int getBranchRollThreshold(int age, int totalLife, int multiplier) {
+	// Base dice of 12, lower number = more branching
+	int dice = 3;  // Base roll threshold (1/3 chance)
+
+	if (isYoungTrunk(age, totalLife)) {
+		dice = 12 - (multiplier/10);  // Only 1/12 chance during young phase
+	} else {
+		// We want LESS chance to branch as we go up
+		int remainingLife = totalLife - age;
+
+
+
+		if (remainingLife < totalLife / 4) {  // Near the top
+			dice = 15 - (multiplier/4);  // Base 1/12 chance
+		} else if (remainingLife < totalLife / 2) {  // Upper half
+			dice = 10 - (multiplier/6);  // Base 1/8 chance
+		} else {
+			dice = 5 - (multiplier/10);  // Base 1/4 chance near bottom
+		}
+	}
+	
+	return dice;
+}
+
+// Size of the area a tree grows into: asked of the frontend, or
+// conf->cols/rows when growing headless (no frontend).
+void frontendBegin(const struct frontend *fe, struct config *conf, int *maxY, int *maxX) {
+	if (fe) {
+		fe->begin(fe->ctx, conf, maxY, maxX);
+	} else {
+		*maxY = conf->rows;
+		*maxX = conf->cols;
+	}
+}
+
+
+// ==========================================================================
+// INSTRUMENTATION  (opt-in; RNG-free, never changes a tree)
+// ==========================================================================
+
+// --profile: NULL unless enabled, so every probe costs one branch when off
+struct profiler *profiler = NULL;
+
+// --state-trace: NULL unless enabled
+FILE *stateTrace = NULL;
+
+// --alloc-stats: NULL unless enabled
+struct allocStats *allocStats = NULL;
+
+// --trace: NULL unless enabled. Chrome trace-event JSON (array form), so
+// the file loads in chrome://tracing and ui.perfetto.dev
+FILE *eventTrace = NULL;
+
+static unsigned long long traceEpochNs;   // monotonic time of ts 0
+
+static unsigned long long traceCount;     // events written (comma placement)
+
+// --stats-file / --metrics: NULL unless enabled. The SIGUSR1 handler and
+// the SIGALRM metrics timer only raise a flag; the tick loop does the
+// writing at its next tick.
+struct runtimeStats *runtimeStats = NULL;
+
+static volatile sig_atomic_t statsRequested = 0;
+
+static volatile sig_atomic_t metricsDue = 0;
+
+static const char *allocSubsystemNames[ALLOC_SUBSYSTEMS] = {
+	"grid", "branches", "walkers", "strings"
+};
+
+static const char *profPhaseNames[PROF_PHASES] = {
+	"update", "trunkPlane", "widen", "leaves", "blit", "present"
+};
+
+void profRecord(enum profPhase phase, unsigned long long ns) {
+	if (profiler) hist_record(&profiler->phase[phase], ns);
+}
+
+void hist_record(struct phaseHist *h, unsigned long long ns) {
+	int idx;
+	if (ns < 4) {
+		idx = (int)ns;
+	} else {
+		int e = 63;
+		while (!(ns >> e)) e--;
+		idx = (e << 2) | (int)((ns >> (e - 2)) & 3);
+	}
+	h->buckets[idx]++;
+	h->count++;
+	h->totalNs += ns;
+	if (ns > h->maxNs) h->maxNs = ns;
+}
+
+// upper edge of the bucket holding the pct-th percentile sample (clamped to
+// the exact max, so p100 == max)
+unsigned long long hist_percentile(const struct phaseHist *h, double pct) {
+	if (h->count == 0) return 0;
+	unsigned long long rank = (unsigned long long)(h->count * pct / 100.0);
+	if (rank >= h->count) rank = h->count - 1;
+	unsigned long long seen = 0;
+	for (int idx = 0; idx < PROF_BUCKETS; idx++) {
+		seen += h->buckets[idx];
+		if (seen > rank) {
+			unsigned long long upper;
+			if (idx < 4) upper = (unsigned long long)idx;
+			else {
+				int e = idx >> 2, sub = idx & 3;
+				upper = ((unsigned long long)(5 + sub) << (e - 2)) - 1;
+			}
+			return (upper < h->maxNs) ? upper : h->maxNs;
+		}
+	}
+	return h->maxNs;
+}
+
+// per-phase summary, printed once at exit (after endwin)
+void printProfile(FILE *out) {
+	if (!profiler) return;
+	unsigned long long grand = 0;
+	for (int p = 0; p < PROF_PHASES; p++) grand += profiler->phase[p].totalNs;
+
+	fprintf(out, "cbonsai profile (microseconds)\n");
+	fprintf(out, "%-11s %10s %10s %10s %10s %10s %6s\n",
+			"phase", "samples", "mean", "p50", "p99", "max", "share");
+	for (int p = 0; p < PROF_PHASES; p++) {
+		const struct phaseHist *h = &profiler->phase[p];
+		if (h->count == 0) continue;
+		fprintf(out, "%-11s %10llu %10.2f %10.2f %10.2f %10.2f %5.1f%%\n",
+				profPhaseNames[p], h->count,
+				h->totalNs / 1000.0 / h->count,
+				hist_percentile(h, 50) / 1000.0,
+				hist_percentile(h, 99) / 1000.0,
+				h->maxNs / 1000.0,
+				grand ? 100.0 * h->totalNs / grand : 0.0);
+	}
+}
+
+// Account one heap event, realloc-shaped: (0, n) is an allocation, (n, 0)
+// a free, (old, new) a resize. Free when --alloc-stats is off.
+static inline void allocNote(enum allocSubsystem sub, size_t oldBytes, size_t newBytes) {
+	if (allocStats) allocRecord(sub, oldBytes, newBytes);
+}
+
+void allocRecord(enum allocSubsystem sub, size_t oldBytes, size_t newBytes) {
+	struct allocCounter *c = &allocStats->sub[sub];
+	if (newBytes > 0) {
+		c->allocs++;
+		c->totalBytes += newBytes;
+		allocStats->tickAllocs++;
+	} else if (oldBytes > 0) {
+		c->frees++;
+	}
+	long long delta = (long long)newBytes - (long long)oldBytes;
+	c->liveBytes += delta;
+	if (c->liveBytes > c->peakBytes) c->peakBytes = c->liveBytes;
+	allocStats->liveBytes += delta;
+	if (allocStats->liveBytes > allocStats->peakBytes)
+		allocStats->peakBytes = allocStats->liveBytes;
+}
+
+// close the current tick's allocation count (called once per tick)
+static inline void allocTick(void) {
+	if (!allocStats) return;
+	if (allocStats->tickAllocs > allocStats->maxTickAllocs)
+		allocStats->maxTickAllocs = allocStats->tickAllocs;
+	allocStats->tickAllocs = 0;
+	allocStats->ticks++;
+}
+
+// per-subsystem summary plus the process's peak RSS, printed at exit
+void printAllocStats(FILE *out) {
+	if (!allocStats) return;
+	unsigned long long allocs = 0;
+	for (int s = 0; s < ALLOC_SUBSYSTEMS; s++) allocs += allocStats->sub[s].allocs;
+
+	fprintf(out, "cbonsai allocations (%llu ticks)\n", allocStats->ticks);
+	fprintf(out, "%-9s %12s %10s %12s %12s %12s\n",
+			"subsystem", "allocs", "per tick", "total KiB", "live KiB", "peak KiB");
+	for (int s = 0; s < ALLOC_SUBSYSTEMS; s++) {
+		const struct allocCounter *c = &allocStats->sub[s];
+		fprintf(out, "%-9s %12llu %10.2f %12.1f %12.1f %12.1f\n",
+				allocSubsystemNames[s], c->allocs,
+				allocStats->ticks ? (double)c->allocs / allocStats->ticks : 0.0,
+				c->totalBytes / 1024.0, c->liveBytes / 1024.0, c->peakBytes / 1024.0);
+	}
+	fprintf(out, "all: %.2f allocs/tick (max %llu in one tick), peak live %.1f KiB\n",
+			allocStats->ticks ? (double)allocs / allocStats->ticks : 0.0,
+			allocStats->maxTickAllocs, allocStats->peakBytes / 1024.0);
+
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		fprintf(out, "peak RSS: %ld KiB\n", (long)ru.ru_maxrss);	// KiB on Linux, bytes on macOS
+}
+
+// Write one trace event. ph is the trace-event phase: 'X' spans
+// startNs..endNs, 'i' is an instant at startNs, 'C' a counter sample and
+// 'M' metadata. argsFmt (printf-style, may be NULL) is the body of the
+// event's "args" object.
+void traceEvent(char ph, const char *name, const char *cat,
+				unsigned long long startNs, unsigned long long endNs, const char *argsFmt, ...) {
+	if (!eventTrace) return;
+	double ts = startNs > traceEpochNs ? (startNs - traceEpochNs) / 1e3 : 0.0;
+	fprintf(eventTrace, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":1",
+			traceCount++ ? ",\n" : "", name, cat, ph, ts);
+	if (ph == 'X')
+		fprintf(eventTrace, ",\"dur\":%.3f", endNs > startNs ? (endNs - startNs) / 1e3 : 0.0);
+	else if (ph == 'i')
+		fputs(",\"s\":\"t\"", eventTrace);
+	if (argsFmt) {
+		va_list ap;
+		va_start(ap, argsFmt);
+		fputs(",\"args\":{", eventTrace);
+		vfprintf(eventTrace, argsFmt, ap);
+		fputc('}', eventTrace);
+		va_end(ap);
+	}
+	fputc('}', eventTrace);
+}
+
+// instant event for a branch spawned by updateBranch_v1/_v2 (kind is
+// split, shoot, drip or wither)
+static inline void traceSpawn(const char *kind, const struct Branch *b, const struct BranchList *list) {
+	if (!eventTrace) return;
+	traceEvent('i', kind, "spawn", monotonicNs(), 0,
+			   "\"x\":%d,\"y\":%d,\"life\":%d,\"branches\":%d", b->x, b->y, b->life, list->count);
+}
+
+// One tick span (simulation only; the live display step is its own
+// "present" span) plus a counter sample of live branches and walkers.
+void traceTick(const struct counters *myCounters, const struct BranchList *list,
+			   unsigned long long tickStart) {
+	unsigned long long now = monotonicNs();
+	int walkers = 0;
+	for (int i = 0; i < list->count; i++) walkers += list->branches[i].walker_count;
+	traceEvent('X', "tick", "tick", tickStart, now, "\"t\":%llu,\"branches\":%d",
+			   myCounters->globalTime, list->count);
+	traceEvent('C', "live", "tick", now, 0, "\"branches\":%d,\"walkers\":%d", list->count, walkers);
+}
+
+// Open the --trace file and start the event array. Returns 0 on success.
+int traceOpen(const char *path) {
+	traceClose();
+	eventTrace = fopen(path, "w");
+	if (!eventTrace) return 1;
+	fputs("[\n", eventTrace);
+	traceEpochNs = monotonicNs();
+	traceCount = 0;
+	return 0;
+}
+
+// Terminate the event array and close the file (called from quit()).
+void traceClose(void) {
+	if (!eventTrace) return;
+	fputs("\n]\n", eventTrace);
+	fclose(eventTrace);
+	eventTrace = NULL;
+}
+
+// async-signal-safe: set the flag and nothing else
+static void onStatsSignal(int sig) {
+	(void)sig;
+	statsRequested = 1;
+}
+
+static void onMetricsTimer(int sig) {
+	(void)sig;
+	metricsDue = 1;
+}
+
+static struct runtimeStats *statsCreate(void) {
+	if (!runtimeStats) {
+		runtimeStats = calloc(1, sizeof(struct runtimeStats));
+		runtimeStats->startTime = time(NULL);
+		runtimeStats->startNs = monotonicNs();
+	}
+	return runtimeStats;
+}
+
+// Enable --stats-file and install the SIGUSR1 handler. Returns 0 on success.
+int statsInstall(const char *path) {
+	statsCreate()->path = path;
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onStatsSignal;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	return sigaction(SIGUSR1, &sa, NULL);
+}
+
+// Enable --metrics: write the textfile now and then every interval
+// seconds off an interval timer. Returns 0 on success.
+int metricsInstall(const char *path, int interval) {
+	statsCreate()->metricsPath = path;
+	runtimeStats->metricsInterval = interval;
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onMetricsTimer;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	if (sigaction(SIGALRM, &sa, NULL)) return 1;
+
+	struct itimerval it = {
+		.it_interval = {.tv_sec = interval},
+		.it_value = {.tv_sec = interval}
+	};
+	metricsDue = 1;		// first write at the first tick
+	return setitimer(ITIMER_REAL, &it, NULL);
+}
+
+void statsFrame(unsigned long long start) {
+	if (runtimeStats) hist_record(&runtimeStats->frame, monotonicNs() - start);
+}
+
+// a tree finished; start is statsStart() from before it began growing
+void statsTreeDone(const struct counters *myCounters, unsigned long long start) {
+	if (!runtimeStats) return;
+	runtimeStats->trees++;
+	runtimeStats->ticks += myCounters->globalTime;
+	if (myCounters->peakBranches > runtimeStats->peakBranches)
+		runtimeStats->peakBranches = myCounters->peakBranches;
+	hist_record(&runtimeStats->tree, monotonicNs() - start);
+}
+
+// once per tick: two flag tests unless a SIGUSR1 or metrics write is due
+static inline void statsPoll(const struct counters *myCounters, const struct BranchList *list) {
+	if (statsRequested) statsDump(myCounters, list);
+	if (metricsDue) metricsWrite(myCounters, list);
+}
+
+// Append one snapshot to the --stats-file (opened per dump, so the file
+// can be rotated underneath a running process).
+void statsDump(const struct counters *myCounters, const struct BranchList *list) {
+	statsRequested = 0;
+	if (!runtimeStats) return;
+	FILE *out = fopen(runtimeStats->path, "a");
+	if (!out) return;
+
+	time_t now = time(NULL);
+	char stamp[32];
+	strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	unsigned long long up = (monotonicNs() - runtimeStats->startNs) / 1000000000ULL;
+	const struct phaseHist *f = &runtimeStats->frame;
+
+	fprintf(out, "--- cbonsai stats %s pid %ld\n", stamp, (long)getpid());
+	fprintf(out, "uptime: %llud %02llu:%02llu:%02llu (%llu s)\n",
+			up / 86400, up / 3600 % 24, up / 60 % 60, up % 60, up);
+	fprintf(out, "trees: %llu\n", runtimeStats->trees);
+	fprintf(out, "ticks: %llu (current tree: %llu)\n",
+			runtimeStats->ticks + myCounters->globalTime, myCounters->globalTime);
+	if (f->count)
+		fprintf(out, "frame: mean %.3f ms, p99 %.3f ms, max %.3f ms (%llu frames)\n",
+				f->totalNs / (double)f->count / 1e6, hist_percentile(f, 99) / 1e6,
+				f->maxNs / 1e6, f->count);
+	else
+		fprintf(out, "frame: none (not live)\n");
+
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		fprintf(out, "peak RSS: %ld KiB\n", (long)ru.ru_maxrss);
+	fprintf(out, "branches: %d (capacity %d)\n", list->count, list->capacity);
+	fclose(out);
+}
+
+// one Prometheus histogram from a phaseHist, cumulative at 2^lo..2^hi ns
+static void metricsHistogram(FILE *out, const char *name, const char *help,
+							 const struct phaseHist *h, int lo, int hi) {
+	fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+	unsigned long long cum = 0;
+	int idx = 0;
+	for (int e = lo; e <= hi; e++) {
+		for (; idx < (e << 2) && idx < PROF_BUCKETS; idx++) cum += h->buckets[idx];
+		fprintf(out, "%s_bucket{le=\"%.9g\"} %llu\n", name, (double)(1ULL << e) / 1e9, cum);
+	}
+	fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, h->count);
+	fprintf(out, "%s_sum %.9f\n%s_count %llu\n", name, h->totalNs / 1e9, name, h->count);
+}
+
+// Rewrite the --metrics textfile: written to FILE.tmp, then renamed over
+// FILE, so the textfile collector never reads a torn file. No fsync: the
+// write is a page-cache copy of a few KiB and never waits on the disk.
+void metricsWrite(const struct counters *myCounters, const struct BranchList *list) {
+	metricsDue = 0;
+	if (!runtimeStats || !runtimeStats->metricsPath) return;
+	size_t len = strlen(runtimeStats->metricsPath) + 5;
+	char *tmp = malloc(len);
+	snprintf(tmp, len, "%s.tmp", runtimeStats->metricsPath);
+	FILE *out = fopen(tmp, "w");
+	if (!out) {
+		free(tmp);
+		return;
+	}
+
+	int walkers = 0;
+	for (int i = 0; i < list->count; i++) walkers += list->branches[i].walker_count;
+	int peakBranches = runtimeStats->peakBranches > myCounters->peakBranches ?
+		runtimeStats->peakBranches : myCounters->peakBranches;
+
+	fprintf(out, "# HELP cbonsai_trees_completed_total Trees grown to completion.\n"
+			"# TYPE cbonsai_trees_completed_total counter\n"
+			"cbonsai_trees_completed_total %llu\n", runtimeStats->trees);
+	fprintf(out, "# HELP cbonsai_ticks_total Growth ticks simulated.\n"
+			"# TYPE cbonsai_ticks_total counter\n"
+			"cbonsai_ticks_total %llu\n", runtimeStats->ticks + myCounters->globalTime);
+	metricsHistogram(out, "cbonsai_frame_seconds", "Live frame latency (blit + present).",
+					 &runtimeStats->frame, METRICS_FRAME_LO, METRICS_FRAME_HI);
+	metricsHistogram(out, "cbonsai_tree_generation_seconds", "Wall time to grow one tree.",
+					 &runtimeStats->tree, METRICS_TREE_LO, METRICS_TREE_HI);
+
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		fprintf(out, "# HELP cbonsai_peak_resident_memory_bytes Peak resident set size.\n"
+				"# TYPE cbonsai_peak_resident_memory_bytes gauge\n"
+				"cbonsai_peak_resident_memory_bytes %ld\n", (long)ru.ru_maxrss * 1024L);
+	fprintf(out, "# HELP cbonsai_branches Branches alive in the current tree.\n"
+			"# TYPE cbonsai_branches gauge\n"
+			"cbonsai_branches %d\n", list->count);
+	fprintf(out, "# HELP cbonsai_branches_peak Largest branch list of any tree so far.\n"
+			"# TYPE cbonsai_branches_peak gauge\n"
+			"cbonsai_branches_peak %d\n", peakBranches);
+	fprintf(out, "# HELP cbonsai_leaf_walkers Live procedural leaf walkers.\n"
+			"# TYPE cbonsai_leaf_walkers gauge\n"
+			"cbonsai_leaf_walkers %d\n", walkers);
+	fprintf(out, "# HELP cbonsai_start_time_seconds Process start, seconds since the epoch.\n"
+			"# TYPE cbonsai_start_time_seconds gauge\n"
+			"cbonsai_start_time_seconds %lld\n", (long long)runtimeStats->startTime);
+
+	if (fclose(out) == 0)
+		rename(tmp, runtimeStats->metricsPath);
+	else
+		remove(tmp);
+	free(tmp);
+}
+
+// Every piece of growth state one branch carries, walkers and live leaves
+// in canopy included (the leaves as what they show, not where they are
+// pooled)
+unsigned long long branch_hash(const struct Branch *b, const struct canopy *canopy) {
+	const int fields[] = {
+		b->x, b->y, b->dx, b->dy, b->life, b->age, (int)b->type,
+		b->shootCooldown, b->dripLeafCooldown, b->totalLife, b->multiplier,
+		b->lean, b->splitDepth, b->shootGrace, b->deadwood, b->diebackLife,
+		(int)b->leaf_seed, b->history_count, b->history_index,
+		b->leaf_steps_drawn, b->leaf_cur_x, b->leaf_cur_y, b->walker_count
+	};
+	unsigned long long h = FNV_OFFSET;
+	for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+		h = fnv_u32(h, (unsigned int)fields[i]);
+	for (int i = 0; i < BRANCH_HISTORY; i++) {
+		h = fnv_u32(h, (unsigned int)b->x_history[i]);
+		h = fnv_u32(h, (unsigned int)b->y_history[i]);
+	}
+	h = fnv_u64(h, b->leaf_rng.x);
+	h = fnv_u64(h, b->leaf_rng.w);
+	h = fnv_u64(h, b->leaf_rng.s);
+	for (int w = 0; w < b->walker_count; w++) {
+		const struct LeafWalker *wk = &b->walkers[w];
+		h = fnv_u32(h, (unsigned int)wk->x);
+		h = fnv_u32(h, (unsigned int)wk->y);
+		h = fnv_u32(h, wk->seed);
+		h = fnv_u32(h, (unsigned int)wk->outward);
+		h = fnv_u64(h, wk->rng.x);
+		h = fnv_u64(h, wk->rng.w);
+	}
+	h = fnv_u32(h, b->order);
+	for (uint32_t e = b->leafCells; e; e = canopy->entry[e].next) {
+		const struct canopyEntry *en = &canopy->entry[e];
+		h = fnv_u32(h, (unsigned int)en->x);
+		h = fnv_u32(h, (unsigned int)en->y);
+		for (const char *p = canopy->grid->glyphs->glyph[en->glyph]; *p; p++)
+			h = fnv_byte(h, (unsigned char)*p);
+		h = fnv_u32(h, (en->attrs & CB_BOLD) ? 1 : 0);
+		h = fnv_u32(h, en->color);
+	}
+	return h;
+}
+
+// --state-trace: one line per tick,
+//   <tick> <turn> <count> <rng> <grid> <list> : <branch 0> <branch 1> ...
+// rng covers the engine's msaw streams (v1's struct v1rand is not an msaw
+// and is left out), grid the skeleton + trunk plane, list every branch in order.
+// Per-branch hashes are truncated to 32 bits; they only locate a
+// divergence that the 64-bit list hash has already found.
+void traceState(const struct counters *myCounters, const struct BranchList *list,
+				const struct canopy *canopy, int turn,
+				const struct msaw *streams, int nstreams,
+				const struct VirtualGrid *skeleton, const struct VirtualGrid *trunkPlane) {
+	if (!stateTrace) return;
+
+	unsigned long long rng = FNV_OFFSET;
+	for (int i = 0; i < nstreams; i++) {
+		rng = fnv_u64(rng, streams[i].x);
+		rng = fnv_u64(rng, streams[i].w);
+		rng = fnv_u64(rng, streams[i].s);
+	}
+	unsigned long long grid = grid_hash(trunkPlane, grid_hash(skeleton, 0));
+
+	unsigned long long *hashes = malloc(sizeof(unsigned long long) * (size_t)(list->count + 1));
+	unsigned long long all = FNV_OFFSET;
+	for (int i = 0; i < list->count; i++) {
+		hashes[i] = branch_hash(&list->branches[i], canopy);
+		all = fnv_u64(all, hashes[i]);
+	}
+
+	fprintf(stateTrace, "%llu %d %d %016llx %016llx %016llx :", myCounters->globalTime,
+			turn, list->count, rng, grid, all);
+	for (int i = 0; i < list->count; i++)
+		fprintf(stateTrace, " %08x", (unsigned int)hashes[i]);
+	fputc('\n', stateTrace);
+	free(hashes);
+}
+
+
+// ==========================================================================
+// V1 ENGINE  (FROZEN — original global-rand growth; do not modify)
+// ==========================================================================
+
+// glibc srandom_r for TYPE_3: fill the table with 16807 * x mod (2^31 - 1)
+// (Schrage's method, exactly glibc's arithmetic), then discard 310 outputs.
+void v1rand_seed(struct v1rand *st, unsigned int seed) {
+	if (seed == 0) seed = 1;
+	int32_t word = seed;
+	st->state[0] = word;
+	for (int i = 1; i < 31; i++) {
+		long hi = word / 127773;
+		long lo = word % 127773;
+		word = 16807 * lo - 2836 * hi;
+		if (word < 0) word += 2147483647;
+		st->state[i] = word;
+	}
+	st->f = 3;
+	st->r = 0;
+	for (int i = 0; i < 310; i++) v1rand(st);
+}
+
+// glibc random_r for TYPE_3: one rand() value in [0, RAND_MAX]
+int v1rand(struct v1rand *st) {
+	uint32_t val = (uint32_t)st->state[st->f] + (uint32_t)st->state[st->r];
+	st->state[st->f] = (int32_t)val;
+	if (++st->f == 31) st->f = 0;
+	if (++st->r == 31) st->r = 0;
+	return (int)(val >> 1);
+}
+
+// roll (randomize) a given die
+static inline void roll(int *dice, int mod, struct v1rand *rng) { *dice = v1rand(rng) % mod; }
+
+struct ColorResult chooseColorResult(enum branchType type, struct v1rand *rng) {
+	struct ColorResult cr = {0, 0};
+	int r;
+	switch(type) {
+	case trunk:
+		r = v1rand(rng) % 6;
+		if (r < 3) { cr.attrs = CB_BOLD; cr.color_pair = 20; }
+		else if (r < 5) { cr.color_pair = 20; }
+		else { cr.color_pair = 21; }
+		break;
+
+	case shootLeft:
+	case shootRight:
+		r = v1rand(rng) % 10;
+		if (r < 2) { cr.attrs = CB_BOLD; cr.color_pair = 20; }
+		else if (r < 6) { cr.attrs = CB_BOLD; cr.color_pair = 21; }
+		else { cr.color_pair = 21; }
+		break;
+
+	case dying:
+		r = v1rand(rng) % 6;
+		if (r < 3) { cr.color_pair = 22; }
+		else if (r < 5) { cr.attrs = CB_BOLD; cr.color_pair = 22; }
+		else { cr.color_pair = 23; }
+		break;
+
+	case dead:
+		r = v1rand(rng) % 18;
+		if (r < 2) { cr.attrs = CB_BOLD; cr.color_pair = 23; }
+		else if (r < 8) { cr.attrs = CB_BOLD; cr.color_pair = 22; }
+		else { cr.color_pair = 22; }
+		break;
+	}
+	return cr;
+}
+
+// determine change in X and Y coordinates of a given branch
+void setDeltas(enum branchType type, int life, int totalLife, int age, int multiplier, int *returnDx, int *returnDy,
+			   struct v1rand *rng) {
+	int dx = 0;
+	int dy = 0;
+	int dice;
+	switch (type) {
+	case trunk: // trunk
+
+		// new or dead trunk
+		if (age <= 2 || life < 4) {
+			dy = 0;
+			dx = (v1rand(rng) % 3) - 1;
+		}
+		// young trunk should grow wide]
+		else if (isYoungTrunk(age, totalLife)) {
+			// every (multiplier * 0.6) steps, raise tree to next level
+			int step = (int)(multiplier * 0.6);
+			if (step < 1) step = 1;
+			if (age % step == 0) dy = -1;
+			else dy = 0;
+
+			roll(&dice, 10, rng);
+			if (dice >= 0 && dice <=0) dx = -2;			// 10%
+			else if (dice >= 1 && dice <= 3) dx = -1;	// 30%
+			else if (dice >= 4 && dice <= 5) dx = 0;	// 20%
+			else if (dice >= 6 && dice <= 8) dx = 1;	// 30%
+			else if (dice >= 9 && dice <= 9) dx = 2;	// 10%
+		}
+		else if (isEarlyTrunk(age, totalLife)) {
+			// every (multiplier * 0.3) steps, raise tree to next level
+			int step = (int)(multiplier * 0.3);
+			if (step < 1) step = 1;
+			if (age % step == 0) dy = -1;
+			else dy = 0;
+
+			roll(&dice, 10, rng);
+			if (dice >= 0 && dice <=0) dx = -2;			// 10%
+			else if (dice >= 1 && dice <= 3) dx = -1;	// 30%
+			else if (dice >= 4 && dice <= 5) dx = 0;	// 20%
+			else if (dice >= 6 && dice <= 8) dx = 1;	// 30%
+			else if (dice >= 9 && dice <= 9) dx = 2;	// 10%
+		}
+		// old-aged trunk
+		else {
+			roll(&dice, 10, rng);
+			if (dice > 4) dy = -1;
+			else dy = 0;
+			
+			roll(&dice, 20, rng);
+			if (dice >= 0 && dice <=0) dx = -2;			// 10%
+			else if (dice >= 1 && dice <= 7) dx = -1;	// 30%
+			else if (dice >= 8 && dice <= 12) dx = 0;	// 20%
+			else if (dice >= 13 && dice <= 18) dx = 1;	// 30%
+			else if (dice >= 19 && dice <= 19) dx = 2;	// 10%
+		}
+		break;
+
+	case 1: // left shoot: trend left and little vertical movement
+		roll(&dice, 10, rng);
+		if (dice >= 0 && dice <= 2) dy = -1;
+		else if (dice >= 3 && dice <= 7) dy = 0;
+		else if (dice >= 8 && dice <= 9) dy = 1;
+
+		roll(&dice, 10, rng);
+		if (dice >= 0 && dice <=1) dx = -2;
+		else if (dice >= 2 && dice <= 5) dx = -1;
+		else if (dice >= 6 && dice <= 8) dx = 0;
+		else if (dice >= 9 && dice <= 9) dx = 1;
+		break;
+
+	case 2: // right shoot: trend right and little vertical movement
+		roll(&dice, 10, rng);
+		if (dice >= 0 && dice <= 2) dy = -1;
+		else if (dice >= 3 && dice <= 7) dy = 0;
+		else if (dice >= 8 && dice <= 9) dy = 1;
+
+		roll(&dice, 10, rng);
+		if (dice >= 0 && dice <=1) dx = 2;
+		else if (dice >= 2 && dice <= 5) dx = 1;
+		else if (dice >= 6 && dice <= 8) dx = 0;
+		else if (dice >= 9 && dice <= 9) dx = -1;
+		break;
+
+	case 3: // dying: discourage vertical growth(?); trend left/right (-3,3)
+		roll(&dice, 10, rng);
+		if (dice >= 0 && dice <=0) dy = -1;
+		else if (dice >= 1 && dice <=8) dy = 0;
+		else if (dice >= 9 && dice <=9) dy = 1;
+
+		roll(&dice, 15, rng);
+		if (dice >= 0 && dice <=0) dx = -3;
+		else if (dice >= 1 && dice <= 2) dx = -2;
+		else if (dice >= 3 && dice <= 5) dx = -1;
+		else if (dice >= 6 && dice <= 8) dx = 0;
+		else if (dice >= 9 && dice <= 11) dx = 1;
+		else if (dice >= 12 && dice <= 13) dx = 2;
+		else if (dice >= 14 && dice <= 14) dx = 3;
+		break;
+
+	case 4: // dead: fill in surrounding area
+		roll(&dice, 12, rng);
+		if (dice >= 0 && dice <= 1) dy = -1;
+		else if (dice >= 2 && dice <= 8) dy = 0;
+		else if (dice >= 9 && dice <= 11) dy = 1;
+		
+		roll(&dice, 15, rng);
+		if (dice >= 0 && dice <=1) dx = -3;
+		else if (dice >= 2 && dice <= 3) dx = -2;
+		else if (dice >= 4 && dice <= 5) dx = -1;
+		else if (dice >= 6 && dice <= 8) dx = 0;
+		else if (dice >= 9 && dice <= 10) dx = 1;
+		else if (dice >= 11 && dice <= 12) dx = 2;
+		else if (dice >= 13 && dice <= 14) dx = 3;
+		break;
+	}
+
+	*returnDx = dx;
+	*returnDy = dy;
+}
+
+char* chooseString(const struct config *conf, enum branchType type, int life, int dx, int dy,
+				   struct v1rand *rng) {
+	char* branchStr;
+
+	const unsigned int maxStrLen = 32;
+
+	branchStr = malloc(maxStrLen);
+	allocNote(ALLOC_STRINGS, 0, maxStrLen);
+	strcpy(branchStr, "?");	// fallback character
+
+	if (life < 4) type = dying;
+
+	switch(type) {
+	case trunk:
+		if (dy == 0) strcpy(branchStr, "/~");
+		else if (dx < 0) strcpy(branchStr, "\\|");
+		else if (dx == 0) strcpy(branchStr, "/|\\");
+		else if (dx > 0) strcpy(branchStr, "|/");
+		break;
+	case shootLeft:
+		if (dy > 0) strcpy(branchStr, "\\");
+		else if (dy == 0) strcpy(branchStr, "\\_");
+		else if (dx < 0) strcpy(branchStr, "\\|");
+		else if (dx == 0) strcpy(branchStr, "/|");
+		else if (dx > 0) strcpy(branchStr, "/");
+		break;
+	case shootRight:
+		if (dy > 0) strcpy(branchStr, "/");
+		else if (dy == 0) strcpy(branchStr, "_/");
+		else if (dx < 0) strcpy(branchStr, "\\|");
+		else if (dx == 0) strcpy(branchStr, "/|");
+		else if (dx > 0) strcpy(branchStr, "/");
+		break;
+	case dying:
+	case dead:
+		strncpy(branchStr, conf->leaves[v1rand(rng) % conf->leavesSize], maxStrLen - 1);
+		branchStr[maxStrLen - 1] = '\0';
+	}
+
+	return branchStr;
+}
+
+void updateBranch_v1(struct config *conf, struct VirtualGrid *skeleton,
+				struct counters *myCounters, int branchIdx,
+				struct BranchList* list, struct v1rand *rng) {
+
+	struct Branch *branch = &list->branches[branchIdx];
+	branch->life--;     // decrement remaining life counter
+
+	// Random die-off check - more likely on shoots
+	if (branch->type == trunk) {
+		if (v1rand(rng) % 66 == 0) {   // 2% chance for trunk
+			branch->life -= (branch->life/2);  // Lose 1/4 of life
+		}
+	} else if (branch->type == shootLeft || branch->type == shootRight) {
+		if (v1rand(rng) % 20 == 0) {    // 5% chance for shoots
+			branch->life /= 2;      // Lose half of life
+		}
+	}
+
+	branch->age++;
+
+	setDeltas(branch->type, branch->life, branch->totalLife,
+			  branch->age, branch->multiplier, &branch->dx, &branch->dy, rng);
+
+	int groundY = grid_bottom(skeleton) - getBaseHeight(conf->baseType);
+	if (branch->dy > 0 && branch->y > (groundY - 6))
+		branch->dy--;
+
+	// near-dead branch should branch into a lot of leaves
+	if (branch->life < 6) {
+		struct Branch newBranch = {
+			.x = branch->x,
+			.y = branch->y,
+			.type = dead,
+			.life = branch->life,
+			.age = 0,
+			.totalLife = branch->life,
+			.multiplier = branch->multiplier,
+			.shootCooldown = conf->multiplier,
+			.dripLeafCooldown = branch->life / 4,
+			.leaf_seed = v1rand(rng),
+			.history_count = 0,
+			.history_index = 0,
+			.x_history[0] = branch->x,
+			.y_history[0] = branch->y
+		};
+		addBranch(list, newBranch, myCounters);
+		traceSpawn("wither", &newBranch, list);
+		branch = &list->branches[branchIdx];
+	}
+	else if (branch->type == shootLeft || branch->type == shootRight) {
+		if (branch->life < 7 + (branch->multiplier /5)) {
+			struct Branch newBranch = {
+				.x = branch->x,
+				.y = branch->y,
+				.type = dying,
+				.life = branch->life + 1,
+				.age = 0,
+				.totalLife = branch->life + 1,
+				.multiplier = branch->multiplier,
+				.shootCooldown = conf->multiplier,
+				.dripLeafCooldown = (branch->life + 1) / 4,
+				.leaf_seed = v1rand(rng),
+				.history_count = 0,
+				.history_index = 0,
+				.x_history[0] = branch->x,
+				.y_history[0] = branch->y
+			};
+			addBranch(list, newBranch, myCounters);
+			traceSpawn("wither", &newBranch, list);
+			branch = &list->branches[branchIdx];
+		}
+		else if (branch->dripLeafCooldown <= 0 && (v1rand(rng) % 3) == 0) {
+			struct Branch newBranch = {
+				.x = branch->x,
+				.y = branch->y,
+				.type = dying,
+				.life = 5,
+				.age = 0,
+				.totalLife = 5,
+				.multiplier = branch->multiplier,
+				.shootCooldown = conf->multiplier,
+				.dripLeafCooldown = (branch->multiplier*2)/3,
+				.leaf_seed = v1rand(rng),
+				.history_count = 0,
+				.history_index = 0,
+				.x_history[0] = branch->x,
+				.y_history[0] = branch->y
+			};
+			addBranch(list, newBranch, myCounters);
+			traceSpawn("drip", &newBranch, list);
+			branch = &list->branches[branchIdx];
+			branch->dripLeafCooldown = 7+ (25 + branch->multiplier);
+		}
+	}
+	// dying trunk should branch into a lot of leaves
+	else if (branch->type == trunk && branch->life < (branch->multiplier + 2)) {
+		struct Branch newBranch = {
+			.x = branch->x,
+			.y = branch->y,
+			.type = dying,
+			.life = branch->life,
+			.age = 0,
+			.totalLife = branch->life,
+			.multiplier = branch->multiplier,
+			.shootCooldown = conf->multiplier,
+			.dripLeafCooldown = branch->life / 4,
+			.leaf_seed = v1rand(rng),
+			.history_count = 0,
+			.history_index = 0,
+			.x_history[0] = branch->x,
+			.y_history[0] = branch->y
+		};
+		addBranch(list, newBranch, myCounters);
+		traceSpawn("wither", &newBranch, list);
+		branch = &list->branches[branchIdx];
+	}
+	// dying shoot should branch into a lot of leaves
+	else if ((branch->type == shootLeft || branch->type == shootRight) && 
+			 branch->life < (branch->multiplier + 2)) {
+		struct Branch newBranch = {
+			.x = branch->x,
+			.y = branch->y,
+			.type = dying,
+			.life = branch->life,
+			.age = 0,
+			.totalLife = branch->life,
+			.multiplier = branch->multiplier,
+			.shootCooldown = conf->multiplier,
+			.dripLeafCooldown = branch->life / 4,
+			.leaf_seed = v1rand(rng),
+			.history_count = 0,
+			.history_index = 0,
+			.x_history[0] = branch->x,
+			.y_history[0] = branch->y
+		};
+		addBranch(list, newBranch, myCounters);
+		traceSpawn("wither", &newBranch, list);
+		branch = &list->branches[branchIdx];
+	}
+	else if (branch->type == trunk) {
+		branch->life--;
+		// First check for trunk splits - only in early phase and with enough life
+		if (!isYoungTrunk(branch->age, branch->totalLife)) {
+			int splitThreshold = (24 - branch->multiplier) + (2 * myCounters->trunks);
+			double ageRatio = (double)branch->age / branch->totalLife;
+
+			if (ageRatio < 0.1) {      // Bottom 10%
+				splitThreshold = (splitThreshold * 2)/7;
+			} else if (ageRatio < 0.4) {
+				splitThreshold = (splitThreshold * 3)/7;
+			} else {
+				splitThreshold = (splitThreshold * 5)/7;
+			}
+
+			if (myCounters->trunkSplitCooldown < 0 && v1rand(rng) % splitThreshold == 0) {
+				myCounters->trunkSplitCooldown = 2 + ((22 - conf->multiplier)*3)/4 +
+					(int)(5 * ((double)branch->totalLife - branch->age)/branch->totalLife);
+				myCounters->trunks++;
+				branch->shootCooldown = (25 - branch->multiplier)/4;
+				struct Branch newBranch = {
+					.x = branch->x,
+					.y = branch->y,
+					.type = trunk,
+					.life = branch->life - (v1rand(rng) % 6),
+					.age = 0,
+					.totalLife = branch->life - (v1rand(rng) % 6),
+					.multiplier = branch->multiplier,
+					.shootCooldown = conf->multiplier,
+					.dripLeafCooldown = branch->life / 4,
+					.leaf_seed = v1rand(rng),
+					.history_count = 0,
+					.history_index = 0,
+					.x_history[0] = branch->x,
+					.y_history[0] = branch->y
+				};
+				addBranch(list, newBranch, myCounters);
+				traceSpawn("split", &newBranch, list);
+				branch = &list->branches[branchIdx];
+				branch->life -= v1rand(rng) % 1+ (int)(5 * ((double)branch->totalLife - branch->age)/branch->totalLife); // cost of splitting
+			}
+		}
+
+		// Then check for regular branch shoots
+		int branchDice = getBranchRollThreshold(branch->age, branch->totalLife, branch->multiplier);
+		if (branch->shootCooldown <= 0 && (v1rand(rng) % branchDice == 0)) {
+			branch->shootCooldown = myCounters->trunks + (25 - branch->multiplier)/6;
+			int shootLife = ((branch->life * 3)/4 + (v1rand(rng) % branch->multiplier) - 2);
+			
+			myCounters->shoots++;
+			myCounters->shootCounter++;
+			(void)0; // verbose shoot count displayed during render
+			
+			struct Branch newBranch = {
+				.x = branch->x,
+				.y = branch->y,
+				.type = (enum branchType)((myCounters->shootCounter % 2) + 1),
+				.life = shootLife,
+				.age = 0,
+				.totalLife = shootLife,
+				.multiplier = branch->multiplier,
+				.shootCooldown = conf->multiplier,
+				.dripLeafCooldown = shootLife / 4,
+				.leaf_seed = v1rand(rng),
+				.history_count = 0,
+				.history_index = 0,
+				.x_history[0] = branch->x,
+				.y_history[0] = branch->y
+			};
+			addBranch(list, newBranch, myCounters);
+			traceSpawn("shoot", &newBranch, list);
+			branch = &list->branches[branchIdx];
+
+			branch->life -= v1rand(rng) % 3; // cost of sprouting
+		}
+	}
+	myCounters->trunkSplitCooldown--;
+	branch->shootCooldown--;
+	branch->dripLeafCooldown--;
+
+	// move in x and y directions
+	branch->x += branch->dx;
+	branch->y += branch->dy;
+	if(conf->proceduralMode && branch->type != dying && branch->type != dead)
+		update_position_history(branch);
+
+	enum branchType displayType = (branch->life < 4) ? dying : branch->type;
+	struct ColorResult cr = chooseColorResult(displayType, rng);
+
+	// choose string to use for this branch
+	char *branchStr = chooseString(conf, displayType, branch->life, branch->dx, branch->dy, rng);
+
+	// grab wide character from branchStr
+	wchar_t wc = 0;
+	mbstate_t ps = {0};
+	mbrtowc(&wc, branchStr, 32, &ps);
+
+	// write to grid, but ensure wide characters don't overlap
+	int w = wcwidth(wc);
+	if (w <= 0) w = 1;
+	if(branch->x % w == 0) {
+		grid_put(skeleton, branch->x, branch->y, branchStr, cr.attrs, cr.color_pair);
+	}
+
+	allocNote(ALLOC_STRINGS, 32, 0);	// chooseString's maxStrLen
+	free(branchStr);
+}
+
+static void leafStepWalkers(struct config *conf, cellEmitter emit, void *ctx,
+							enum branchType type, int groundY,
+							struct LeafWalker **walkers, int *count, int *capacity) {
+	int prev_count = *count;
+	for (int w = 0; w < prev_count; w++) {
+		struct LeafWalker *wk = &(*walkers)[w];
+
+		int dx = 0, dy = 0, dice;
+		switch (type) {
+		case dying:
+			dice = rand_r(&wk->seed) % 10;
+			if (dice >= 0 && dice <= 0) dy = -1;
+			else if (dice >= 1 && dice <= 8) dy = 0;
+			else if (dice >= 9 && dice <= 9) dy = 1;
+
+			dice = rand_r(&wk->seed) % 15;
+			if (dice >= 0 && dice <= 0) dx = -3;
+			else if (dice >= 1 && dice <= 2) dx = -2;
+			else if (dice >= 3 && dice <= 5) dx = -1;
+			else if (dice >= 6 && dice <= 8) dx = 0;
+			else if (dice >= 9 && dice <= 11) dx = 1;
+			else if (dice >= 12 && dice <= 13) dx = 2;
+			else if (dice >= 14 && dice <= 14) dx = 3;
+			break;
+		case dead:
+			dice = rand_r(&wk->seed) % 12;
+			if (dice >= 0 && dice <= 1) dy = -1;
+			else if (dice >= 2 && dice <= 8) dy = 0;
+			else if (dice >= 9 && dice <= 11) dy = 1;
+
+			dice = rand_r(&wk->seed) % 15;
+			if (dice >= 0 && dice <= 1) dx = -3;
+			else if (dice >= 2 && dice <= 3) dx = -2;
+			else if (dice >= 4 && dice <= 5) dx = -1;
+			else if (dice >= 6 && dice <= 8) dx = 0;
+			else if (dice >= 9 && dice <= 10) dx = 1;
+			else if (dice >= 11 && dice <= 12) dx = 2;
+			else if (dice >= 13 && dice <= 14) dx = 3;
+			break;
+		default:
+			break;
+		}
+
+		if (dy > 0 && wk->y > (groundY - 2))
+			dy--;
+
+		unsigned int child_seed = rand_r(&wk->seed);
+		if (*count < 4096) {
+			if (*count >= *capacity) {
+				*capacity *= 2;
+				*walkers = realloc(*walkers, sizeof(struct LeafWalker) * (size_t)*capacity);
+				allocNote(ALLOC_WALKERS, sizeof(struct LeafWalker) * (size_t)(*capacity / 2),
+						  sizeof(struct LeafWalker) * (size_t)*capacity);
+				wk = &(*walkers)[w];
+			}
+			(*walkers)[(*count)++] = (struct LeafWalker){.x = wk->x, .y = wk->y, .seed = child_seed};
+		}
+
+		wk->x += dx;
+		wk->y += dy;
+
+		if (wk->y >= 0 && wk->y < groundY) {
+			unsigned int la = 0;
+			short lc = 0;
+			switch (type) {
+			case dying:
+				if (rand_r(&wk->seed) % 6 == 0) { lc = 22; }
+				else if (rand_r(&wk->seed) % 2 == 0) { la = CB_BOLD; lc = 23; }
+				else { lc = 23; }
+				break;
+			case dead:
+				if (rand_r(&wk->seed) % 7 == 0) { la = CB_BOLD; lc = 22; }
+				else if (rand_r(&wk->seed) % 2 == 0) { la = CB_BOLD; lc = 23; }
+				else { lc = 23; }
+				break;
+			default:
+				break;
+			}
+
+			emit(ctx, wk->x, wk->y, conf->leaves[rand_r(&wk->seed) % conf->leavesSize], la, lc);
+		}
+	}
+}
+
+// returns the number of walkers the burst ended with (instrumentation)
+int generateLeaves_v1(struct config *conf, struct VirtualGrid *grid, enum branchType type, int x, int y, int life, unsigned int leaf_seed, int groundY) {
+	int capacity = 16;
+	int count = 1;
+	struct LeafWalker *walkers = malloc(sizeof(struct LeafWalker) * (size_t)capacity);
+	allocNote(ALLOC_WALKERS, 0, sizeof(struct LeafWalker) * (size_t)capacity);
+	walkers[0] = (struct LeafWalker){.x = x, .y = y, .seed = leaf_seed};
+
+	for (int step = 0; step < life; step++) {
+		leafStepWalkers(conf, gridEmit, grid, type, groundY, &walkers, &count, &capacity);
+	}
+
+	allocNote(ALLOC_WALKERS, sizeof(struct LeafWalker) * (size_t)capacity, 0);
+	free(walkers);
+	return count;
+}
+
+// v1 engine: frozen. Draws only from the tree's own v1rand stream (t->v1rng);
+// any change to its v1rand(rng) call sequence breaks replay of saved v1 trees.
+// treeInit_v1 resets the counters and plants the first trunk; treeTick_v1
+// is one pass of the original growTree loop.
+static void treeInit_v1(struct treeContext *t) {
+	struct config *conf = t->conf;
+	struct counters *myCounters = t->counters;
+
+	v1rand_seed(&t->v1rng, conf->seed);	// what srand(conf->seed) did
+	// v1: never render the widened trunk (frozen look); view.trunkPlane stays NULL
+
+	myCounters->trunks = 0;
+	myCounters->shoots = 0;
+	myCounters->branches = 0;
+	myCounters->shootCounter = 5;
+	myCounters->globalTime = 0;
+	myCounters->trunkSplitCooldown = 0;
+	myCounters->peakBranches = 0;
+	myCounters->peakWalkers = 0;
+	myCounters->gridBytes = 0;
+
+	struct Branch initialBranch = {
+		.x = t->view.trunk_x,
+		.y = t->view.trunk_y,
+		.life = conf->lifeStart,
+		.age = 0,
+		.type = trunk,
+		.shootCooldown = conf->multiplier,
+		.dripLeafCooldown = conf->multiplier + conf->lifeStart / 4,
+		.totalLife = conf->lifeStart,
+		.multiplier = conf->multiplier
+	};
+	addBranch(&t->branchList, initialBranch, myCounters);
+}
+
+// one globalTime tick: 1 if a branch grew, 0 if a spent one was retired
+static int treeTick_v1(struct treeContext *t) {
+	struct config *conf = t->conf;
+	struct counters *myCounters = t->counters;
+	struct VirtualGrid *skeleton = t->skeleton, *trunkPlane = t->trunkPlane;
+	struct BranchList *list = &t->branchList;
+	int trunk_x = t->view.trunk_x, trunk_y = t->view.trunk_y;
+
+	myCounters->globalTime++;
+	allocTick();
+	statsPoll(myCounters, list);
+	unsigned long long tickStart = traceStart();
+
+	if (list->branches[t->turn].life <= 0) {
+		struct Branch* b = &list->branches[t->turn];
+		if (conf->proceduralMode &&
+			b->type != dying && b->type != dead &&
+			b->totalLife > 0) {
+			double lifeRatio = ((double)b->age) / b->totalLife;
+			unsigned int leaf_seed = b->leaf_seed;
+
+			int avg_x, avg_y;
+			get_average_position(b, &avg_x, &avg_y);
+
+			int log_factor = 0, dummy = b->age;
+			while(dummy > 0) {
+				log_factor++;
+				dummy >>= 1;
+			}
+
+			int leafLife = log_factor + lifeRatio * ((b->type == trunk) ? 4 : 3);
+			enum branchType newType = (b->type == trunk) ? dead : dying;
+
+			unsigned long long burstStart = traceStart();
+			int burst = generateLeaves_v1(conf, skeleton, newType, avg_x, avg_y, leafLife, leaf_seed, trunk_y + 1);
+			traceEvent('X', "leaf burst", "leaves", burstStart, traceStart(),
+					   "\"walkers\":%d,\"life\":%d,\"x\":%d,\"y\":%d", burst, leafLife, avg_x, avg_y);
+			if (burst > myCounters->peakWalkers) myCounters->peakWalkers = burst;
+		}
+
+		allocNote(ALLOC_WALKERS, sizeof(struct LeafWalker) * (size_t)b->walker_capacity, 0);
+		free(b->walkers);
+		b->walkers = NULL;
+		b->walker_count = 0;
+		b->walker_capacity = 0;
+		canopyRemove(&t->canopy, b);
+
+		removeBranch(list, t->turn);
+		if (stateTrace)
+			traceState(myCounters, list, &t->canopy, t->turn, NULL, 0, skeleton, trunkPlane);
+		if (eventTrace)
+			traceTick(myCounters, list, tickStart);
+		if (t->turn >= list->count) {
+			t->turn = 0;
+		}
+		return 0;
+	}
+
+	unsigned long long phaseStart = profStart();
+	updateBranch_v1(conf, skeleton, myCounters, t->turn, list, &t->v1rng);
+	profRecord(PROF_UPDATE, profElapsed(phaseStart));
+
+	// record trunk cells in the trunk plane (tracking only, never
+	// blitted) and keep the pot rim hugging the trunk's footprint
+	phaseStart = profStart();
+	{
+		struct Branch *ub = &list->branches[t->turn];
+		if (ub->type == trunk) {
+			grid_put(trunkPlane, ub->x, ub->y, "#", 0, 0);
+			if (ub->y == trunk_y && (ub->x < t->rimLo || ub->x > t->rimHi)) {
+				if (ub->x < t->rimLo) t->rimLo = ub->x;
+				if (ub->x > t->rimHi) t->rimHi = ub->x;
+				drawPotRim(skeleton, conf->baseType, trunk_x, trunk_y, t->rimLo, t->rimHi);
+			}
+		}
+	}
+	profRecord(PROF_TRUNKPLANE, profElapsed(phaseStart));
+
+	if (conf->live && conf->proceduralMode) {
+		phaseStart = profStart();
+		int liveWalkers = 0;
+		for (int i = 0; i < list->count; i++) {
+			struct Branch* b = &list->branches[i];
+
+			if (b->type != trunk && b->type != shootLeft && b->type != shootRight)
+				continue;
+			if (b->totalLife <= 0)
+				continue;
+
+			int avg_x, avg_y;
+			get_average_position(b, &avg_x, &avg_y);
+
+			int log_factor = 0, dummy = b->age;
+			while(dummy > 0) {
+				log_factor++;
+				dummy >>= 1;
+			}
+
+			double lifeRatio = ((double)b->age) / b->totalLife;
+			int targetLeafLife = log_factor + lifeRatio * ((b->type == trunk) ? 4 : 3);
+
+			if (!b->walkers) {
+				b->walker_capacity = 16;
+				b->walker_count = 1;
+				b->walkers = malloc(sizeof(struct LeafWalker) * (size_t)b->walker_capacity);
+				allocNote(ALLOC_WALKERS, 0, sizeof(struct LeafWalker) * (size_t)b->walker_capacity);
+				b->walkers[0] = (struct LeafWalker){.x = avg_x, .y = avg_y, .seed = b->leaf_seed};
+				b->leaf_steps_drawn = 0;
+				b->leaf_cur_x = avg_x;
+				b->leaf_cur_y = avg_y;
+			}
+
+			if (avg_x != b->leaf_cur_x || avg_y != b->leaf_cur_y) {
+				int delta_x = avg_x - b->leaf_cur_x;
+				int delta_y = avg_y - b->leaf_cur_y;
+				for (int w = 0; w < b->walker_count; w++) {
+					b->walkers[w].x += delta_x;
+					b->walkers[w].y += delta_y;
+				}
+				canopyMove(&t->canopy, b, delta_x, delta_y);
+				b->leaf_cur_x = avg_x;
+				b->leaf_cur_y = avg_y;
+			}
+
+			if (b->leaf_steps_drawn < targetLeafLife) {
+				enum branchType leafType = (b->type == trunk) ? dead : dying;
+				struct canopyOwner owner = {&t->canopy, b};
+				leafStepWalkers(conf, canopyEmit, &owner, leafType, trunk_y + 1,
+								&b->walkers, &b->walker_count, &b->walker_capacity);
+				b->leaf_steps_drawn++;
+			}
+			liveWalkers += b->walker_count;
+		}
+		if (liveWalkers > myCounters->peakWalkers) myCounters->peakWalkers = liveWalkers;
+		profRecord(PROF_LEAVES, profElapsed(phaseStart));
+	}
+
+	if (stateTrace)
+		traceState(myCounters, list, &t->canopy, t->turn, NULL, 0, skeleton, trunkPlane);
+	if (eventTrace)
+		traceTick(myCounters, list, tickStart);
+
+	t->turn = (t->turn + 1) % list->count;
+	return 1;
+}
+
+
+// ==========================================================================
+// V2 ENGINE  (msaw streams: pads, lean, widening, deadwood)
+// ==========================================================================
+
+struct ColorResult chooseColorResult_v2(enum branchType type, struct msaw *cosmetic) {
+	struct ColorResult cr = {0, 0};
+	int r;
+	switch(type) {
+	case trunk:
+		r = mrand(cosmetic, 4);
+		if (r < 2) { cr.attrs = CB_BOLD; cr.color_pair = 20; }
+		else if (r == 2) { cr.color_pair = 20; }
+		else { cr.color_pair = 21; }
+		break;
+
+	case shootLeft:
+	case shootRight:
+		r = mrand(cosmetic, 10);
+		if (r < 2) { cr.attrs = CB_BOLD; cr.color_pair = 20; }
+		else if (r < 6) { cr.attrs = CB_BOLD; cr.color_pair = 21; }
+		else { cr.color_pair = 21; }
+		break;
+
+	case dying:
+		r = mrand(cosmetic, 6);
+		if (r < 3) { cr.color_pair = 22; }
+		else if (r < 5) { cr.attrs = CB_BOLD; cr.color_pair = 22; }
+		else { cr.color_pair = 23; }
+		break;
+
+	case dead:
+		r = mrand(cosmetic, 18);
+		if (r < 2) { cr.attrs = CB_BOLD; cr.color_pair = 23; }
+		else if (r < 8) { cr.attrs = CB_BOLD; cr.color_pair = 22; }
+		else { cr.color_pair = 22; }
+		break;
+	}
+	return cr;
+}
+
+// v2: nudge a freshly-rolled dx toward the branch's committed lean. Higher
+// |lean| -> more consistent pull; dx is held within [lo, hi] so the lean bends
+// the wander rather than overriding it. Draws one value from the growth stream.
+static int applyLean(struct msaw *growth, int dx, int lean, int lo, int hi) {
+	if (lean == 0) return dx;
+	int s = (lean > 0) ? 1 : -1;
+	int strength = (lean > 0) ? lean : -lean;
+	if (strength > LEAN_MAX) strength = LEAN_MAX;
+	if (mrand(growth, LEAN_DENOM) < strength) {
+		dx += s;
+		if (dx < lo) dx = lo;
+		if (dx > hi) dx = hi;
+	}
+	return dx;
+}
+
+// v2: ported from setDeltas onto an explicit msaw growth stream, plus a lean
+// pull on the trunk and shoot wander (see applyLean). dying/dead drift is left
+// symmetric here — foliage shaping is handled by the canopy-pad walker bias.
+void setDeltas_v2(enum branchType type, int life, int totalLife, int age,
+				  int multiplier, int *returnDx, int *returnDy,
+				  int lean, struct msaw *growth) {
+	int dx = 0;
+	int dy = 0;
+	int dice;
+	switch (type) {
+	case trunk: // trunk
+
+		// new or dead trunk
+		if (age <= 2 || life < 4) {
+			dy = 0;
+			dx = mrand(growth, 3) - 1;
+		}
+		// young trunk should grow wide]
+		else if (isYoungTrunk(age, totalLife)) {
+			// every (multiplier * 0.4) steps, raise tree to next level
+			int step = (int)(multiplier * 0.6);
+			if (step < 1) step = 1;
+			if (age % step == 0) dy = -1;
+			else dy = 0;
+
+			dice = mrand(growth, 10);
+			if (dice >= 0 && dice <=0) dx = -2;			// 10%
+			else if (dice >= 1 && dice <= 3) dx = -1;	// 30%
+			else if (dice >= 4 && dice <= 5) dx = 0;	// 20%
+			else if (dice >= 6 && dice <= 8) dx = 1;	// 30%
+			else if (dice >= 9 && dice <= 9) dx = 2;	// 10%
+		}
+		else if (isEarlyTrunk(age, totalLife)) {
+			// every (multiplier * 0.3) steps, raise tree to next level
+			int step = (int)(multiplier * 0.3);
+			if (step < 1) step = 1;
+			if (age % step == 0) dy = -1;
+			else dy = 0;
+
+			dice = mrand(growth, 10);
+			if (dice >= 0 && dice <=0) dx = -2;			// 10%
+			else if (dice >= 1 && dice <= 3) dx = -1;	// 30%
+			else if (dice >= 4 && dice <= 5) dx = 0;	// 20%
+			else if (dice >= 6 && dice <= 8) dx = 1;	// 30%
+			else if (dice >= 9 && dice <= 9) dx = 2;	// 10%
+		}
+		// old-aged trunk
+		else {
+			dice = mrand(growth, 10);
+			if (dice > 3) dy = -1;
+			else dy = 0;
+
+			dice = mrand(growth, 20);
+			if (dice >= 0 && dice <=0) dx = -2;			// 10%
+			else if (dice >= 1 && dice <= 7) dx = -1;	// 30%
+			else if (dice >= 8 && dice <= 12) dx = 0;	// 20%
+			else if (dice >= 13 && dice <= 18) dx = 1;	// 30%
+			else if (dice >= 19 && dice <= 19) dx = 2;	// 10%
+		}
+		break;
+
+	case 1: // left shoot: trend left and little vertical movement
+		dice = mrand(growth, 10);
+		if (dice >= 0 && dice <= 2) dy = -1;
+		else if (dice >= 3 && dice <= 7) dy = 0;
+		else if (dice >= 8 && dice <= 9) dy = 1;
+
+		dice = mrand(growth, 10);
+		if (dice >= 0 && dice <=1) dx = -2;
+		else if (dice >= 2 && dice <= 5) dx = -1;
+		else if (dice >= 6 && dice <= 8) dx = 0;
+		else if (dice >= 9 && dice <= 9) dx = 1;
+		break;
+
+	case 2: // right shoot: trend right and little vertical movement
+		dice = mrand(growth, 10);
+		if (dice >= 0 && dice <= 2) dy = -1;
+		else if (dice >= 3 && dice <= 7) dy = 0;
+		else if (dice >= 8 && dice <= 9) dy = 1;
+
+		dice = mrand(growth, 10);
+		if (dice >= 0 && dice <=1) dx = 2;
+		else if (dice >= 2 && dice <= 5) dx = 1;
+		else if (dice >= 6 && dice <= 8) dx = 0;
+		else if (dice >= 9 && dice <= 9) dx = -1;
+		break;
+
+	case 3: // dying: discourage vertical growth(?); trend left/right (-3,3)
+		dice = mrand(growth, 10);
+		if (dice >= 0 && dice <=0) dy = -1;
+		else if (dice >= 1 && dice <=8) dy = 0;
+		else if (dice >= 9 && dice <=9) dy = 1;
+
+		dice = mrand(growth, 15);
+		if (dice >= 0 && dice <=0) dx = -3;
+		else if (dice >= 1 && dice <= 2) dx = -2;
+		else if (dice >= 3 && dice <= 5) dx = -1;
+		else if (dice >= 6 && dice <= 8) dx = 0;
+		else if (dice >= 9 && dice <= 11) dx = 1;
+		else if (dice >= 12 && dice <= 13) dx = 2;
+		else if (dice >= 14 && dice <= 14) dx = 3;
+		break;
+
+	case 4: // dead: fill in surrounding area
+		dice = mrand(growth, 12);
+		if (dice >= 0 && dice <= 1) dy = -1;
+		else if (dice >= 2 && dice <= 8) dy = 0;
+		else if (dice >= 9 && dice <= 11) dy = 1;
+
+		dice = mrand(growth, 15);
+		if (dice >= 0 && dice <=1) dx = -3;
+		else if (dice >= 2 && dice <= 3) dx = -2;
+		else if (dice >= 4 && dice <= 5) dx = -1;
+		else if (dice >= 6 && dice <= 8) dx = 0;
+		else if (dice >= 9 && dice <= 10) dx = 1;
+		else if (dice >= 11 && dice <= 12) dx = 2;
+		else if (dice >= 13 && dice <= 14) dx = 3;
+		break;
+	}
+
+	// commit the woody wander toward the branch's lean (foliage is shaped by
+	// the canopy-pad bias instead, so dying/dead are left alone)
+	if (type == trunk || type == shootLeft || type == shootRight)
+		dx = applyLean(growth, dx, lean, -2, 2);
+
+	*returnDx = dx;
+	*returnDy = dy;
+}
+
+// v2: faithful port of chooseString; leaf glyph choice draws from the
+// cosmetic stream so it can be retuned without invalidating saved trees
+char* chooseString_v2(const struct config *conf, enum branchType type, int life,
+					  int dx, int dy, struct msaw *cosmetic) {
+	char* branchStr;
+
+	const unsigned int maxStrLen = 32;
+
+	branchStr = malloc(maxStrLen);
+	allocNote(ALLOC_STRINGS, 0, maxStrLen);
+	strcpy(branchStr, "?");	// fallback character
+
+	if (life < 4) type = dying;
+
+	switch(type) {
+	case trunk:
+		if (dy == 0) strcpy(branchStr, "/~");
+		else if (dx < 0) strcpy(branchStr, "\\|");
+		else if (dx == 0) strcpy(branchStr, "/|\\");
+		else if (dx > 0) strcpy(branchStr, "|/");
+		break;
+	case shootLeft:
+		if (dy > 0) strcpy(branchStr, "\\");
+		else if (dy == 0) strcpy(branchStr, "\\_");
+		else if (dx < 0) strcpy(branchStr, "\\|");
+		else if (dx == 0) strcpy(branchStr, "/|");
+		else if (dx > 0) strcpy(branchStr, "/");
+		break;
+	case shootRight:
+		if (dy > 0) strcpy(branchStr, "/");
+		else if (dy == 0) strcpy(branchStr, "_/");
+		else if (dx < 0) strcpy(branchStr, "\\|");
+		else if (dx == 0) strcpy(branchStr, "/|");
+		else if (dx > 0) strcpy(branchStr, "/");
+		break;
+	case dying:
+	case dead:
+		strncpy(branchStr, conf->leaves[mrand(cosmetic, conf->leavesSize)], maxStrLen - 1);
+		branchStr[maxStrLen - 1] = '\0';
+	}
+
+	return branchStr;
+}
+
+// v2: is a live structural branch head (trunk/shoot, excluding `exceptIdx`)
+// within `minDist` Manhattan of (x, y)? Used to throttle splits and shoots in
+// crowded regions. Pure spatial test (no RNG of its own), though gating a
+// spawn does skip that spawn's draws, so changing the distances reshapes the
+// tree. Deterministic for a given build + seed.
+static int structuralCrowded(const struct BranchList *list, int x, int y,
+							 int exceptIdx, int minDist) {
+	for (int i = 0; i < list->count; i++) {
+		if (i == exceptIdx) continue;
+		const struct Branch *b = &list->branches[i];
+		if (b->type != trunk && b->type != shootLeft && b->type != shootRight)
+			continue;
+		if (abs(b->x - x) + abs(b->y - y) < minDist)
+			return 1;
+	}
+	return 0;
+}
+
+// v2: ported from updateBranch_v1 onto explicit msaw streams.
+// Growth decisions draw from `growth`, colors/glyphs from `cosmetic`,
+// and each spawned branch gets its own leaf stream via msaw_split.
+// Diverges from v1 in the terminal phase: dead branches no longer re-trigger
+// the near-dead spawn rule (v1 cascaded exponentially there), dying branches
+// and dying shoots emit children at half rate, and shoots get a life floor so
+// ones spawned near the top act like branches instead of leaf fountains.
+// Splits and shoots are additionally suppressed where heads are crowded
+// (structuralCrowded), which keeps high multiplier from tangling.
+void updateBranch_v2(struct config *conf, struct VirtualGrid *skeleton,
+				struct counters *myCounters, int branchIdx,
+				struct BranchList* list,
+				struct msaw *growth, struct msaw *cosmetic, struct msaw *deadRng) {
+
+	struct Branch *branch = &list->branches[branchIdx];
+	// non-trunk branches age one life per tick; a trunk instead pays life per
+	// row it climbs (charged after setDeltas) so its height tracks L, not M
+	if (branch->type != trunk)
+		branch->life--;
+
+	// Random die-off check - more likely on shoots
+	if (branch->type == trunk) {
+		if (mrand(growth, 66) == 0) {   // 2% chance for trunk
+			branch->life -= (branch->life/2);  // Lose 1/4 of life
+		}
+	} else if (branch->type == shootLeft || branch->type == shootRight) {
+		if (mrand(growth, 20) == 0) {    // 5% chance for shoots
+			branch->life /= 2;      // Lose half of life
+		}
+	}
+
+	branch->age++;
+
+	// jin/shari: a fork destined for deadwood grows alive and leafy, then dies
+	// back — once its life falls to diebackLife it becomes bare bleached wood
+	// for the rest of its (now short) life. Life-based so it triggers reliably
+	// as the trunk spends its height budget.
+	if (branch->diebackLife > 0 && !branch->deadwood && branch->life <= branch->diebackLife)
+		branch->deadwood = 1;
+
+	setDeltas_v2(branch->type, branch->life, branch->totalLife,
+			  branch->age, branch->multiplier, &branch->dx, &branch->dy,
+			  branch->lean, growth);
+
+	int groundY = grid_bottom(skeleton) - getBaseHeight(conf->baseType);
+	if (branch->dy > 0 && branch->y > (groundY - 6))
+		branch->dy--;
+
+	// trunk life is a height budget: pay per climbed row so total height is
+	// ~ L / TRUNK_RISE_COST whether it rises often (low M) or rarely (high M).
+	// A stalled low-life tip still drains 1/tick so it can't hang forever.
+	if (branch->type == trunk) {
+		if (branch->dy < 0) branch->life -= TRUNK_RISE_COST;
+		else if (branch->life < 4) branch->life--;
+	}
+
+	// near-dead branch should branch into a lot of leaves; dead branches
+	// don't re-trigger this (would cascade exponentially), dying ones only
+	// emit at half rate so clusters don't snowball, and deadwood stays bare
+	if (branch->life < 6 && branch->type != dead && !branch->deadwood) {
+		if (branch->type != dying || mrand(growth, 2) == 0) {
+			struct Branch newBranch = {
+				.x = branch->x,
+				.y = branch->y,
+				.type = dead,
+				.life = branch->life,
+				.age = 0,
+				.totalLife = branch->life,
+				.multiplier = branch->multiplier,
+				.shootCooldown = conf->multiplier,
+				.dripLeafCooldown = branch->life / 4,
+				.history_count = 0,
+				.history_index = 0,
+				.x_history[0] = branch->x,
+				.y_history[0] = branch->y
+			};
+			msaw_split(growth, &newBranch.leaf_rng);
+			addBranch(list, newBranch, myCounters);
+			traceSpawn("wither", &newBranch, list);
+			branch = &list->branches[branchIdx];
+		}
+	}
+	else if (branch->type == shootLeft || branch->type == shootRight) {
+		// dying shoot emits at half rate (v1 spawned every tick)
+		if (branch->life < 7 + (branch->multiplier /5)) {
+			if (mrand(growth, 2) == 0) {
+				struct Branch newBranch = {
+					.x = branch->x,
+					.y = branch->y,
+					.type = dying,
+					.life = branch->life + 1,
+					.age = 0,
+					.totalLife = branch->life + 1,
+					.multiplier = branch->multiplier,
+					.shootCooldown = conf->multiplier,
+					.dripLeafCooldown = (branch->life + 1) / 4,
+					.history_count = 0,
+					.history_index = 0,
+					.x_history[0] = branch->x,
+					.y_history[0] = branch->y
+				};
+				msaw_split(growth, &newBranch.leaf_rng);
+				addBranch(list, newBranch, myCounters);
+				traceSpawn("wither", &newBranch, list);
+				branch = &list->branches[branchIdx];
+			}
+		}
+		else if (branch->dripLeafCooldown <= 0 && mrand(growth, 3) == 0) {
+			struct Branch newBranch = {
+				.x = branch->x,
+				.y = branch->y,
+				.type = dying,
+				.life = 5,
+				.age = 0,
+				.totalLife = 5,
+				.multiplier = branch->multiplier,
+				.shootCooldown = conf->multiplier,
+				.dripLeafCooldown = (branch->multiplier*2)/3,
+				.history_count = 0,
+				.history_index = 0,
+				.x_history[0] = branch->x,
+				.y_history[0] = branch->y
+			};
+			msaw_split(growth, &newBranch.leaf_rng);
+			addBranch(list, newBranch, myCounters);
+			traceSpawn("drip", &newBranch, list);
+			branch = &list->branches[branchIdx];
+			// higher multiplier -> shorter gap between drip leaves (v1 had a
+			// sign slip here, 25 + M, which made the drip fire ~once)
+			branch->dripLeafCooldown = 7 + (25 - branch->multiplier);
+		}
+	}
+	// dying trunk should branch into a lot of leaves (deadwood dies bare)
+	else if (branch->type == trunk && branch->life < (branch->multiplier + 2) && !branch->deadwood) {
+		struct Branch newBranch = {
+			.x = branch->x,
+			.y = branch->y,
+			.type = dying,
+			.life = branch->life,
+			.age = 0,
+			.totalLife = branch->life,
+			.multiplier = branch->multiplier,
+			.shootCooldown = conf->multiplier,
+			.dripLeafCooldown = branch->life / 4,
+			.history_count = 0,
+			.history_index = 0,
+			.x_history[0] = branch->x,
+			.y_history[0] = branch->y
+		};
+		msaw_split(growth, &newBranch.leaf_rng);
+		addBranch(list, newBranch, myCounters);
+		traceSpawn("wither", &newBranch, list);
+		branch = &list->branches[branchIdx];
+	}
+	else if (branch->type == trunk) {
+		// (trunk life is now charged per climbed row above, not per tick)
+		// First check for trunk splits - only in early phase and with enough life
+		if (!isYoungTrunk(branch->age, branch->totalLife)) {
+			int splitThreshold = (24 - branch->multiplier) + (2 * myCounters->trunks);
+			double ageRatio = (double)branch->age / branch->totalLife;
+
+			if (ageRatio < 0.1) {      // Bottom 10%
+				splitThreshold = (splitThreshold * 2)/7;
+			} else if (ageRatio < 0.4) {
+				splitThreshold = (splitThreshold * 3)/7;
+			} else {
+				splitThreshold = (splitThreshold * 5)/7;
+			}
+
+			// never a guaranteed split: at high multiplier the threshold can
+			// otherwise reach 1 (mrand(.,1)==0 always), turning every cooldown
+			// into a split and exploding the trunk count
+			if (splitThreshold < 2) splitThreshold = 2;
+
+			if (myCounters->trunkSplitCooldown < 0 && !branch->deadwood && mrand(growth, splitThreshold) == 0
+				&& !structuralCrowded(list, branch->x, branch->y, branchIdx, SPLIT_MIN_DIST)) {
+				myCounters->trunkSplitCooldown = 2 + ((22 - conf->multiplier)*3)/4 +
+					(int)(5 * ((double)branch->totalLife - branch->age)/branch->totalLife);
+				myCounters->trunks++;
+				branch->shootGrace = SPLIT_SHOOT_GRACE;  // parent gets a clean stretch after the split
+				branch->shootCooldown = (25 - branch->multiplier)/4;
+				// sequence the two draws explicitly (v1 left this order
+				// unspecified inside the initializer list)
+				int splitLife = branch->life - mrand(growth, 6);
+				int splitTotalLife = branch->life - mrand(growth, 6);
+				// fork divergence: child and parent commit to opposite sides so
+				// a split reads as a real fork. Divergence grows with the
+				// multiplier, so high M makes bold forks instead of a tangle.
+				int divStrength = 1 + branch->multiplier / 7;   // M8->2, M20->3
+				if (divStrength > LEAN_MAX) divStrength = LEAN_MAX;
+				int side = (mrand(growth, 2) == 0) ? 1 : -1;
+				int childLean = branch->lean + side * divStrength;
+				int parentLean = branch->lean - side * divStrength;
+				if (childLean > LEAN_MAX) childLean = LEAN_MAX;
+				else if (childLean < -LEAN_MAX) childLean = -LEAN_MAX;
+				if (parentLean > LEAN_MAX) parentLean = LEAN_MAX;
+				else if (parentLean < -LEAN_MAX) parentLean = -LEAN_MAX;
+				// jin/shari: occasionally this fork is destined to die back — it
+				// grows alive and leafy, then turns to bare wood once its life
+				// drops to ~a third remaining. Decided on its own stream so
+				// trees with no dead limb are byte-identical to before.
+				int childDieback = 0;
+				if (mrand(deadRng, DEADWOOD_CHANCE) == 0)
+					childDieback = splitTotalLife / 3 + mrand(deadRng, splitTotalLife / 6 + 1);
+				struct Branch newBranch = {
+					.x = branch->x,
+					.y = branch->y,
+					.type = trunk,
+					.life = splitLife,
+					.age = 0,
+					.totalLife = splitTotalLife,
+					.multiplier = branch->multiplier,
+					.lean = childLean,
+					.splitDepth = branch->splitDepth + 1,
+					.shootGrace = SPLIT_SHOOT_GRACE,   // child also starts with a clean stretch
+					.diebackLife = childDieback,
+					.shootCooldown = conf->multiplier,
+					.dripLeafCooldown = branch->life / 4,
+					.history_count = 0,
+					.history_index = 0,
+					.x_history[0] = branch->x,
+					.y_history[0] = branch->y
+				};
+				msaw_split(growth, &newBranch.leaf_rng);
+				addBranch(list, newBranch, myCounters);
+				traceSpawn("split", &newBranch, list);
+				branch = &list->branches[branchIdx];
+				branch->lean = parentLean;
+				// cost of splitting — smaller at higher multiplier, since high M
+				// splits far more often (keeps total split drain ~M-independent)
+				int splitCoef = (32 - conf->multiplier) / 5;   // M7->5, M14->3, M20->2
+				if (splitCoef < 1) splitCoef = 1;
+				branch->life -= mrand(growth, 1) + (int)(splitCoef * ((double)branch->totalLife - branch->age)/branch->totalLife);
+			}
+		}
+
+		// Then check for regular branch shoots (deadwood limbs stay bare)
+		int branchDice = getBranchRollThreshold(branch->age, branch->totalLife, branch->multiplier);
+		if (branch->shootCooldown <= 0 && !branch->deadwood && branch->shootGrace <= 0
+			&& mrand(growth, branchDice) == 0
+			&& !structuralCrowded(list, branch->x, branch->y, branchIdx, SHOOT_MIN_DIST)) {
+			branch->shootCooldown = myCounters->trunks + (25 - branch->multiplier)/6;
+			int shootLife = ((branch->life * 3)/4 + mrand(growth, branch->multiplier) - 2);
+			// ceiling: shoot life (and thus sideways reach) tracks the trunk's
+			// height budget, so a shoot off a fresh high-life base can't run
+			// clear across the screen. Applied before the floor so the floor
+			// always wins as the lower bound on tiny trees.
+			int shootCap = branch->totalLife / SHOOT_LIFE_CAP_DIV + branch->multiplier/3;
+			if (shootLife > shootCap)
+				shootLife = shootCap;
+			// floor keeps shoots near the top of the trunk acting like
+			// branches for a few steps before their dying phase, instead
+			// of being born straight into it
+			if (shootLife < 8 + branch->multiplier/3)
+				shootLife = 8 + branch->multiplier/3;
+
+			myCounters->shoots++;
+			myCounters->shootCounter++;
+
+			// side-runs: commit to one flank for a short run, then flip, so
+			// shoots group into alternating clusters (feeds the canopy pads)
+			if (myCounters->shootRunRemaining <= 0) {
+				myCounters->shootSide = (myCounters->shootSide == shootLeft) ? shootRight : shootLeft;
+				myCounters->shootRunRemaining = 1 + mrand(growth, 1 + branch->multiplier / SHOOT_RUN_MDIV);
+			}
+			enum branchType shootType = (enum branchType)myCounters->shootSide;
+			myCounters->shootRunRemaining--;
+
+			struct Branch newBranch = {
+				.x = branch->x,
+				.y = branch->y,
+				.type = shootType,
+				.life = shootLife,
+				.age = 0,
+				.totalLife = shootLife,
+				.multiplier = branch->multiplier,
+				.lean = branch->lean,   // shoots sweep with the trunk they grow from
+				.shootCooldown = conf->multiplier,
+				.dripLeafCooldown = shootLife / 4,
+				.history_count = 0,
+				.history_index = 0,
+				.x_history[0] = branch->x,
+				.y_history[0] = branch->y
+			};
+			msaw_split(growth, &newBranch.leaf_rng);
+			addBranch(list, newBranch, myCounters);
+			traceSpawn("shoot", &newBranch, list);
+			branch = &list->branches[branchIdx];
+
+			branch->life -= mrand(growth, 3); // cost of sprouting
+		}
+	}
+	myCounters->trunkSplitCooldown--;
+	branch->shootGrace--;
+	branch->shootCooldown--;
+	branch->dripLeafCooldown--;
+
+	// move in x and y directions
+	branch->x += branch->dx;
+	branch->y += branch->dy;
+	if(conf->proceduralMode && branch->type != dying && branch->type != dead)
+		update_position_history(branch);
+
+	enum branchType displayType = (branch->life < 4) ? dying : branch->type;
+	struct ColorResult cr = chooseColorResult_v2(displayType, cosmetic);
+
+	// choose string to use for this branch
+	char *branchStr = chooseString_v2(conf, displayType, branch->life, branch->dx, branch->dy, cosmetic);
+
+	// deadwood (jin/shari): bare bleached wood. Force a trunk glyph (otherwise
+	// chooseString_v2 emits leaf glyphs once life<4) and a mostly-bleached
+	// colour, occasionally dark, for a weathered look.
+	if (branch->deadwood) {
+		const char *tg = (branch->dy == 0) ? "/~"
+					   : (branch->dx < 0)  ? "\\|"
+					   : (branch->dx == 0) ? "/|\\"
+					   :                     "|/";
+		strcpy(branchStr, tg);
+		cr.attrs = 0;   // no bold: keeps the dead wood muted rather than bright
+		cr.color_pair = (mrand(cosmetic, 4) == 0) ? 21 : 24;
+	}
+
+	// grab wide character from branchStr
+	wchar_t wc = 0;
+	mbstate_t ps = {0};
+	mbrtowc(&wc, branchStr, 32, &ps);
+
+	// write to grid, but ensure wide characters don't overlap.
+	// --bare suppresses leaf glyphs only (dying/dead); the RNG was already
+	// drawn above, so the woody structure stays byte-identical with/without it.
+	int w = wcwidth(wc);
+	if (w <= 0) w = 1;
+	int isLeafGlyph = (displayType == dying || displayType == dead);
+	if(branch->x % w == 0 && !(conf->hideLeaves && isLeafGlyph)) {
+		grid_put(skeleton, branch->x, branch->y, branchStr, cr.attrs, cr.color_pair);
+	}
+
+	allocNote(ALLOC_STRINGS, 32, 0);	// chooseString's maxStrLen
+	free(branchStr);
+}
+
+// v2: faithful port of leafStepWalkers; each walker advances its own msaw
+// stream (replacing rand_r) and children fork via msaw_split
+static void leafStep_v2(struct config *conf, cellEmitter emit, void *ctx,
+						enum branchType type, int groundY,
+						struct LeafWalker **walkers, int *count, int *capacity) {
+	int prev_count = *count;
+	for (int w = 0; w < prev_count; w++) {
+		struct LeafWalker *wk = &(*walkers)[w];
+
+		int dx = 0, dy = 0, dice;
+		switch (type) {
+		case dying:
+			dice = mrand(&wk->rng, 10);
+			if (dice >= 0 && dice <= 0) dy = -1;
+			else if (dice >= 1 && dice <= 8) dy = 0;
+			else if (dice >= 9 && dice <= 9) dy = 1;
+
+			dice = mrand(&wk->rng, 15);
+			if (dice >= 0 && dice <= 0) dx = -3;
+			else if (dice >= 1 && dice <= 2) dx = -2;
+			else if (dice >= 3 && dice <= 5) dx = -1;
+			else if (dice >= 6 && dice <= 8) dx = 0;
+			else if (dice >= 9 && dice <= 11) dx = 1;
+			else if (dice >= 12 && dice <= 13) dx = 2;
+			else if (dice >= 14 && dice <= 14) dx = 3;
+			break;
+		case dead:
+			dice = mrand(&wk->rng, 12);
+			if (dice >= 0 && dice <= 1) dy = -1;
+			else if (dice >= 2 && dice <= 8) dy = 0;
+			else if (dice >= 9 && dice <= 11) dy = 1;
+
+			dice = mrand(&wk->rng, 15);
+			if (dice >= 0 && dice <= 1) dx = -3;
+			else if (dice >= 2 && dice <= 3) dx = -2;
+			else if (dice >= 4 && dice <= 5) dx = -1;
+			else if (dice >= 6 && dice <= 8) dx = 0;
+			else if (dice >= 9 && dice <= 10) dx = 1;
+			else if (dice >= 11 && dice <= 12) dx = 2;
+			else if (dice >= 13 && dice <= 14) dx = 3;
+			break;
+		default:
+			break;
+		}
+
+		// canopy pads: lean the walk outward from the trunk. This remaps dx
+		// without drawing extra RNG, so the walker stream is unchanged.
+		if (wk->outward > 0) {
+			if (dx == 0) dx = LEAF_PAD_BIAS;
+			else if (dx < -LEAF_PAD_INWARD) dx = -LEAF_PAD_INWARD;
+		} else if (wk->outward < 0) {
+			if (dx == 0) dx = -LEAF_PAD_BIAS;
+			else if (dx > LEAF_PAD_INWARD) dx = LEAF_PAD_INWARD;
+		}
+
+		if (dy > 0 && wk->y > (groundY - 2))
+			dy--;
+
+		struct msaw child_rng;
+		msaw_split(&wk->rng, &child_rng);
+		if (*count < 4096) {
+			if (*count >= *capacity) {
+				*capacity *= 2;
+				*walkers = realloc(*walkers, sizeof(struct LeafWalker) * (size_t)*capacity);
+				allocNote(ALLOC_WALKERS, sizeof(struct LeafWalker) * (size_t)(*capacity / 2),
+						  sizeof(struct LeafWalker) * (size_t)*capacity);
+				wk = &(*walkers)[w];
+			}
+			struct LeafWalker child = {.x = wk->x, .y = wk->y, .seed = 0,
+									   .outward = wk->outward};
+			child.rng = child_rng;
+			(*walkers)[(*count)++] = child;
+		}
+
+		wk->x += dx;
+		wk->y += dy;
+
+		if (wk->y >= 0 && wk->y < groundY) {
+			unsigned int la = 0;
+			short lc = 0;
+			switch (type) {
+			case dying:
+				if (mrand(&wk->rng, 6) == 0) { lc = 22; }
+				else if (mrand(&wk->rng, 2) == 0) { la = CB_BOLD; lc = 23; }
+				else { lc = 23; }
+				break;
+			case dead:
+				if (mrand(&wk->rng, 7) == 0) { la = CB_BOLD; lc = 22; }
+				else if (mrand(&wk->rng, 2) == 0) { la = CB_BOLD; lc = 23; }
+				else { lc = 23; }
+				break;
+			default:
+				break;
+			}
+
+			// draw the leaf glyph (still consume the RNG when --bare so the
+			// hidden-foliage tree is identical to the shown one)
+			char *leafStr = conf->leaves[mrand(&wk->rng, conf->leavesSize)];
+			if (!conf->hideLeaves)
+				emit(ctx, wk->x, wk->y, leafStr, la, lc);
+		}
+	}
+}
+
+// returns the number of walkers the burst ended with (instrumentation)
+int generateLeaves_v2(struct config *conf, struct VirtualGrid *grid, enum branchType type,
+					   int x, int y, int life, const struct msaw *leafRng, int groundY,
+					   int outward) {
+	int capacity = 16;
+	int count = 1;
+	struct LeafWalker *walkers = malloc(sizeof(struct LeafWalker) * (size_t)capacity);
+	allocNote(ALLOC_WALKERS, 0, sizeof(struct LeafWalker) * (size_t)capacity);
+	walkers[0] = (struct LeafWalker){.x = x, .y = y, .seed = 0, .outward = outward};
+	walkers[0].rng = *leafRng;
+
+	for (int step = 0; step < life; step++) {
+		leafStep_v2(conf, gridEmit, grid, type, groundY, &walkers, &count, &capacity);
+	}
+
+	allocNote(ALLOC_WALKERS, sizeof(struct LeafWalker) * (size_t)capacity, 0);
+	free(walkers);
+	return count;
+}
+
+// v2: advance the trunk-widening animation by one tick. Each trunk cell grows
+// its rendered half-width toward a target — distance-from-base taper scaled by
+// the tree's maturity (gated by TRUNK_MIN_HEIGHT) — one step at a time, with a
+// random [0,7]-tick gap between steps, so the lower trunk fills out gradually
+// rather than all at once. Pure presentation: draws from `rng` only.
+static void advanceTrunkWiden(struct VirtualGrid *tp, int trunk_y, struct msaw *rng) {
+	int apexY = trunk_y;
+	if (tp->occLeft != tp->occRight) apexY = tp->anchor_y + tp->occTop;
+	int height = trunk_y - apexY;
+	int baseHalf = 0;
+	if (height >= TRUNK_MIN_HEIGHT) {
+		baseHalf = 1 + (height - TRUNK_MIN_HEIGHT) / TRUNK_GROW_DIV;
+		if (baseHalf > TRUNK_MAX_HALF) baseHalf = TRUNK_MAX_HALF;
+	}
+
+	struct gridIter it;
+	for (gridIterBegin(&it, tp); gridIterNext(&it); ) {
+		struct trunkCell *c = &it.tile->trunk[it.i];
+		int cy = tp->anchor_y + it.ly;
+		// fork-thinning: each split deep scales the base width by 4/5
+		int sh = baseHalf;
+		for (int d = 0; d < c->splitDepth; d++) sh = (sh * 4) / 5;
+		int target = sh - (trunk_y - cy) / TRUNK_TAPER_DIV;
+		if (target < 0) target = 0;
+		if (c->widenHalf < target) {
+			if (c->widenTimer > 0) c->widenTimer--;
+			else {
+				c->widenHalf++;
+				c->widenTimer = mrand(rng, 8);  // 0..7
+				gridDamage(tp, it.lx, it.ly, it.lx + 1, it.ly + 1);
+			}
+		}
+	}
+}
+
+// v2 trunk widening: the body drawn under the skeleton using each cell's
+// animated half-width (advanceTrunkWiden owns the timing), handed cell by
+// cell to emit in tree coordinates (the frontend clips and draws). "Widen from the
+// inside" — the stored centerline glyph's outer chars become the sloped edges
+// (lean baked in), its middle becomes the fill. The left/right reach are
+// computed independently so the trunk can bulge to the outside of a lean and
+// stop short of a neighbouring arm (no welding into a slab).
+void widenedTrunkCells(const struct VirtualGrid *tp, cellEmitter emit, void *ctx) {
+	struct gridIter it;
+	for (gridIterBegin(&it, tp); gridIterNext(&it); ) {
+		int gx = it.lx, gy = it.ly;
+		int cx = tp->anchor_x + gx;
+		int cy = tp->anchor_y + gy;
+
+		int half = it.tile->trunk[it.i].widenHalf;
+
+		// look at the connected centerline in the rows above/below (nearest
+		// occupied cell within reach) so the body can follow the trunk's bends
+		int aboveOff = 99, belowOff = 99, aboveHalf = 0;
+		for (int o = -2; o <= 2; o++) {
+			if (grid_occupied(tp, gx + o, gy - 1) && abs(o) < abs(aboveOff)) {
+				aboveOff = o; aboveHalf = grid_trunk(tp, gx + o, gy - 1)->widenHalf;
+			}
+		}
+		for (int o = -2; o <= 2; o++) {
+			if (grid_occupied(tp, gx + o, gy + 1) && abs(o) < abs(belowOff))
+				belowOff = o;
+		}
+
+		// bottom-most layer (nothing below): grow out to match the trunk
+		// just above it instead of being width-limited, so the base doesn't
+		// pinch in. It stays symmetric (the bias below is skipped for it),
+		// so it ends up ~1 wider than the biased row above — the natural
+		// off-by-one flare.
+		int isBase = (belowOff == 99);
+		if (isBase && aboveHalf > half) half = aboveHalf;
+
+		if (half < 1) continue;   // not yet widened: centerline only
+
+		const char *g = grid_glyph(tp, it.tile, it.i);
+		int len = (int)strlen(g);
+		char ledge[2] = { g[0], 0 };
+		char redge[2] = { len > 0 ? g[len - 1] : '|', 0 };
+		char fill[2]  = { (len == 3) ? g[1] : '|', 0 };
+
+		int lh = half, rh = half;
+
+		// bias toward the side(s) where the trunk continues above/below,
+		// so the body follows the centerline's bends rather than growing
+		// straight out (thin the side with no trunk neighbour). Skipped for
+		// the base, which stays symmetric and full.
+		if (!isBase) {
+			int wantRight = (aboveOff != 99 && aboveOff > 0) || (belowOff != 99 && belowOff > 0);
+			int wantLeft  = (aboveOff != 99 && aboveOff < 0) || (belowOff != 99 && belowOff < 0);
+			if (wantRight && !wantLeft && lh > 0) lh--;
+			else if (wantLeft && !wantRight && rh > 0) rh--;
+		}
+
+		// anti-weld: a flank only fills empty cells and stops short of a
+		// neighbouring arm's centerline, splitting the gap so two arms
+		// never merge into a slab (nothing is occupied outside the grid)
+		int e = 0;
+		while (e < rh && !grid_occupied(tp, gx + 1 + e, gy)) e++;
+		if (grid_occupied(tp, gx + 1 + e, gy)) { rh = (e - 1) / 2; if (rh < 0) rh = 0; }
+		e = 0;
+		while (e < lh && !grid_occupied(tp, gx - 1 - e, gy)) e++;
+		if (grid_occupied(tp, gx - 1 - e, gy)) { lh = (e - 1) / 2; if (lh < 0) lh = 0; }
+
+		if (lh < 1 && rh < 1) continue;
+
+		for (int d = -lh; d <= rh; d++) {
+			if (d == 0) continue;                 // centerline drawn by skeleton
+			if (d == -lh)      emit(ctx, cx + d, cy, ledge, CB_BOLD, 21);
+			else if (d == rh)  emit(ctx, cx + d, cy, redge, CB_BOLD, 21);
+			else               emit(ctx, cx + d, cy, fill, 0, 20);
+		}
+	}
+}
+
+// v2 engine: structurally a faithful port of v1, but fully self-seeded
+// from explicit msaw streams — it never touches v1's rand() sequence,
+// so growth, cosmetics and leaf walkers are independently deterministic.
+// treeInit_v2 seeds the streams, resets the counters and plants the trunk.
+static void treeInit_v2(struct treeContext *t) {
+	struct config *conf = t->conf;
+	struct counters *myCounters = t->counters;
+
+	msaw_seed(&t->growth, (uint64_t)conf->seed);
+	msaw_seed(&t->cosmetic, (uint64_t)conf->seed ^ MSAW_COSMETIC_SALT);
+	msaw_seed(&t->widenRng, (uint64_t)conf->seed ^ MSAW_WIDEN_SALT);
+	msaw_seed(&t->deadRng, (uint64_t)conf->seed ^ MSAW_DEADWOOD_SALT);
+	t->view.trunkPlane = t->trunkPlane;  // v2: render the widened trunk under the skeleton
+
+	myCounters->trunks = 0;
+	myCounters->shoots = 0;
+	myCounters->branches = 0;
+	myCounters->shootCounter = 5;
+	myCounters->globalTime = 0;
+	myCounters->trunkSplitCooldown = 0;
+	myCounters->peakBranches = 0;
+	myCounters->peakWalkers = 0;
+	myCounters->gridBytes = 0;
+	// random starting flank; runs flip from here (see shoot side-runs below)
+	myCounters->shootSide = (mrand(&t->growth, 2) == 0) ? shootLeft : shootRight;
+	myCounters->shootRunRemaining = 0;
+
+	// gentle random whole-tree lean (windswept variety); the dramatic shaping
+	// comes from fork divergence, so the base tilt stays mild
+	int baseLean = mrand(&t->growth, 3) - 1;   // -1, 0, +1
+	struct Branch initialBranch = {
+		.x = t->view.trunk_x,
+		.y = t->view.trunk_y,
+		.life = conf->lifeStart,
+		.age = 0,
+		.type = trunk,
+		.shootCooldown = conf->multiplier,
+		.dripLeafCooldown = conf->multiplier + conf->lifeStart / 4,
+		.totalLife = conf->lifeStart,
+		.multiplier = conf->multiplier,
+		.lean = baseLean
+	};
+	msaw_split(&t->growth, &initialBranch.leaf_rng);
+	addBranch(&t->branchList, initialBranch, myCounters);
+}
+
+// one globalTime tick: 1 if a branch grew, 0 if a spent one was retired
+static int treeTick_v2(struct treeContext *t) {
+	struct config *conf = t->conf;
+	struct counters *myCounters = t->counters;
+	struct VirtualGrid *skeleton = t->skeleton, *trunkPlane = t->trunkPlane;
+	struct BranchList *list = &t->branchList;
+	int trunk_x = t->view.trunk_x, trunk_y = t->view.trunk_y;
+
+	myCounters->globalTime++;
+	allocTick();
+	statsPoll(myCounters, list);
+	unsigned long long tickStart = traceStart();
+
+	if (list->branches[t->turn].life <= 0) {
+		struct Branch* b = &list->branches[t->turn];
+		if (conf->proceduralMode &&
+			b->type != dying && b->type != dead &&
+			!b->deadwood &&                  // deadwood dies bare, no leaf burst
+			b->totalLife > 0) {
+			double lifeRatio = ((double)b->age) / b->totalLife;
+
+			int avg_x, avg_y;
+			get_average_position(b, &avg_x, &avg_y);
+
+			int log_factor = 0, dummy = b->age;
+			while(dummy > 0) {
+				log_factor++;
+				dummy >>= 1;
+			}
+
+			int leafLife = log_factor + lifeRatio * ((b->type == trunk) ? 4 : 3);
+			enum branchType newType = (b->type == trunk) ? dead : dying;
+
+			// canopy pads: clusters lean away from the trunk centerline
+			int leafOutward = (avg_x < trunk_x) ? -1 : (avg_x > trunk_x) ? 1 : 0;
+			unsigned long long burstStart = traceStart();
+			int burst = generateLeaves_v2(conf, skeleton, newType, avg_x, avg_y, leafLife, &b->leaf_rng, trunk_y + 1, leafOutward);
+			traceEvent('X', "leaf burst", "leaves", burstStart, traceStart(),
+					   "\"walkers\":%d,\"life\":%d,\"x\":%d,\"y\":%d", burst, leafLife, avg_x, avg_y);
+			if (burst > myCounters->peakWalkers) myCounters->peakWalkers = burst;
+		}
+
+		allocNote(ALLOC_WALKERS, sizeof(struct LeafWalker) * (size_t)b->walker_capacity, 0);
+		free(b->walkers);
+		b->walkers = NULL;
+		b->walker_count = 0;
+		b->walker_capacity = 0;
+		canopyRemove(&t->canopy, b);
+
+		removeBranch(list, t->turn);
+		if (stateTrace) {
+			const struct msaw streams[4] = {t->growth, t->cosmetic, t->widenRng, t->deadRng};
+			traceState(myCounters, list, &t->canopy, t->turn, streams, 4, skeleton, trunkPlane);
+		}
+		if (eventTrace)
+			traceTick(myCounters, list, tickStart);
+		if (t->turn >= list->count) {
+			t->turn = 0;
+		}
+		return 0;
+	}
+
+	unsigned long long phaseStart = profStart();
+	updateBranch_v2(conf, skeleton, myCounters, t->turn, list, &t->growth, &t->cosmetic, &t->deadRng);
+	profRecord(PROF_UPDATE, profElapsed(phaseStart));
+
+	// record trunk cells in the trunk plane, storing the centerline glyph
+	// (its outer chars become the widened edges) and keeping the pot rim
+	// hugging the trunk's footprint
+	phaseStart = profStart();
+	{
+		struct Branch *ub = &list->branches[t->turn];
+		if (ub->type == trunk && !ub->deadwood) {  // deadwood stays a thin bare spar
+			// same centerline glyph chooseString_v2 draws for a trunk;
+			// widenedTrunkCells relocates its edge chars outward
+			const char *tg = (ub->dy == 0) ? "/~"
+						   : (ub->dx < 0)  ? "\\|"
+						   : (ub->dx == 0) ? "/|\\"
+						   :                 "|/";
+			grid_put(trunkPlane, ub->x, ub->y, tg, 0, 0);
+			struct trunkCell *tc = grid_trunk(trunkPlane, ub->x - trunkPlane->anchor_x,
+											  ub->y - trunkPlane->anchor_y);
+			// deeper forks widen less (by 255 deep, not at all)
+			tc->splitDepth = (uint8_t)(ub->splitDepth < 255 ? ub->splitDepth : 255);
+			// random initial delay so the lower trunk widens
+			// cell-by-cell (staggered) rather than in lockstep
+			if (tc->widenHalf == 0)
+				tc->widenTimer = mrand(&t->widenRng, 8);
+		}
+	}
+
+	unsigned long long trunkPlaneNs = profElapsed(phaseStart);
+
+	// advance the trunk-widening animation one tick
+	phaseStart = profStart();
+	advanceTrunkWiden(trunkPlane, trunk_y, &t->widenRng);
+	profRecord(PROF_WIDEN, profElapsed(phaseStart));
+
+	// keep the pot rim hugging the widened trunk base (which thickens over
+	// time), not just the thin centerline
+	phaseStart = profStart();
+	{
+		int ly = trunk_y - trunkPlane->anchor_y;
+		if (ly >= trunkPlane->y0 && ly < trunkPlane->y0 + trunkPlane->height) {
+			int lo = trunk_x, hi = trunk_x;
+			struct gridRow span = grid_row(trunkPlane, ly);
+			for (int gx = grid_next(trunkPlane, span.lo, ly); gx < span.hi;
+				 gx = grid_next(trunkPlane, gx + 1, ly)) {
+				int half = grid_trunk(trunkPlane, gx, ly)->widenHalf;
+				int cx = trunkPlane->anchor_x + gx;
+				if (cx - half < lo) lo = cx - half;
+				if (cx + half > hi) hi = cx + half;
+			}
+			if (lo != t->rimLo || hi != t->rimHi) {
+				t->rimLo = lo; t->rimHi = hi;
+				drawPotRim(skeleton, conf->baseType, trunk_x, trunk_y, t->rimLo, t->rimHi);
+			}
+		}
+	}
+	profRecord(PROF_TRUNKPLANE, trunkPlaneNs + profElapsed(phaseStart));
+
+	if (conf->live && conf->proceduralMode) {
+		phaseStart = profStart();
+		int liveWalkers = 0;
+		for (int i = 0; i < list->count; i++) {
+			struct Branch* b = &list->branches[i];
+
+			if (b->type != trunk && b->type != shootLeft && b->type != shootRight)
+				continue;
+			if (b->deadwood)   // bare limb: no live foliage
+				continue;
+			if (b->totalLife <= 0)
+				continue;
+
+			int avg_x, avg_y;
+			get_average_position(b, &avg_x, &avg_y);
+
+			int log_factor = 0, dummy = b->age;
+			while(dummy > 0) {
+				log_factor++;
+				dummy >>= 1;
+			}
+
+			double lifeRatio = ((double)b->age) / b->totalLife;
+			int targetLeafLife = log_factor + lifeRatio * ((b->type == trunk) ? 4 : 3);
+
+			if (!b->walkers) {
+				b->walker_capacity = 16;
+				b->walker_count = 1;
+				b->walkers = malloc(sizeof(struct LeafWalker) * (size_t)b->walker_capacity);
+				allocNote(ALLOC_WALKERS, 0, sizeof(struct LeafWalker) * (size_t)b->walker_capacity);
+				int leafOutward = (avg_x < trunk_x) ? -1 : (avg_x > trunk_x) ? 1 : 0;
+				b->walkers[0] = (struct LeafWalker){.x = avg_x, .y = avg_y, .seed = 0,
+													.outward = leafOutward};
+				b->walkers[0].rng = b->leaf_rng;
+				b->leaf_steps_drawn = 0;
+				b->leaf_cur_x = avg_x;
+				b->leaf_cur_y = avg_y;
+			}
+
+			if (avg_x != b->leaf_cur_x || avg_y != b->leaf_cur_y) {
+				int delta_x = avg_x - b->leaf_cur_x;
+				int delta_y = avg_y - b->leaf_cur_y;
+				for (int w = 0; w < b->walker_count; w++) {
+					b->walkers[w].x += delta_x;
+					b->walkers[w].y += delta_y;
+				}
+				canopyMove(&t->canopy, b, delta_x, delta_y);
+				b->leaf_cur_x = avg_x;
+				b->leaf_cur_y = avg_y;
+			}
+
+			if (b->leaf_steps_drawn < targetLeafLife) {
+				enum branchType leafType = (b->type == trunk) ? dead : dying;
+				struct canopyOwner owner = {&t->canopy, b};
+				leafStep_v2(conf, canopyEmit, &owner, leafType, trunk_y + 1,
+							&b->walkers, &b->walker_count, &b->walker_capacity);
+				b->leaf_steps_drawn++;
+			}
+			liveWalkers += b->walker_count;
+		}
+		if (liveWalkers > myCounters->peakWalkers) myCounters->peakWalkers = liveWalkers;
+		profRecord(PROF_LEAVES, profElapsed(phaseStart));
+	}
+
+	if (stateTrace) {
+		const struct msaw streams[4] = {t->growth, t->cosmetic, t->widenRng, t->deadRng};
+		traceState(myCounters, list, &t->canopy, t->turn, streams, 4, skeleton, trunkPlane);
+	}
+	if (eventTrace)
+		traceTick(myCounters, list, tickStart);
+
+	t->turn = (t->turn + 1) % list->count;
+	return 1;
+}
+
+
+// ==========================================================================
+// ENGINE SNAPSHOTS  (versioned binary tree state: resume without replay)
+// ==========================================================================
+
+// Every value is written as fixed-width little-endian, so a snapshot is
+// portable across builds; sum is a running FNV-1a of the bytes, checked
+// against the trailer on read.
+static void snapPut(FILE *fp, unsigned long long *sum, uint64_t v, int bytes) {
+	for (int i = 0; i < bytes; i++) {
+		unsigned char b = (unsigned char)(v >> (8 * i));
+		*sum = fnv_byte(*sum, b);
+		fputc(b, fp);
+	}
+}
+
+// Read a value written by snapPut. A short read leaves feof(fp) set; the
+// caller checks once at the end.
+static uint64_t snapGet(FILE *fp, unsigned long long *sum, int bytes) {
+	uint64_t v = 0;
+	for (int i = 0; i < bytes; i++) {
+		int b = fgetc(fp);
+		if (b == EOF) return 0;
+		*sum = fnv_byte(*sum, (unsigned char)b);
+		v |= (uint64_t)b << (8 * i);
+	}
+	return v;
+}
+
+#define SNAP_I32(v) snapPut(fp, sum, (uint32_t)(v), 4)
+#define SNAP_GET_I32() ((int32_t)(uint32_t)snapGet(fp, sum, 4))
+
+static void snapPutMsaw(FILE *fp, unsigned long long *sum, const struct msaw *st) {
+	snapPut(fp, sum, st->x, 8);
+	snapPut(fp, sum, st->w, 8);
+	snapPut(fp, sum, st->s, 8);
+}
+
+static void snapGetMsaw(FILE *fp, unsigned long long *sum, struct msaw *st) {
+	st->x = snapGet(fp, sum, 8);
+	st->w = snapGet(fp, sum, 8);
+	st->s = snapGet(fp, sum, 8);
+}
+
+// flags, anchor and bounds, then every allocated tile: its tile
+// coordinates and each cell, a 0 byte for a never-touched cell, else 1 and
+// every field, the glyph spelled out (ids are per table)
+static void snapPutGrid(FILE *fp, unsigned long long *sum, const struct VirtualGrid *g) {
+	SNAP_I32(g->flags);
+	SNAP_I32(g->anchor_x);
+	SNAP_I32(g->anchor_y);
+	SNAP_I32(g->x0);
+	SNAP_I32(g->y0);
+	SNAP_I32(g->width);
+	SNAP_I32(g->height);
+	snapPut(fp, sum, g->bytesAllocated, 8);
+	int tiles = 0;
+	for (int n = 0; n < g->tilesW * g->tilesH; n++)
+		tiles += g->tiles[n] != NULL;
+	SNAP_I32(tiles);
+	for (int n = 0; n < g->tilesW * g->tilesH; n++) {
+		const struct gridTile *t = g->tiles[n];
+		if (!t) continue;
+		SNAP_I32(g->tileX + n % g->tilesW);
+		SNAP_I32(g->tileY + n / g->tilesW);
+		for (int i = 0; i < GRID_TILE_W * GRID_TILE_H; i++) {
+			int occupied = (int)(t->occupied[i / GRID_TILE_W] >> (i % GRID_TILE_W)) & 1;
+			const struct trunkCell *tc = (g->flags & GRID_TRUNK) ? &t->trunk[i] : NULL;
+			int blank = !occupied && !t->glyph[i] && !t->attrs[i] && !t->color[i] &&
+						(!tc || (!tc->widenHalf && !tc->widenTimer && !tc->splitDepth));
+			snapPut(fp, sum, !blank, 1);
+			if (blank) continue;
+			const char *glyph = grid_glyph(g, t, i);
+			for (int k = 0; k < 8; k++)
+				snapPut(fp, sum, (unsigned char)glyph[k], 1);
+			snapPut(fp, sum, t->attrs[i], 1);
+			snapPut(fp, sum, t->color[i], 1);
+			snapPut(fp, sum, occupied, 1);
+			if (tc) {
+				snapPut(fp, sum, tc->widenHalf, 1);
+				snapPut(fp, sum, tc->widenTimer, 1);
+				snapPut(fp, sum, tc->splitDepth, 1);
+			}
+		}
+	}
+}
+
+// NULL on a malformed geometry or short read
+static struct VirtualGrid *snapGetGrid(FILE *fp, unsigned long long *sum, struct glyphTable *glyphs) {
+	int flags = SNAP_GET_I32();
+	int ax = SNAP_GET_I32(), ay = SNAP_GET_I32();
+	int x0 = SNAP_GET_I32(), y0 = SNAP_GET_I32();
+	int w = SNAP_GET_I32(), h = SNAP_GET_I32();
+	size_t bytesAllocated = (size_t)snapGet(fp, sum, 8);
+	int tiles = SNAP_GET_I32();
+	if (feof(fp) || (flags & ~GRID_TRUNK) || w < 1 || h < 1 || w > 100000 || h > 100000 ||
+		(long long)w * h > 50000000LL || x0 > 0 || y0 > 0 || x0 < -100000 || y0 < -100000)
+		return NULL;
+
+	struct VirtualGrid *g = grid_create(glyphs, w, h, ax, ay, flags);
+	g->x0 = x0;	// no tiles yet, so the bounds may move
+	g->y0 = y0;
+	gridCoverBounds(g);
+	if (tiles < 0 || tiles > g->tilesW * g->tilesH) {
+		grid_destroy(g);
+		return NULL;
+	}
+	for (int n = 0; n < tiles && !feof(fp); n++) {
+		int tx = SNAP_GET_I32() - g->tileX, ty = SNAP_GET_I32() - g->tileY;
+		if (feof(fp) || tx < 0 || tx >= g->tilesW || ty < 0 || ty >= g->tilesH ||
+			g->tiles[ty * g->tilesW + tx]) {
+			grid_destroy(g);
+			return NULL;
+		}
+		struct gridTile *t = gridTileAt(g, (g->tileX + tx) * GRID_TILE_W, (g->tileY + ty) * GRID_TILE_H);
+		for (int i = 0; i < GRID_TILE_W * GRID_TILE_H && !feof(fp); i++) {
+			if (!snapGet(fp, sum, 1)) continue;
+			char glyph[8];
+			for (int k = 0; k < 8; k++)
+				glyph[k] = (char)snapGet(fp, sum, 1);
+			glyph[7] = '\0';
+			t->glyph[i] = glyph_intern(glyphs, glyph);
+			t->attrs[i] = (uint8_t)snapGet(fp, sum, 1);
+			t->color[i] = (uint8_t)snapGet(fp, sum, 1);
+			if (snapGet(fp, sum, 1))
+				gridMark(g, t, (g->tileX + tx) * GRID_TILE_W + i % GRID_TILE_W,
+						 (g->tileY + ty) * GRID_TILE_H + i / GRID_TILE_W);
+			if (flags & GRID_TRUNK) {
+				t->trunk[i].widenHalf = (uint8_t)snapGet(fp, sum, 1);
+				t->trunk[i].widenTimer = (uint8_t)snapGet(fp, sum, 1);
+				t->trunk[i].splitDepth = (uint8_t)snapGet(fp, sum, 1);
+			}
+		}
+	}
+	g->bytesAllocated = bytesAllocated;
+	if (feof(fp)) {
+		grid_destroy(g);
+		return NULL;
+	}
+	return g;
+}
+
+// A branch's live leaves, last of its chain first, so that reading them
+// back (each put goes to the front) rebuilds the chain in the same order
+static void snapPutLeaves(FILE *fp, unsigned long long *sum, const struct canopy *c, const struct Branch *b) {
+	int n = 0;
+	for (uint32_t e = b->leafCells; e; e = c->entry[e].next) n++;
+	uint32_t *chain = malloc(sizeof(*chain) * (size_t)(n + 1));
+	n = 0;
+	for (uint32_t e = b->leafCells; e; e = c->entry[e].next) chain[n++] = e;
+	SNAP_I32(n);
+	while (n-- > 0) {
+		const struct canopyEntry *en = &c->entry[chain[n]];
+		SNAP_I32(en->x);
+		SNAP_I32(en->y);
+		const char *glyph = c->grid->glyphs->glyph[en->glyph];
+		for (int k = 0; k < 8; k++)
+			snapPut(fp, sum, (unsigned char)glyph[k], 1);
+		snapPut(fp, sum, en->attrs, 1);
+		snapPut(fp, sum, en->color, 1);
+	}
+	free(chain);
+}
+
+// 0 on a malformed count or short read
+static int snapGetLeaves(FILE *fp, unsigned long long *sum, struct canopy *c, struct Branch *b) {
+	int n = SNAP_GET_I32();
+	if (feof(fp) || n < 0 || n > 1 << 24) return 0;
+	for (int i = 0; i < n && !feof(fp); i++) {
+		int x = SNAP_GET_I32(), y = SNAP_GET_I32();
+		char glyph[8];
+		for (int k = 0; k < 8; k++)
+			glyph[k] = (char)snapGet(fp, sum, 1);
+		glyph[7] = '\0';
+		unsigned int attrs = (unsigned int)snapGet(fp, sum, 1);
+		short color = (short)snapGet(fp, sum, 1);
+		canopyPut(c, b, x, y, glyph, attrs, color);
+	}
+	return !feof(fp);
+}
+
+static unsigned long long snapLeavesHash(const struct config *conf) {
+	unsigned long long h = FNV_OFFSET;
+	for (int i = 0; i < conf->leavesSize; i++) {
+		for (const char *p = conf->leaves[i]; *p; p++)
+			h = fnv_byte(h, (unsigned char)*p);
+		h = fnv_byte(h, 0);
+	}
+	return h;
+}
+
+// Write t's complete engine state: the tree's identity (everything a
+// replay depends on), RNG streams, counters, grids (the canopy's too) and
+// branch list with walkers and live leaves. Returns 0 on success.
+int treeSnapshotWrite(const struct treeContext *t, FILE *fp) {
+	const struct config *conf = t->conf;
+	const struct counters *myCounters = t->counters;
+	unsigned long long sumStore = FNV_OFFSET, *sum = &sumStore;
+
+	for (int i = 0; i < 8; i++)
+		snapPut(fp, sum, (unsigned char)SNAPSHOT_MAGIC[i], 1);
+	SNAP_I32(SNAPSHOT_VERSION);
+
+	// identity: a snapshot only resumes the tree that wrote it
+	SNAP_I32(conf->version);
+	SNAP_I32(conf->seed);
+	SNAP_I32(conf->lifeStart);
+	SNAP_I32(conf->multiplier);
+	SNAP_I32(conf->baseType);
+	SNAP_I32(conf->proceduralMode);
+	SNAP_I32(conf->hideLeaves);
+	SNAP_I32(conf->live);
+	SNAP_I32(t->view.maxX);
+	SNAP_I32(t->view.maxY);
+	snapPut(fp, sum, snapLeavesHash(conf), 8);
+
+	SNAP_I32(t->turn);
+	SNAP_I32(t->grew);
+	SNAP_I32(t->done);
+	SNAP_I32(t->rimLo);
+	SNAP_I32(t->rimHi);
+	for (int i = 0; i < 31; i++)
+		SNAP_I32(t->v1rng.state[i]);
+	SNAP_I32(t->v1rng.f);
+	SNAP_I32(t->v1rng.r);
+	snapPutMsaw(fp, sum, &t->growth);
+	snapPutMsaw(fp, sum, &t->cosmetic);
+	snapPutMsaw(fp, sum, &t->widenRng);
+	snapPutMsaw(fp, sum, &t->deadRng);
+
+	SNAP_I32(myCounters->trunks);
+	SNAP_I32(myCounters->branches);
+	SNAP_I32(myCounters->shoots);
+	SNAP_I32(myCounters->shootCounter);
+	SNAP_I32(myCounters->trunkSplitCooldown);
+	SNAP_I32(myCounters->shootSide);
+	SNAP_I32(myCounters->shootRunRemaining);
+	snapPut(fp, sum, myCounters->globalTime, 8);
+	SNAP_I32(myCounters->peakBranches);
+	SNAP_I32(myCounters->peakWalkers);
+	snapPut(fp, sum, myCounters->gridBytes, 8);
+	snapPut(fp, sum, myCounters->gridHash, 8);
+
+	snapPutGrid(fp, sum, t->skeleton);
+	snapPutGrid(fp, sum, t->trunkPlane);
+
+	const struct BranchList *list = &t->branchList;
+	SNAP_I32(list->count);
+	SNAP_I32(list->capacity);
+	SNAP_I32(list->nextOrder);
+	snapPutGrid(fp, sum, t->canopy.grid);
+	for (int i = 0; i < list->count; i++) {
+		const struct Branch *b = &list->branches[i];
+		SNAP_I32(b->x);
+		SNAP_I32(b->y);
+		SNAP_I32(b->dx);
+		SNAP_I32(b->dy);
+		SNAP_I32(b->life);
+		SNAP_I32(b->age);
+		SNAP_I32(b->type);
+		SNAP_I32(b->shootCooldown);
+		SNAP_I32(b->dripLeafCooldown);
+		SNAP_I32(b->totalLife);
+		SNAP_I32(b->multiplier);
+		SNAP_I32(b->lean);
+		SNAP_I32(b->splitDepth);
+		SNAP_I32(b->shootGrace);
+		SNAP_I32(b->deadwood);
+		SNAP_I32(b->diebackLife);
+		snapPut(fp, sum, b->leaf_seed, 4);
+		snapPutMsaw(fp, sum, &b->leaf_rng);
+		for (int k = 0; k < BRANCH_HISTORY; k++) {
+			SNAP_I32(b->x_history[k]);
+			SNAP_I32(b->y_history[k]);
+		}
+		SNAP_I32(b->history_count);
+		SNAP_I32(b->history_index);
+
+		SNAP_I32(b->order);
+		snapPutLeaves(fp, sum, &t->canopy, b);
+		SNAP_I32(b->leaf_steps_drawn);
+		SNAP_I32(b->leaf_cur_x);
+		SNAP_I32(b->leaf_cur_y);
+
+		SNAP_I32(b->walkers ? b->walker_count : 0);
+		SNAP_I32(b->walkers ? b->walker_capacity : 0);
+		for (int w = 0; b->walkers && w < b->walker_count; w++) {
+			const struct LeafWalker *lw = &b->walkers[w];
+			SNAP_I32(lw->x);
+			SNAP_I32(lw->y);
+			snapPut(fp, sum, lw->seed, 4);
+			snapPutMsaw(fp, sum, &lw->rng);
+			SNAP_I32(lw->outward);
+		}
+	}
+
+	unsigned long long check = sumStore;
+	snapPut(fp, sum, check, 8);
+	return ferror(fp) ? 1 : 0;
+}
+
+// Replace t's state with a snapshot of the same tree (same identity as
+// t->conf and t's area). Returns 0 on success; on any mismatch or a
+// corrupt file returns 1 and leaves t as it was.
+int treeSnapshotRead(struct treeContext *t, FILE *fp) {
+	struct config *conf = t->conf;
+	unsigned long long sumStore = FNV_OFFSET, *sum = &sumStore;
+
+	for (int i = 0; i < 8; i++) {
+		if ((char)snapGet(fp, sum, 1) != SNAPSHOT_MAGIC[i]) return 1;
+	}
+	if (SNAP_GET_I32() != SNAPSHOT_VERSION) return 1;
+
+	int identity[10] = {
+		conf->version, conf->seed, conf->lifeStart, conf->multiplier, conf->baseType,
+		conf->proceduralMode, conf->hideLeaves, conf->live, t->view.maxX, t->view.maxY
+	};
+	for (int i = 0; i < 10; i++) {
+		if (SNAP_GET_I32() != identity[i]) return 1;
+	}
+	if (snapGet(fp, sum, 8) != snapLeavesHash(conf) || feof(fp)) return 1;
+
+	int turn = SNAP_GET_I32(), grew = SNAP_GET_I32(), done = SNAP_GET_I32();
+	int rimLo = SNAP_GET_I32(), rimHi = SNAP_GET_I32();
+	struct v1rand v1rng;
+	for (int i = 0; i < 31; i++)
+		v1rng.state[i] = SNAP_GET_I32();
+	v1rng.f = SNAP_GET_I32();
+	v1rng.r = SNAP_GET_I32();
+	struct msaw streams[4];
+	for (int i = 0; i < 4; i++)
+		snapGetMsaw(fp, sum, &streams[i]);
+
+	struct counters loaded = {0};
+	loaded.trunks = SNAP_GET_I32();
+	loaded.branches = SNAP_GET_I32();
+	loaded.shoots = SNAP_GET_I32();
+	loaded.shootCounter = SNAP_GET_I32();
+	loaded.trunkSplitCooldown = SNAP_GET_I32();
+	loaded.shootSide = SNAP_GET_I32();
+	loaded.shootRunRemaining = SNAP_GET_I32();
+	loaded.globalTime = snapGet(fp, sum, 8);
+	loaded.peakBranches = SNAP_GET_I32();
+	loaded.peakWalkers = SNAP_GET_I32();
+	loaded.gridBytes = (size_t)snapGet(fp, sum, 8);
+	loaded.gridHash = snapGet(fp, sum, 8);
+	if (v1rng.f < 0 || v1rng.f > 30 || v1rng.r < 0 || v1rng.r > 30) return 1;
+
+	struct VirtualGrid *skeleton = snapGetGrid(fp, sum, &t->glyphs);
+	struct VirtualGrid *trunkPlane = skeleton ? snapGetGrid(fp, sum, &t->glyphs) : NULL;
+	struct BranchList list = {0};
+	struct canopy canopy = {0};
+	int count = SNAP_GET_I32(), capacity = SNAP_GET_I32();
+	list.nextOrder = (uint32_t)SNAP_GET_I32();
+	// the leaves below re-put exactly what the grid already holds
+	canopy.grid = trunkPlane ? snapGetGrid(fp, sum, &t->glyphs) : NULL;
+	int ok = canopy.grid && trunkPlane && (trunkPlane->flags & GRID_TRUNK) && !feof(fp) && count >= 0 && capacity >= count && capacity > 0 && capacity <= 1 << 24 &&
+			 turn >= 0 && (turn < count || (count == 0 && turn == 0));
+	if (ok) {
+		list.capacity = capacity;
+		list.branches = calloc((size_t)capacity, sizeof(struct Branch));
+		allocNote(ALLOC_BRANCHES, 0, sizeof(struct Branch) * (size_t)capacity);
+	}
+	for (int i = 0; ok && i < count; i++) {
+		struct Branch *b = &list.branches[list.count++];
+		b->x = SNAP_GET_I32();
+		b->y = SNAP_GET_I32();
+		b->dx = SNAP_GET_I32();
+		b->dy = SNAP_GET_I32();
+		b->life = SNAP_GET_I32();
+		b->age = SNAP_GET_I32();
+		b->type = (enum branchType)SNAP_GET_I32();
+		b->shootCooldown = SNAP_GET_I32();
+		b->dripLeafCooldown = SNAP_GET_I32();
+		b->totalLife = SNAP_GET_I32();
+		b->multiplier = SNAP_GET_I32();
+		b->lean = SNAP_GET_I32();
+		b->splitDepth = SNAP_GET_I32();
+		b->shootGrace = SNAP_GET_I32();
+		b->deadwood = SNAP_GET_I32();
+		b->diebackLife = SNAP_GET_I32();
+		b->leaf_seed = (unsigned int)snapGet(fp, sum, 4);
+		snapGetMsaw(fp, sum, &b->leaf_rng);
+		for (int k = 0; k < BRANCH_HISTORY; k++) {
+			b->x_history[k] = SNAP_GET_I32();
+			b->y_history[k] = SNAP_GET_I32();
+		}
+		b->history_count = SNAP_GET_I32();
+		b->history_index = SNAP_GET_I32();
+		if (b->history_count < 0 || b->history_count > BRANCH_HISTORY ||
+			b->history_index < 0 || b->history_index >= BRANCH_HISTORY) {
+			ok = 0;
+			break;
+		}
+
+		b->order = (uint32_t)SNAP_GET_I32();
+		if (b->order >= list.nextOrder || !snapGetLeaves(fp, sum, &canopy, b)) {
+			ok = 0;
+			break;
+		}
+		b->leaf_steps_drawn = SNAP_GET_I32();
+		b->leaf_cur_x = SNAP_GET_I32();
+		b->leaf_cur_y = SNAP_GET_I32();
+
+		int walkers = SNAP_GET_I32(), walkerCapacity = SNAP_GET_I32();
+		if (feof(fp) || walkers < 0 || walkerCapacity < walkers || walkerCapacity > 1 << 24) {
+			ok = 0;
+			break;
+		}
+		if (walkerCapacity > 0) {
+			b->walkers = calloc((size_t)walkerCapacity, sizeof(struct LeafWalker));
+			b->walker_capacity = walkerCapacity;
+			allocNote(ALLOC_WALKERS, 0, sizeof(struct LeafWalker) * (size_t)walkerCapacity);
+		}
+		for (int w = 0; w < walkers; w++) {
+			struct LeafWalker *lw = &b->walkers[b->walker_count++];
+			lw->x = SNAP_GET_I32();
+			lw->y = SNAP_GET_I32();
+			lw->seed = (unsigned int)snapGet(fp, sum, 4);
+			snapGetMsaw(fp, sum, &lw->rng);
+			lw->outward = SNAP_GET_I32();
+		}
+	}
+	unsigned long long expect = sumStore;
+	if (ok && (snapGet(fp, sum, 8) != expect || feof(fp) || ferror(fp)))
+		ok = 0;
+	if (!ok) {
+		if (list.branches) freeBranchList(&list);
+		canopyFree(&canopy);
+		grid_destroy(skeleton);
+		grid_destroy(trunkPlane);
+		return 1;
+	}
+
+	// commit: swap the loaded state in for t's freshly planted tree
+	freeBranchList(&t->branchList);
+	canopyFree(&t->canopy);
+	grid_destroy(t->skeleton);
+	grid_destroy(t->trunkPlane);
+	t->canopy = canopy;
+	t->skeleton = skeleton;
+	t->trunkPlane = trunkPlane;
+	t->branchList = list;
+	t->view.skeleton = skeleton;
+	if (t->view.trunkPlane) t->view.trunkPlane = trunkPlane;
+	t->view.branchList = &t->branchList;
+	skeleton->damage = trunkPlane->damage = canopy.grid->damage = &t->damage;
+	t->damage.all = 1;
+	t->turn = turn;
+	t->grew = grew;
+	t->done = done;
+	t->rimLo = rimLo;
+	t->rimHi = rimHi;
+	t->v1rng = v1rng;
+	t->growth = streams[0];
+	t->cosmetic = streams[1];
+	t->widenRng = streams[2];
+	t->deadRng = streams[3];
+	*t->counters = loaded;
+	return 0;
+}
+
+#undef SNAP_I32
+#undef SNAP_GET_I32
+
+// A save or load file's snapshots sit next to it: FILE.snap, FILE.end,
+// and keyframe slot k (slot >= 0) in FILE.kfK.
+static char *snapshotPath(const char *file, int slot) {
+	char *path = malloc(strlen(file) + 32);
+	if (slot == SNAPSHOT_SAVE) sprintf(path, "%s.snap", file);
+	else if (slot == SNAPSHOT_END) sprintf(path, "%s.end", file);
+	else sprintf(path, "%s.kf%d", file, slot);
+	return path;
+}
+
+// Write a snapshot atomically: to a temporary, renamed over path, so a
+// crash mid-write keeps the previous one. Returns 0 on success.
+static int snapshotWriteFile(const struct treeContext *t, const char *path) {
+	char *tmp = malloc(strlen(path) + 32);
+	sprintf(tmp, "%s.tmp%ld", path, (long)getpid());
+	FILE *fp = fopen(tmp, "wb");
+	int failed = !fp || treeSnapshotWrite(t, fp);
+	if (fp && fclose(fp) != 0) failed = 1;
+	if (failed || rename(tmp, path) != 0) {
+		remove(tmp);
+		failed = 1;
+	}
+	free(tmp);
+	return failed;
+}
+
+// the tree's state next to the save file, for the next load
+static void snapshotSave(const struct treeContext *t) {
+	if (!t->conf->saveFile) return;
+	char *path = snapshotPath(t->conf->saveFile, SNAPSHOT_SAVE);
+	snapshotWriteFile(t, path);
+	free(path);
+}
+
+// Named trees: every keyframeInterval ticks, snapshot into the next of
+// keyframeCount slots (a ring, so the oldest keyframe is overwritten),
+// then delete the oldest others while the slots exceed keyframeBudget
+// bytes. A crash costs at most keyframeInterval ticks of catch-up.
+static void keyframeSave(const struct treeContext *t) {
+	const struct config *conf = t->conf;
+	unsigned long long globalTime = t->counters->globalTime;
+	if (!conf->saveFile || conf->keyframeCount < 1 || globalTime % (unsigned)conf->keyframeInterval)
+		return;
+
+	int current = (int)((globalTime / (unsigned)conf->keyframeInterval) % (unsigned)conf->keyframeCount);
+	char *path = snapshotPath(conf->saveFile, current);
+	int failed = snapshotWriteFile(t, path);
+	free(path);
+	if (failed) return;
+
+	long long *sizes = calloc((size_t)conf->keyframeCount, sizeof(long long)), total = 0;
+	for (int k = 0; k < conf->keyframeCount; k++) {
+		struct stat st;
+		path = snapshotPath(conf->saveFile, k);
+		sizes[k] = stat(path, &st) == 0 ? (long long)st.st_size : 0;
+		total += sizes[k];
+		free(path);
+	}
+	// oldest first: the slot after current was written longest ago
+	for (int i = 1; i < conf->keyframeCount && total > conf->keyframeBudget; i++) {
+		int k = (current + i) % conf->keyframeCount;
+		if (!sizes[k]) continue;
+		path = snapshotPath(conf->saveFile, k);
+		remove(path);
+		free(path);
+		total -= sizes[k];
+	}
+	free(sizes);
+}
+
+// Resume a loaded tree from the furthest snapshot of it (FILE.snap,
+// FILE.end or a keyframe) that is no further along than the load target, instead of
+// replaying it from tick 0. Returns the tree to grow: the resumed one, or
+// t untouched when no snapshot fits.
+static struct treeContext *snapshotResume(struct treeContext *t) {
+	const struct config *conf = t->conf;
+	if (!conf->loadFile) return t;
+
+	struct treeContext *best = NULL;
+	struct counters bestCounters, *myCounters = t->counters;
+	for (int slot = SNAPSHOT_END; slot < conf->keyframeCount; slot++) {
+		char *path = snapshotPath(conf->loadFile, slot);
+		FILE *fp = fopen(path, "rb");
+		free(path);
+		if (!fp) continue;
+
+		// each candidate loads into its own tree; the counters it loaded
+		// are kept aside, since all trees share myCounters
+		struct counters before = *myCounters;
+		struct treeContext *c = treeCreate(t->conf, myCounters, t->view.maxX, t->view.maxY);
+		int ok = treeSnapshotRead(c, fp) == 0 && myCounters->globalTime <= conf->targetGlobalTime &&
+				 (!best || myCounters->globalTime > bestCounters.globalTime);
+		fclose(fp);
+		if (ok) {
+			treeDestroy(best);
+			best = c;
+			bestCounters = *myCounters;
+		} else {
+			treeDestroy(c);
+		}
+		*myCounters = before;
+	}
+	if (!best) return t;
+
+	treeDestroy(t);
+	*myCounters = bestCounters;
+	return best;
+}
+
+
+// ==========================================================================
+// TREE CONTEXT  (create / step / render / destroy, growTree, dispatch)
+// ==========================================================================
+
+// Set up a tree growing into a maxX x maxY area (the frontend's, or
+// conf->cols/rows headless). conf and myCounters must outlive the context;
+// myCounters is reset here and advanced by treeStep.
+struct treeContext *treeCreate(struct config *conf, struct counters *myCounters, int maxX, int maxY) {
+	struct treeContext *t = calloc(1, sizeof(struct treeContext));
+	t->conf = conf;
+	t->counters = myCounters;
+	t->engine = get_engine(conf->version);
+
+	int baseHeight = getBaseHeight(conf->baseType);
+	t->skeleton = grid_create(&t->glyphs, maxX, maxY + baseHeight, 0, 0, 0);
+	t->trunkPlane = grid_create(&t->glyphs, maxX, maxY + baseHeight, 0, 0, GRID_TRUNK);
+	t->canopy.grid = grid_create(&t->glyphs, maxX, maxY + baseHeight, 0, 0, 0);
+	t->skeleton->damage = t->trunkPlane->damage = t->canopy.grid->damage = &t->damage;
+	t->damage.all = 1;
+	int trunk_x = maxX / 2;
+	int trunk_y = maxY - 1 - baseHeight;
+	t->rimLo = t->rimHi = trunk_x;
+
+	drawBaseToGrid(t->skeleton, conf->baseType, trunk_x, trunk_y);
+	drawPotRim(t->skeleton, conf->baseType, trunk_x, trunk_y, t->rimLo, t->rimHi);
+
+	initBranchList(&t->branchList);
+
+	t->view = (struct treeView){
+		.conf = conf, .counters = myCounters,
+		.skeleton = t->skeleton, .trunkPlane = NULL, .branchList = &t->branchList,
+		.canopy = &t->canopy, .damage = &t->damage,
+		.trunk_x = trunk_x, .trunk_y = trunk_y, .baseHeight = baseHeight,
+		.maxX = maxX, .maxY = maxY
+	};
+
+	t->engine.init(t);
+	return t;
+}
+
+// Advance up to ticks globalTime ticks; returns how many ran (fewer once
+// the tree is finished, 0 after). t->grew tells whether the last one drew.
+int treeStep(struct treeContext *t, int ticks) {
+	int ran = 0;
+	while (ran < ticks && t->branchList.count > 0) {
+		t->grew = t->engine.tick(t);
+		ran++;
+	}
+	if (t->branchList.count == 0 && !t->done) {
+		t->done = 1;
+		t->counters->gridHash = grid_hash(t->trunkPlane, grid_hash(t->skeleton, 0));
+		t->counters->gridBytes += t->skeleton->bytesAllocated + t->trunkPlane->bytesAllocated +
+								  t->canopy.grid->bytesAllocated;
+	}
+	return ran;
+}
+
+// The layers to draw right now; valid until the next treeStep or treeDestroy.
+const struct treeView *treeRender(struct treeContext *t) {
+	t->view.turn = t->turn;
+	return &t->view;
+}
+
+int treeDone(const struct treeContext *t) {
+	return t->done;
+}
+
+void treeDestroy(struct treeContext *t) {
+	if (!t) return;
+	freeBranchList(&t->branchList);
+	canopyFree(&t->canopy);
+	grid_destroy(t->skeleton);
+	grid_destroy(t->trunkPlane);
+	glyphTableFree(&t->glyphs);
+	free(t);
+}
+
+// Grow one tree to completion, showing it through fe (NULL: headless).
+// Returns nonzero if the frontend aborted the tree.
+int growTree(struct config *conf, const struct frontend *fe, struct counters *myCounters) {
+	int maxY, maxX;
+	frontendBegin(fe, conf, &maxY, &maxX);
+
+	struct treeContext *t = treeCreate(conf, myCounters, maxX, maxY);
+	if (conf->load)
+		t = snapshotResume(t);
+	while (treeStep(t, 1)) {
+		if (conf->save && conf->secondsPerTick > 0 && conf->keyframeInterval > 0)
+			keyframeSave(t);
+		if (fe && t->grew && conf->live && !(conf->load && myCounters->globalTime < conf->targetGlobalTime)) {
+			if (fe->step(fe->ctx, treeRender(t))) {
+				if (conf->save) snapshotSave(t);
+				treeDestroy(t);
+				return 1;
+			}
+		}
+	}
+
+	if (fe)
+		fe->finish(fe->ctx, treeRender(t));
+	if (conf->save)
+		snapshotSave(t);
+	treeDestroy(t);
+	return 0;
+}
+
+// Named-tree calibration: how many ticks conf's tree lives on a
+// conf->cols x conf->rows area, which sets its seconds per tick. The
+// finished tree is kept in FILE.end next to the save file: creating the
+// same tree again reads the answer from there instead of growing it, and
+// a load once the tree is fully grown resumes from it. myCounters ends up
+// as the finished tree's.
+unsigned long long treeLifetime(struct config *conf, struct counters *myCounters) {
+	struct treeContext *t = treeCreate(conf, myCounters, conf->cols, conf->rows);
+	char *path = conf->saveFile ? snapshotPath(conf->saveFile, SNAPSHOT_END) : NULL;
+	FILE *fp = path ? fopen(path, "rb") : NULL;
+	if (fp) {
+		treeSnapshotRead(t, fp);	// on a mismatch t stays freshly planted
+		fclose(fp);
+	}
+	if (!t->done) {
+		while (treeStep(t, 1))
+			;
+		if (path) snapshotWriteFile(t, path);
+	}
+	free(path);
+	treeDestroy(t);
+	return myCounters->globalTime;
+}
+
+// Grow one tree to completion without touching curses: no frontend, so
+// the engine sizes itself from conf->cols/rows and skips every display step.
+void growHeadless(struct config *conf, struct counters *myCounters) {
+	growTree(conf, NULL, myCounters);
+}
+
+struct TreeEngine get_engine(int version) {
+	struct TreeEngine engine;
+	switch (version) {
+	case 1:
+		engine.init = treeInit_v1;
+		engine.tick = treeTick_v1;
+		break;
+	case 2:
+	default:
+		engine.init = treeInit_v2;
+		engine.tick = treeTick_v2;
+		break;
+	}
+	return engine;
+}
@@ -0,0 +1,224 @@
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+
+#include "msaw.h"
+
+/*
+ * msaw_bench — standalone speed and quality suite for the msaw PRNG.
+ *
+ * Speed: ns/op for msaw_seed, msaw_next, msaw_below and msaw_split, the
+ * calls on the leafStep_v2 hot path. Quality: chi-square uniformity of
+ * msaw_below for the moduli the engines actually use (plus large ones
+ * where modulo bias is largest), and correlation between a parent stream
+ * and the child msaw_split derives from it.
+ *
+ * Usage: msaw_bench [ITERATIONS]   exit status 1 if any quality check fails
+ */
+
+// moduli drawn by the v2 engine (mrand call sites); these gate the suite
+static const uint32_t below_moduli[] = {
+	2, 3, 4, 5, 6, 7, 8, 10, 12, 15, 18, 20, 66
+};
+
+// large moduli, reported only: `% n` bias grows with n and is plainly
+// visible near 2^32, which no engine call site comes close to
+static const uint32_t bias_moduli[] = {
+	1000, 65537, 3000000000U
+};
+
+// sink so the optimiser can't drop the timed loops
+static volatile uint32_t sink;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * chi2_critical
+ * @param df: Degrees of freedom
+ * @return: Chi-square value exceeded with probability 0.001
+ *
+ * Wilson–Hilferty approximation; accurate to a few percent for df >= 1,
+ * which is plenty for a pass/fail gate.
+ */
+static double chi2_critical(double df)
+{
+	const double z = 3.090;	// one-sided normal quantile for p = 0.001
+	double a = 2.0 / (9.0 * df);
+	double t = 1.0 - a + z * sqrt(a);
+	return df * t * t * t;
+}
+
+static void bench_speed(long iters)
+{
+	struct msaw st, child;
+	double t0, t1;
+	uint32_t acc = 0;
+
+	printf("speed (%ld iterations)\n", iters);
+
+	// seeding is ~two orders of magnitude slower; fewer rounds suffice
+	long seed_iters = iters / 100 > 0 ? iters / 100 : 1;
+	t0 = now_ns();
+	for (long i = 0; i < seed_iters; i++) {
+		msaw_seed(&st, (uint64_t)i);
+		acc ^= (uint32_t)st.x;
+	}
+	t1 = now_ns();
+	printf("  %-12s %10.2f ns/op\n", "msaw_seed", (t1 - t0) / seed_iters);
+
+	msaw_seed(&st, 1);
+	t0 = now_ns();
+	for (long i = 0; i < iters; i++)
+		acc ^= msaw_next(&st);
+	t1 = now_ns();
+	printf("  %-12s %10.2f ns/op\n", "msaw_next", (t1 - t0) / iters);
+
+	t0 = now_ns();
+	for (long i = 0; i < iters; i++)
+		acc ^= msaw_below(&st, 15);
+	t1 = now_ns();
+	printf("  %-12s %10.2f ns/op\n", "msaw_below", (t1 - t0) / iters);
+
+	t0 = now_ns();
+	for (long i = 0; i < iters; i++) {
+		msaw_split(&st, &child);
+		acc ^= (uint32_t)child.x;
+	}
+	t1 = now_ns();
+	printf("  %-12s %10.2f ns/op\n", "msaw_split", (t1 - t0) / iters);
+
+	sink = acc;
+}
+
+/**
+ * check_below
+ * @param n: Modulus
+ * @param draws: Number of msaw_below draws
+ * @param gating: Whether a failure fails the suite
+ * @return: 1 if uniform at p = 0.001 (or not gating), 0 otherwise
+ *
+ * Chi-square goodness of fit of msaw_below(n) against uniform. Moduli too
+ * large to bucket individually are folded into 1024 equal-width bins.
+ * Also reports the exact modulo bias: the first (2^32 mod n) residues are
+ * each hit once more per 2^32 draws than the rest.
+ */
+static int check_below(uint32_t n, long draws, int gating)
+{
+	uint32_t bins = n <= 1024 ? n : 1024;
+	long *count = calloc(bins, sizeof(long));
+	struct msaw st;
+
+	msaw_seed(&st, 0x5eed0000ULL + n);
+	for (long i = 0; i < draws; i++) {
+		uint32_t v = msaw_below(&st, n);
+		uint32_t b = (n <= 1024) ? v : (uint32_t)(((uint64_t)v * bins) / n);
+		count[b]++;
+	}
+
+	// expected count per bin; the last folded bin may be narrower
+	double chi2 = 0;
+	for (uint32_t b = 0; b < bins; b++) {
+		double lo = (n <= 1024) ? b : ((double)b * n) / bins;
+		double hi = (n <= 1024) ? b + 1 : ((double)(b + 1) * n) / bins;
+		double expect = draws * (ceil(hi) - ceil(lo)) / n;
+		double d = count[b] - expect;
+		chi2 += d * d / expect;
+	}
+	free(count);
+
+	double crit = chi2_critical(bins - 1);
+	double bias = (double)(4294967296ULL % n) / 4294967296.0;
+	int ok = chi2 < crit;
+	printf("  below(%10u)  chi2 %10.1f  crit %10.1f  bias %.2e  %s\n",
+		   n, chi2, crit, bias, ok ? "PASS" : gating ? "FAIL" : "biased (info)");
+	return ok || !gating;
+}
+
+/**
+ * check_split
+ * @param pairs: Number of parent/child pairs
+ * @param draws: Draws compared per pair
+ * @return: 1 if no correlation detected, 0 otherwise
+ *
+ * After msaw_split, compares the parent's and child's next outputs (the
+ * parent keeps drawing, as leafStep_v2's walkers do), and two siblings
+ * split back to back. Reports the Pearson correlation of the outputs and
+ * the fraction of agreeing bits; both must be within 4 sigma of an
+ * independent pair (r = 0, agreement = 0.5).
+ */
+static int check_split(long pairs, long draws)
+{
+	const char *names[2] = {"parent/child", "sibling/sibling"};
+	int ok = 1;
+
+	for (int mode = 0; mode < 2; mode++) {
+		double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+		unsigned long long agree = 0;
+		long n = 0;
+
+		for (long p = 0; p < pairs; p++) {
+			struct msaw parent, a, b;
+			msaw_seed(&parent, 0xC0FFEE00ULL + (uint64_t)p);
+			if (mode == 0) {
+				msaw_split(&parent, &b);
+				a = parent;
+			} else {
+				msaw_split(&parent, &a);
+				msaw_split(&parent, &b);
+			}
+			for (long i = 0; i < draws; i++) {
+				uint32_t x = msaw_next(&a), y = msaw_next(&b);
+				double fx = x / 4294967296.0, fy = y / 4294967296.0;
+				sa += fx; sb += fy;
+				saa += fx * fx; sbb += fy * fy; sab += fx * fy;
+				uint32_t same = ~(x ^ y);
+				while (same) { agree++; same &= same - 1; }
+				n++;
+			}
+		}
+
+		double cov = sab / n - (sa / n) * (sb / n);
+		double va = saa / n - (sa / n) * (sa / n);
+		double vb = sbb / n - (sb / n) * (sb / n);
+		double r = cov / sqrt(va * vb);
+		double bits = (double)agree / (32.0 * n);
+		double r_sigma = 1.0 / sqrt((double)n);
+		double bit_sigma = 0.5 / sqrt(32.0 * n);
+		int pass = fabs(r) < 4 * r_sigma && fabs(bits - 0.5) < 4 * bit_sigma;
+		printf("  %-16s r %+.5f (4σ %.5f)  bit agreement %.5f  %s\n",
+			   names[mode], r, 4 * r_sigma, bits, pass ? "PASS" : "FAIL");
+		ok &= pass;
+	}
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	long iters = argc > 1 ? atol(argv[1]) : 20000000L;
+	if (iters < 1) iters = 1;
+	int ok = 1;
+
+	bench_speed(iters);
+
+	printf("msaw_below uniformity (p = 0.001)\n");
+	for (size_t i = 0; i < sizeof(below_moduli) / sizeof(below_moduli[0]); i++)
+		ok &= check_below(below_moduli[i], 2000000L, 1);
+	for (size_t i = 0; i < sizeof(bias_moduli) / sizeof(bias_moduli[0]); i++)
+		check_below(bias_moduli[i], 2000000L, 0);
+
+	printf("msaw_split correlation\n");
+	ok &= check_split(20000L, 64L);
+
+	printf("%s\n", ok ? "all quality checks passed" : "QUALITY CHECK FAILED");
+	return ok ? 0 : 1;
+}